@@ -9,6 +9,13 @@
 
 int main(int argc, char* argv[])
 {
+	// '-report' logs how well each animation compresses, and how far it drifts from the original.
+	bool report = false;
+	// '-quantize' has every model after it quantize its positions when loaded.  Leave it off for modular pieces which have to meet up exactly.
+	bool quantize = false;
+	// '-octahedral' has every model after it pack its normals and tangents into octahedral surfaces when loaded.
+	bool octahedral = false;
+
 	for (int i = 1; i < argc; ++i)
 	{
 		Model model;
@@ -17,6 +24,12 @@ int main(int argc, char* argv[])
 		if ((len > 0) && (argv[i][0] == '-'))
 		{
 			plog::info("Found flag: ARG[", i, "] '", argv[i], "'\n");
+			if (strcmp(argv[i], "-report") == 0)
+				{ report = true; }
+			else if (strcmp(argv[i], "-quantize") == 0)
+				{ quantize = true; }
+			else if (strcmp(argv[i], "-octahedral") == 0)
+				{ octahedral = true; }
 		}
 		else
 		{
@@ -37,6 +50,9 @@ int main(int argc, char* argv[])
 				{
 					plog::info("Unknown file type (will attempt to load via FBX SDK).\n");
 					model.LoadFBX(argv[i]);
+					model.ReduceAnimations(report);
+					model.setQuantizePositions(quantize);
+					model.setOctahedralSurfaces(octahedral);
 
 					char outfilename[512];
 					snprintf(outfilename, 512, "%s.out.xml", argv[i]);
@@ -67,8 +67,9 @@ box:add_transform()
 box:setscale(0.02, 0.2, 0.02)
 box:add_renderable()
 box:load_model('testcube.wcm.xml')
+local left_hand = unitychan:get_bone_handle('Character1_LeftHand')
 events.logical_update:listen(box, 'freecam', function(self)
-	local animpos, animrot = unitychan:get_animated_transform('Character1_LeftHand')
+	local animpos, animrot = unitychan:get_animated_transform(left_hand)
 	self:setpos(animpos)
 	self:setrot(animrot)
 end)
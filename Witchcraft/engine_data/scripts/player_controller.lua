@@ -22,15 +22,16 @@ params =
 
 function on_init(self)
 
-	self:play_animation(0, "Idle", true, 0.5)
-
 	state[self:index()] = {}
 	local mystate = state[self:index()]
 	
 	mystate.camera = nil
 	
 	mystate.h_velocity = vec3.new(0,0,0)
-	mystate.animrunning = false
+	
+	-- The animation graph picks and blends the animations; we only tell it how fast we're going.
+	mystate.speed_param = self:get_anim_param_handle("speed")
+	mystate.anim_speed_param = self:get_anim_param_handle("anim_speed")
 	
 	events.logical_update:listen(self, "player_controller", OnLogicalUpdate)
 end
@@ -112,25 +113,10 @@ function OnLogicalUpdate(self)
 	end
 	
 
-	if mystate.h_velocity:magnitude() > 0 then
-		if mystate.animrunning == false then
-			self:play_animation(0, "Walk", true, 1.6, 0.12)
-			self:play_animation(1, "RunF", true, 1, 0.12)
-			mystate.animrunning = true
-		end
-		local remapped_speed = math.linstep(mystate.h_velocity:magnitude(), params.walk_speed, params.run_speed)
-		self:set_anim_layer_weight(0, 1 - remapped_speed)
-		self:set_anim_layer_weight(1, remapped_speed)
-		self:set_animation_speed(mystate.h_velocity:magnitude() / params.run_speed)
-	else
-		if mystate.animrunning == true then
-			self:play_animation(0, "Idle", true, 1, 0.12)
-			self:play_animation(1, "nil", true, 1, 0.12)
-			self:set_anim_layer_weight(0, 1)
-			self:set_anim_layer_weight(1, 0)
-			mystate.animrunning = false
-		end
-		self:set_animation_speed(1);
+	if mystate.speed_param ~= nil then
+		local speed = mystate.h_velocity:magnitude()
+		self:set_anim_param(mystate.speed_param, speed)
+		self:set_anim_param(mystate.anim_speed_param, speed / params.run_speed)
 	end
 
 	
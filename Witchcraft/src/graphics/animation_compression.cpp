@@ -0,0 +1,480 @@
+#include "animation_compression.h"
+
+#include "model.h"
+
+#include <algorithm>
+#include <cmath>
+using namespace std;
+using namespace vmath;
+
+namespace {
+
+	constexpr const float SQRT_2 = 1.41421356f;
+	constexpr const uint32_t PACKED_QUAT_MAX = (1 << 15) - 1;
+
+	// Bones shorter than this are treated as being this long, so tiny bones don't get impossibly tight tolerances.
+	constexpr const float MIN_BONE_REACH = 0.01f;
+
+	// The shortest angle between two rotations, ignoring which hemisphere they're in.
+	inline float RotationError(quat a, quat b)
+		{ return 2.0f * acosf(fminf(fabsf(quat::dot(a.normalized(), b.normalized())), 1.0f)); }
+
+	inline float TranslationError(vec3 a, vec3 b)
+		{ return vec3::distance(a, b); }
+
+	// Flips 'to' into the same hemisphere as 'from' so that interpolating between them takes the short way around.
+	inline quat ShortestLerp(quat from, quat to, float amount)
+	{
+		if (quat::dot(from, to) < 0.0f)
+			{ to = to * -1.0f; }
+		return quat::lerp(from, to, amount);
+	}
+
+	inline vec3 InterpolateKey(vec3 from, vec3 to, float amount)
+		{ return vec3::lerp(from, to, amount); }
+	inline quat InterpolateKey(quat from, quat to, float amount)
+		{ return ShortestLerp(from, to, amount); }
+
+	inline float KeyError(vec3 a, vec3 b)
+		{ return TranslationError(a, b); }
+	inline float KeyError(quat a, quat b)
+		{ return RotationError(a, b); }
+
+	// Greedily extends each segment between kept keys until one of the skipped keys drifts too far from the interpolated curve.
+	template <typename T>
+	void ReduceTrack(StructOfArrays<float, T>& keys, float tolerance)
+	{
+		size_t count = keys.size();
+		if (count <= 2)
+			{ return; }
+
+		// A track which never changes only needs its first key.
+		bool constant = true;
+		for (size_t i = 1; i < count && constant; ++i)
+			{ constant = (KeyError(keys.template get<1>(0), keys.template get<1>(i)) <= tolerance); }
+		if (constant)
+		{
+			float time = keys.template get<0>(0);
+			T val = keys.template get<1>(0);
+			keys.clear();
+			keys.push_back(time, val);
+			return;
+		}
+
+		StructOfArrays<float, T> result;
+		result.push_back(keys.template get<0>(0), keys.template get<1>(0));
+
+		size_t anchor = 0;
+		for (size_t end = 2; end < count; ++end)
+		{
+			float start_time = keys.template get<0>(anchor);
+			float end_time = keys.template get<0>(end);
+			T start_val = keys.template get<1>(anchor);
+			T end_val = keys.template get<1>(end);
+
+			bool fits = true;
+			for (size_t mid = anchor + 1; mid < end && fits; ++mid)
+			{
+				float amount = (end_time > start_time) ? (keys.template get<0>(mid) - start_time) / (end_time - start_time) : 0.0f;
+				fits = (KeyError(InterpolateKey(start_val, end_val, amount), keys.template get<1>(mid)) <= tolerance);
+			}
+
+			if (!fits)
+			{
+				anchor = end - 1;
+				result.push_back(keys.template get<0>(anchor), keys.template get<1>(anchor));
+			}
+		}
+
+		result.push_back(keys.template get<0>(count - 1), keys.template get<1>(count - 1));
+		keys = result;
+	}
+
+	inline uint16_t QuantizeTime(float time, float duration)
+	{
+		if (duration <= 0.0f)
+			{ return 0; }
+		return (uint16_t)roundf(fminf(fmaxf(time / duration, 0.0f), 1.0f) * (float)USHRT_MAX);
+	}
+
+	// How far a cursor will walk before giving up and searching instead.
+	constexpr const uint32_t MAX_CURSOR_STEPS = 4;
+
+	// Finds the first key after 'time', starting from 'guess'.  Playback almost always moves forward by less than a key
+	// per tick, so this is usually a step or two; anything further away (like looping back to the start) is searched for.
+	uint32_t FindNextKey(const uint16_t* times, uint32_t count, uint16_t time, uint32_t guess)
+	{
+		guess = min(guess, count);
+		if (guess > 0 && times[guess - 1] > time)
+		{
+			for (uint32_t step = 0; step < MAX_CURSOR_STEPS && guess > 0 && times[guess - 1] > time; ++step)
+				{ --guess; }
+			if (guess > 0 && times[guess - 1] > time)
+				{ return (uint32_t)(upper_bound(times, times + guess, time) - times); }
+			return guess;
+		}
+
+		for (uint32_t step = 0; step < MAX_CURSOR_STEPS && guess < count && times[guess] <= time; ++step)
+			{ ++guess; }
+		if (guess < count && times[guess] <= time)
+			{ return (uint32_t)(upper_bound(times + guess, times + count, time) - times); }
+		return guess;
+	}
+
+	// Finds the keys on either side of 'time' (in quantized units) and how far between them it is.
+	void FindKeys(const uint16_t* times, const CompressedAnimationClip::Track& track, float time, bool loop, uint32_t* cursor, uint32_t& prev, uint32_t& next, float& amount)
+	{
+		uint32_t count = track.num_keys;
+		uint16_t search_time = (uint16_t)fminf(fmaxf(time, 0.0f), (float)USHRT_MAX);
+
+		uint32_t guess = (cursor != nullptr) ? *cursor : 0;
+		if (track.key_spacing > 0.0f)
+			{ guess = (search_time >= times[0]) ? (uint32_t)((float)(search_time - times[0]) / track.key_spacing) + 1 : 0; }
+		else if (cursor == nullptr)
+			{ guess = (uint32_t)(upper_bound(times, times + count, search_time) - times); }
+
+		next = FindNextKey(times, count, search_time, guess);
+		if (cursor != nullptr)
+			{ *cursor = next; }
+
+		// Before the first key or after the last one, a looping clip goes from its last key to its first, as though it had wrapped around.
+		if ((next == 0 || next == count) && loop && count > 1)
+		{
+			prev = count - 1;
+			float since_prev = (next == 0) ? (time + (float)USHRT_MAX - (float)times[prev]) : (time - (float)times[prev]);
+			next = 0;
+			float span = ((float)USHRT_MAX - (float)times[prev]) + (float)times[0];
+			amount = (span > 0.0f) ? fminf(fmaxf(since_prev / span, 0.0f), 1.0f) : 0.0f;
+			return;
+		}
+		if (next == 0)
+			{ prev = next = 0; amount = 0.0f; return; }
+		if (next == count)
+			{ prev = next = count - 1; amount = 0.0f; return; }
+
+		prev = next - 1;
+		float span = (float)times[next] - (float)times[prev];
+		amount = (span > 0.0f) ? fminf(fmaxf((time - (float)times[prev]) / span, 0.0f), 1.0f) : 0.0f;
+	}
+
+	// Returns the distance between keys if they're all evenly spaced (give or take rounding), or 0 if they aren't.
+	float CalcKeySpacing(const uint16_t* times, uint32_t count)
+	{
+		if (count < 2)
+			{ return 0.0f; }
+
+		float spacing = (float)(times[count - 1] - times[0]) / (float)(count - 1);
+		if (spacing < 1.0f)
+			{ return 0.0f; }
+
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			float expected = (float)times[0] + (spacing * (float)i);
+			if (fabsf((float)times[i] - expected) > 1.0f)
+				{ return 0.0f; }
+		}
+		return spacing;
+	}
+
+	void QuantizeTrack(CompressedAnimationClip& result, CompressedAnimationClip::Track& track, StructOfArrays<float, vec3>& keys)
+	{
+		if (track.num_keys == 0)
+			{ return; }
+
+		vec3 lower = keys.get<1>(0), upper = lower;
+		for (size_t i = 1; i < keys.size(); ++i)
+		{
+			lower = vec3::minimum(lower, keys.get<1>(i));
+			upper = vec3::maximum(upper, keys.get<1>(i));
+		}
+		track.range_min = lower;
+		track.range_extent = upper - lower;
+
+		uint16_t* times = result.getKeyTimes() + track.first_key;
+		PackedVec3* values = result.getVec3Keys() + track.first_key;
+		for (uint32_t i = 0; i < track.num_keys; ++i)
+		{
+			times[i] = QuantizeTime(keys.get<0>(i), result.duration);
+			values[i].pack(keys.get<1>(i), track.range_min, track.range_extent);
+		}
+		track.key_spacing = CalcKeySpacing(times, track.num_keys);
+	}
+
+	void QuantizeTrack(CompressedAnimationClip& result, CompressedAnimationClip::Track& track, StructOfArrays<float, quat>& keys)
+	{
+		if (track.num_keys == 0)
+			{ return; }
+
+		uint16_t* times = result.getKeyTimes() + track.first_key;
+		PackedQuat* values = result.getQuatKeys() + track.first_key;
+		for (uint32_t i = 0; i < track.num_keys; ++i)
+		{
+			times[i] = QuantizeTime(keys.get<0>(i), result.duration);
+			values[i].pack(keys.get<1>(i));
+		}
+		track.key_spacing = CalcKeySpacing(times, track.num_keys);
+	}
+
+	// Reserves room for a track's keys at the end of everything laid out so far.
+	inline void PlaceTrack(CompressedAnimationClip& result, CompressedAnimationClip::Track& track, size_t num_keys)
+	{
+		track.first_key = result.num_keys;
+		track.num_keys = (uint32_t)num_keys;
+		result.num_keys += track.num_keys;
+	}
+
+	// Builds each bone's model-space matrix for one moment of a clip, the same way AnimationController does.
+	void CalcPose(vector<mat4>& pose, AnimationClip& clip, float time, const int32_t* parent_index, const mat4* to_parent, int32_t num_bones)
+	{
+		pose.resize(num_bones);
+		for (int32_t i = 0; i < num_bones; ++i)
+		{
+			vec3 translation = VEC3_ZERO;
+			quat rotation = QUAT_IDENTITY;
+			vec3 scale = VEC3_ONE;
+			clip.getTransformForBone(i, time, false, translation, rotation, scale);
+
+			pose[i] = to_parent[i] * mat4::translation(translation) * mat4::rotation(rotation.normalized());
+			if (parent_index[i] >= 0 && parent_index[i] < i)
+				{ pose[i] = pose[parent_index[i]] * pose[i]; }
+		}
+	}
+
+} // namespace <anon>
+
+void PackedQuat::pack(quat in)
+{
+	in.normalize();
+
+	int largest = 0;
+	for (int i = 1; i < 4; ++i)
+	{
+		if (fabsf(in.data[i]) > fabsf(in.data[largest]))
+			{ largest = i; }
+	}
+
+	// q and -q are the same rotation, so we can always make the dropped component positive.
+	float sign = (in.data[largest] < 0.0f) ? -1.0f : 1.0f;
+
+	// The three smallest components are always within [-1/sqrt(2), 1/sqrt(2)], so we scale them up to fill 15 bits.
+	uint64_t bits = (uint64_t)largest;
+	for (int i = 0; i < 4; ++i)
+	{
+		if (i == largest)
+			{ continue; }
+		float unorm = ((in.data[i] * sign * SQRT_2) * 0.5f) + 0.5f;
+		uint64_t val = (uint64_t)roundf(fminf(fmaxf(unorm, 0.0f), 1.0f) * (float)PACKED_QUAT_MAX);
+		bits = (bits << 15) | val;
+	}
+
+	data[0] = (uint16_t)(bits >> 32);
+	data[1] = (uint16_t)(bits >> 16);
+	data[2] = (uint16_t)(bits);
+}
+
+quat PackedQuat::unpack() const
+{
+	uint64_t bits = ((uint64_t)data[0] << 32) | ((uint64_t)data[1] << 16) | (uint64_t)data[2];
+	int largest = (int)((bits >> 45) & 3);
+
+	quat result = QUAT_IDENTITY;
+	float sum = 0.0f;
+	int shift = 30;
+	for (int i = 0; i < 4; ++i)
+	{
+		if (i == largest)
+			{ continue; }
+		float unorm = (float)((bits >> shift) & PACKED_QUAT_MAX) / (float)PACKED_QUAT_MAX;
+		result.data[i] = ((unorm * 2.0f) - 1.0f) / SQRT_2;
+		sum += result.data[i] * result.data[i];
+		shift -= 15;
+	}
+	result.data[largest] = sqrtf(fmaxf(1.0f - sum, 0.0f));
+	return result;
+}
+
+void PackedVec3::pack(vec3 in, vec3 range_min, vec3 range_extent)
+{
+	for (int i = 0; i < 3; ++i)
+	{
+		float unorm = (range_extent.data[i] > 0.0f) ? (in.data[i] - range_min.data[i]) / range_extent.data[i] : 0.0f;
+		data[i] = (uint16_t)roundf(fminf(fmaxf(unorm, 0.0f), 1.0f) * (float)USHRT_MAX);
+	}
+}
+
+vec3 PackedVec3::unpack(vec3 range_min, vec3 range_extent) const
+{
+	vec3 result;
+	for (int i = 0; i < 3; ++i)
+		{ result.data[i] = range_min.data[i] + (range_extent.data[i] * ((float)data[i] / (float)USHRT_MAX)); }
+	return result;
+}
+
+size_t CompressedAnimationClip::getMemoryUsage() const
+{
+	return sizeof(Channel) * channels.size() + sizeof(KeyLine) * keys.size();
+}
+
+void CompressedAnimationClip::Sample(size_t channel_index, float time, bool loop, vec3& translation, quat& rotation, vec3& scale, uint32_t* cursor) const
+{
+	if (channel_index >= channels.size())
+		{ return; }
+
+	const Channel& channel = channels[channel_index];
+	const uint16_t* times = getKeyTimes();
+	float key_time = (duration > 0.0f) ? (time / duration) * (float)USHRT_MAX : 0.0f;
+	uint32_t prev, next;
+	float amount;
+
+	if (channel.position.num_keys > 0)
+	{
+		const Track& track = channel.position;
+		const PackedVec3* values = getVec3Keys() + track.first_key;
+		FindKeys(times + track.first_key, track, key_time, loop, (cursor != nullptr) ? &cursor[0] : nullptr, prev, next, amount);
+		translation = vec3::lerp(values[prev].unpack(track.range_min, track.range_extent), values[next].unpack(track.range_min, track.range_extent), amount);
+	}
+
+	if (channel.rotation.num_keys > 0)
+	{
+		const Track& track = channel.rotation;
+		const PackedQuat* values = getQuatKeys() + track.first_key;
+		FindKeys(times + track.first_key, track, key_time, loop, (cursor != nullptr) ? &cursor[1] : nullptr, prev, next, amount);
+		rotation = ShortestLerp(values[prev].unpack(), values[next].unpack(), amount);
+	}
+
+	if (channel.scale.num_keys > 0)
+	{
+		const Track& track = channel.scale;
+		const PackedVec3* values = getVec3Keys() + track.first_key;
+		FindKeys(times + track.first_key, track, key_time, loop, (cursor != nullptr) ? &cursor[2] : nullptr, prev, next, amount);
+		scale = vec3::lerp(values[prev].unpack(track.range_min, track.range_extent), values[next].unpack(track.range_min, track.range_extent), amount);
+	}
+}
+
+void CalcBoneTolerances(vector<float>& translation_tolerance, vector<float>& rotation_tolerance, vector<float>& scale_tolerance,
+	const int32_t* parent_index, const mat4* to_parent, int32_t num_bones, float tolerance)
+{
+	translation_tolerance.assign(num_bones, tolerance);
+	rotation_tolerance.assign(num_bones, tolerance);
+	scale_tolerance.assign(num_bones, tolerance);
+	if (num_bones <= 0)
+		{ return; }
+
+	// 'depth' counts the bones above each bone, 'chain' counts the bones in the longest run beneath it (including itself),
+	// and 'reach' is the furthest any joint beneath it can be, following the bones end to end.
+	vector<int32_t> depth(num_bones, 0), chain(num_bones, 1);
+	vector<float> length(num_bones, 0.0f), reach(num_bones, 0.0f);
+	for (int32_t i = 0; i < num_bones; ++i)
+	{
+		mat4 bone = to_parent[i];
+		length[i] = bone.extract_position().magnitude();
+		if (parent_index[i] >= 0 && parent_index[i] < i)
+			{ depth[i] = depth[parent_index[i]] + 1; }
+	}
+	for (int32_t i = num_bones - 1; i >= 0; --i)
+	{
+		int32_t parent = parent_index[i];
+		if (parent >= 0 && parent < i)
+		{
+			chain[parent] = max(chain[parent], chain[i] + 1);
+			reach[parent] = fmaxf(reach[parent], reach[i] + length[i]);
+		}
+	}
+
+	for (int32_t i = 0; i < num_bones; ++i)
+	{
+		// Every bone between the root and the furthest end effector adds its own error, so they split the tolerance between them.
+		float share = tolerance / (float)(depth[i] + chain[i]);
+		translation_tolerance[i] = share;
+
+		// A rotation error moves the joints beneath a bone by (angle * distance), so long chains need tight angles.
+		// End effectors have nothing beneath them, but they still swing the vertices skinned to them.
+		float bone_reach = fmaxf(fmaxf(reach[i], length[i]), MIN_BONE_REACH);
+		rotation_tolerance[i] = share / bone_reach;
+
+		// A scale error stretches everything beneath the bone by (error * distance), so it's held to the same distance.
+		scale_tolerance[i] = share / bone_reach;
+	}
+}
+
+void ReduceAnimationKeys(AnimationClip& clip, const int32_t* parent_index, const mat4* to_parent, int32_t num_bones, float tolerance)
+{
+	vector<float> translation_tolerance, rotation_tolerance, scale_tolerance;
+	CalcBoneTolerances(translation_tolerance, rotation_tolerance, scale_tolerance, parent_index, to_parent, num_bones, tolerance);
+
+	for (size_t i = 0; i < clip.channels.size() && i < (size_t)num_bones; ++i)
+	{
+		AnimationChannel& channel = clip.channels[i];
+		ReduceTrack(channel.position_keys, translation_tolerance[i]);
+		ReduceTrack(channel.rotation_keys, rotation_tolerance[i]);
+		ReduceTrack(channel.scale_keys, scale_tolerance[i]);
+	}
+}
+
+void CompressAnimationClip(CompressedAnimationClip& result, AnimationClip& clip)
+{
+	result = CompressedAnimationClip();
+	result.duration = clip.duration;
+	result.channels.resize(clip.channels.size());
+
+	// Lay every track out in bone order first, so the whole clip can be filled into a single allocation.
+	for (size_t i = 0; i < clip.channels.size(); ++i)
+	{
+		PlaceTrack(result, result.channels[i].position, clip.channels[i].position_keys.size());
+		PlaceTrack(result, result.channels[i].rotation, clip.channels[i].rotation_keys.size());
+		PlaceTrack(result, result.channels[i].scale, clip.channels[i].scale_keys.size());
+	}
+	result.keys.resize(result.getNumLines());
+
+	for (size_t i = 0; i < clip.channels.size(); ++i)
+	{
+		QuantizeTrack(result, result.channels[i].position, clip.channels[i].position_keys);
+		QuantizeTrack(result, result.channels[i].rotation, clip.channels[i].rotation_keys);
+		QuantizeTrack(result, result.channels[i].scale, clip.channels[i].scale_keys);
+	}
+}
+
+size_t GetAnimationMemoryUsage(AnimationClip& clip)
+{
+	if (!clip.compressed.isEmpty())
+		{ return clip.compressed.getMemoryUsage(); }
+
+	size_t result = 0;
+	for (size_t i = 0; i < clip.channels.size(); ++i)
+	{
+		result += (sizeof(float) + sizeof(vec3)) * clip.channels[i].position_keys.size();
+		result += (sizeof(float) + sizeof(quat)) * clip.channels[i].rotation_keys.size();
+		result += (sizeof(float) + sizeof(vec3)) * clip.channels[i].scale_keys.size();
+	}
+	return result;
+}
+
+float MeasureEndEffectorError(AnimationClip& original, AnimationClip& compressed, const int32_t* parent_index, const mat4* to_parent, int32_t num_bones, float sample_rate)
+{
+	if (num_bones <= 0)
+		{ return 0.0f; }
+
+	vector<bool> has_children(num_bones, false);
+	for (int32_t i = 0; i < num_bones; ++i)
+	{
+		if (parent_index[i] >= 0 && parent_index[i] < i)
+			{ has_children[parent_index[i]] = true; }
+	}
+
+	vector<mat4> original_pose, compressed_pose;
+	float worst = 0.0f;
+	int num_samples = max(1, (int)ceilf(original.duration * sample_rate));
+	for (int sample = 0; sample <= num_samples; ++sample)
+	{
+		float time = original.duration * ((float)sample / (float)num_samples);
+		CalcPose(original_pose, original, time, parent_index, to_parent, num_bones);
+		CalcPose(compressed_pose, compressed, time, parent_index, to_parent, num_bones);
+
+		for (int32_t i = 0; i < num_bones; ++i)
+		{
+			if (!has_children[i])
+				{ worst = fmaxf(worst, vec3::distance(original_pose[i].extract_position(), compressed_pose[i].extract_position())); }
+		}
+	}
+	return worst;
+}
\ No newline at end of file
@@ -0,0 +1,141 @@
+#ifndef HVH_WC_GRAPHICS_ANIMATIONCOMPRESSION_H
+#define HVH_WC_GRAPHICS_ANIMATIONCOMPRESSION_H
+
+#include "math/vmath.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct AnimationClip;
+
+// How far (in model units) any joint is allowed to drift from where the uncompressed animation would put it.
+// Each bone gets a share of this according to how many bones sit above and below it in the hierarchy.
+constexpr const float ANIM_COMPRESSION_DEFAULT_TOLERANCE = 0.001f;
+
+// Each channel has one sampling cursor for each of its position, rotation, and scale tracks.
+constexpr const int ANIM_CURSORS_PER_CHANNEL = 3;
+
+// A unit quaternion packed into 48 bits by dropping its largest component ("smallest three"),
+// which can be rebuilt from the other three since the quaternion is normalized.
+struct PackedQuat
+{
+	uint16_t data[3];
+
+	void pack(vmath::quat in);
+	vmath::quat unpack() const;
+};
+
+// A vec3 quantized to 16 bits per axis within the range of the track it belongs to.
+struct PackedVec3
+{
+	uint16_t data[3];
+
+	void pack(vmath::vec3 in, vmath::vec3 range_min, vmath::vec3 range_extent);
+	vmath::vec3 unpack(vmath::vec3 range_min, vmath::vec3 range_extent) const;
+};
+
+static_assert(sizeof(PackedQuat) == sizeof(uint16_t) * 3 && sizeof(PackedVec3) == sizeof(uint16_t) * 3,
+	"Packed keys must be exactly three words, so they can share a block with the key times.");
+static_assert(alignof(PackedQuat) == alignof(uint16_t) && alignof(PackedVec3) == alignof(uint16_t),
+	"Packed keys are read from any word in the block, so they can't need more than a word's alignment.");
+
+// A read-only, quantized copy of an AnimationClip's channels.
+// Every key lives in one block: all of the key times (as fractions of the clip's duration) in bone order,
+// followed by all of the key values in the same order.  'channels' says where each bone's tracks begin,
+// so sampling a whole pose reads straight through the block from front to back.
+// The block starts on a 16 byte boundary and the times are padded out so the values do too;
+// the values themselves are three words each, so past the first one they're only word aligned.
+struct CompressedAnimationClip
+{
+	// Three words for each value; the time is in its own section.
+	static constexpr const size_t WORDS_PER_VALUE = 3;
+
+	// Sixteen bytes of the block.  Building the block out of these keeps it, and the start of each section, aligned.
+	struct alignas(16) KeyLine
+	{
+		uint16_t words[8];
+	};
+	static constexpr const size_t WORDS_PER_LINE = 8;
+
+	struct Track
+	{
+		uint32_t first_key = 0;
+		uint32_t num_keys = 0;
+		float key_spacing = 0.0f; // If every key is this far apart, a key can be found by dividing its time instead of searching.
+		vmath::vec3 range_min = vmath::VEC3_ZERO;
+		vmath::vec3 range_extent = vmath::VEC3_ZERO;
+	};
+
+	struct Channel
+	{
+		Track position, rotation, scale;
+
+		bool isEmpty() const
+			{ return (position.num_keys == 0 && rotation.num_keys == 0 && scale.num_keys == 0); }
+	};
+
+	float duration = 0.0f;
+	uint32_t num_keys = 0;
+	std::vector<Channel> channels;
+	std::vector<KeyLine> keys;
+
+	bool isEmpty() const
+		{ return channels.empty(); }
+
+	// Where the values begin, in words from the start of the block.
+	size_t getValueOffset() const
+		{ return ((num_keys + WORDS_PER_LINE - 1) / WORDS_PER_LINE) * WORDS_PER_LINE; }
+	// How many lines the block needs for 'num_keys' keys.
+	size_t getNumLines() const
+		{ return (getValueOffset() + (num_keys * WORDS_PER_VALUE) + WORDS_PER_LINE - 1) / WORDS_PER_LINE; }
+
+	uint16_t* getKeyTimes()
+		{ return (uint16_t*)keys.data(); }
+	const uint16_t* getKeyTimes() const
+		{ return (const uint16_t*)keys.data(); }
+	PackedVec3* getVec3Keys()
+		{ return (PackedVec3*)(getKeyTimes() + getValueOffset()); }
+	const PackedVec3* getVec3Keys() const
+		{ return (const PackedVec3*)(getKeyTimes() + getValueOffset()); }
+	PackedQuat* getQuatKeys()
+		{ return (PackedQuat*)(getKeyTimes() + getValueOffset()); }
+	const PackedQuat* getQuatKeys() const
+		{ return (const PackedQuat*)(getKeyTimes() + getValueOffset()); }
+
+	size_t getMemoryUsage() const;
+
+	/* Samples a channel's transform at the given time.  Tracks without keys leave their output untouched. */
+	/* 'cursor' (ANIM_CURSORS_PER_CHANNEL values, starting at 0) remembers where the last sample was found, */
+	/* so playing forward only has to step over a key or two instead of searching the whole track. */
+	/* If 'loop' is set, times before a track's first key or after its last are interpolated between those two keys, across the end of the clip. */
+	void Sample(size_t channel, float time, bool loop, vmath::vec3& translation, vmath::quat& rotation, vmath::vec3& scale, uint32_t* cursor = nullptr) const;
+};
+
+/* Computes how far each bone is allowed to move, based on the skeleton's bind pose.  Bones are expected in parent-first order. */
+/* Errors near the root are carried out to every joint beneath them, so those bones get much tighter tolerances. */
+/* Translations are in distance, rotations in radians, and scales in (unitless) scale factor. */
+void CalcBoneTolerances(std::vector<float>& translation_tolerance, std::vector<float>& rotation_tolerance, std::vector<float>& scale_tolerance,
+	const int32_t* parent_index, const vmath::mat4* to_parent, int32_t num_bones, float tolerance = ANIM_COMPRESSION_DEFAULT_TOLERANCE);
+
+/* Removes every key which can be rebuilt by interpolating its neighbours within each bone's tolerance. */
+/* This replaces the old 'isLerp' test, which only removed keys which were exactly redundant. */
+void ReduceAnimationKeys(AnimationClip& clip, const int32_t* parent_index, const vmath::mat4* to_parent, int32_t num_bones,
+	float tolerance = ANIM_COMPRESSION_DEFAULT_TOLERANCE);
+
+/* Quantizes a clip's keys into a compressed clip.  The original clip is left as-is. */
+void CompressAnimationClip(CompressedAnimationClip& result, AnimationClip& clip);
+
+/* Returns the number of bytes the clip's full-precision keys take up. */
+size_t GetAnimationMemoryUsage(AnimationClip& clip);
+
+/* Plays both clips side by side and returns the furthest any end effector (a bone without children) drifts between them. */
+float MeasureEndEffectorError(AnimationClip& original, AnimationClip& compressed,
+	const int32_t* parent_index, const vmath::mat4* to_parent, int32_t num_bones, float sample_rate = 60.0f);
+
+bool RunAnimationCompressionUnitTests();
+
+/* Times sampling large clips from per-channel keys, from the same keys in one block, and from packed 16-bit keys, and logs the results. */
+void RunAnimationBenchmark();
+
+#endif // HVH_WC_GRAPHICS_ANIMATIONCOMPRESSION_H
\ No newline at end of file
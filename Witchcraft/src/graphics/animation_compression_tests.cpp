@@ -0,0 +1,310 @@
+#include "animation_compression.h"
+#include "model.h"
+
+#include "sys/printlog.h"
+#include "sys/timer.h"
+#include "tools/testrandom.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <vector>
+using namespace vmath;
+
+namespace {
+
+	TestRandom test_random(54321);
+
+	// The same full-precision keys an AnimationClip has, laid out in one block the way CompressedAnimationClip lays out its packed keys:
+	// every key time in bone order, followed by every value.  This lets the benchmark time the layout apart from the quantization.
+	struct FloatKeyBlock
+	{
+		struct Track
+		{
+			uint32_t first_key = 0;
+			uint32_t first_value = 0; // In floats from the start of the block.
+			uint32_t num_keys = 0;
+		};
+
+		struct Channel
+		{
+			Track position, rotation, scale;
+		};
+
+		std::vector<Channel> channels;
+		std::vector<float> block;
+
+		template <typename T>
+		static void PlaceTrack(Track& track, StructOfArrays<float, T>& keys, uint32_t& num_keys, uint32_t& num_values)
+		{
+			track.first_key = num_keys;
+			track.first_value = num_values;
+			track.num_keys = (uint32_t)keys.size();
+			num_keys += track.num_keys;
+			num_values += track.num_keys * (uint32_t)(sizeof(T) / sizeof(float));
+		}
+
+		template <typename T>
+		void FillTrack(Track& track, uint32_t values_start, StructOfArrays<float, T>& keys)
+		{
+			track.first_value += values_start;
+			for (uint32_t i = 0; i < track.num_keys; ++i)
+			{
+				block[track.first_key + i] = keys.template get<0>(i);
+				((T*)(block.data() + track.first_value))[i] = keys.template get<1>(i);
+			}
+		}
+
+		void Build(AnimationClip& clip)
+		{
+			uint32_t num_keys = 0, num_values = 0;
+			channels.resize(clip.channels.size());
+			for (size_t i = 0; i < clip.channels.size(); ++i)
+			{
+				PlaceTrack(channels[i].position, clip.channels[i].position_keys, num_keys, num_values);
+				PlaceTrack(channels[i].rotation, clip.channels[i].rotation_keys, num_keys, num_values);
+				PlaceTrack(channels[i].scale, clip.channels[i].scale_keys, num_keys, num_values);
+			}
+
+			block.assign(num_keys + num_values, 0.0f);
+			for (size_t i = 0; i < clip.channels.size(); ++i)
+			{
+				FillTrack(channels[i].position, num_keys, clip.channels[i].position_keys);
+				FillTrack(channels[i].rotation, num_keys, clip.channels[i].rotation_keys);
+				FillTrack(channels[i].scale, num_keys, clip.channels[i].scale_keys);
+			}
+		}
+
+		size_t getMemoryUsage() const
+			{ return sizeof(Channel) * channels.size() + sizeof(float) * block.size(); }
+
+		// Finds and interpolates keys the same way AnimationChannel::getValueAtTime does (comparison and all), so only the layout differs.
+		template <typename T>
+		T SampleTrack(const Track& track, float time) const
+		{
+			const float* times = block.data() + track.first_key;
+			const T* values = (const T*)(block.data() + track.first_value);
+			std::function<bool(const float&, const float&)> compare_lessthan = [](const float& lhs, const float& rhs) { return (lhs < rhs); };
+			uint32_t next = (uint32_t)(std::lower_bound(times, times + track.num_keys, time, compare_lessthan) - times);
+			if (next == track.num_keys)
+				{ return values[track.num_keys - 1]; }
+			if (next == 0 || times[next] == time)
+				{ return values[next]; }
+
+			uint32_t prev = next - 1;
+			return T::lerp(values[prev], values[next], (time - times[prev]) / (times[next] - times[prev]));
+		}
+
+		void Sample(size_t channel, float time, vec3& translation, quat& rotation, vec3& scale) const
+		{
+			const Channel& c = channels[channel];
+			if (c.position.num_keys > 0)
+				{ translation = SampleTrack<vec3>(c.position, time); }
+			if (c.rotation.num_keys > 0)
+				{ rotation = SampleTrack<quat>(c.rotation, time); }
+			if (c.scale.num_keys > 0)
+				{ scale = SampleTrack<vec3>(c.scale, time); }
+		}
+	};
+
+} // namespace <anon>
+
+bool RunAnimationCompressionUnitTests()
+{
+	bool success = true;
+
+	// Smallest-three quaternions should come back within a small fraction of a degree.
+	{
+		float worst = 0.0f;
+		for (int i = 0; i < 10000; ++i)
+		{
+			quat rotation = quat(test_random.Float(-1, 1), test_random.Float(-1, 1), test_random.Float(-1, 1), test_random.Float(-1, 1)).normalized();
+			PackedQuat packed;
+			packed.pack(rotation);
+			quat result = packed.unpack();
+			worst = fmaxf(worst, 2.0f * acosf(fminf(fabsf(quat::dot(rotation, result)), 1.0f)) * (180.0f / 3.14159265f));
+		}
+		if (worst > 0.1f)
+		{
+			plog::error("animation compression unit test failed: packed quaternions were off by up to %f degrees.\n", worst);
+			success = false;
+		}
+	}
+
+	// A swinging chain of bones should lose keys without any end effector drifting past the tolerance.
+	{
+		const int32_t NUM_BONES = 4;
+		int32_t parent_index[NUM_BONES] = { -1, 0, 1, 2 };
+		mat4 to_parent[NUM_BONES];
+		for (int32_t i = 0; i < NUM_BONES; ++i)
+			{ to_parent[i] = mat4::translation(0.0f, (i > 0) ? 0.5f : 0.0f, 0.0f); }
+
+		AnimationClip original;
+		original.duration = 2.0f;
+		original.channels.resize(NUM_BONES);
+		size_t num_keys = 0;
+		for (int32_t bone = 0; bone < NUM_BONES; ++bone)
+		{
+			for (int key = 0; key <= 60; ++key)
+			{
+				float time = (float)key / 30.0f;
+				original.channels[bone].position_keys.push_back(time, vec3(0.0f, 0.0f, 0.1f * time));
+				original.channels[bone].rotation_keys.push_back(time, quat::euler({ sinf((time * 3.0f) + bone) * 0.8f, 0.0f, cosf(time * 2.0f) * 0.3f }).normalized());
+				num_keys += 2;
+			}
+		}
+
+		AnimationClip reduced = original;
+		ReduceAnimationKeys(reduced, parent_index, to_parent, NUM_BONES);
+		CompressAnimationClip(reduced.compressed, reduced);
+
+		size_t num_reduced_keys = reduced.compressed.num_keys;
+		float error = MeasureEndEffectorError(original, reduced, parent_index, to_parent, NUM_BONES);
+		if (num_reduced_keys >= num_keys || error > ANIM_COMPRESSION_DEFAULT_TOLERANCE)
+		{
+			plog::error("animation compression unit test failed: %i keys reduced to %i, with an end effector error of %f.\n",
+				(int)num_keys, (int)num_reduced_keys, error);
+			success = false;
+		}
+
+		// Sampling with cursors should find exactly the same keys as searching, whether or not the keys are evenly spaced.
+		AnimationClip uniform = original;
+		CompressAnimationClip(uniform.compressed, uniform);
+		AnimationClip* clips[] = { &uniform, &reduced };
+		for (AnimationClip* clip : clips)
+		{
+			std::vector<uint32_t> cursors(NUM_BONES * ANIM_CURSORS_PER_CHANNEL, 0);
+			float time = 0.0f;
+			for (int tick = 0; tick < 200 && success; ++tick)
+			{
+				// Step forward by uneven amounts, wrapping around like a looping animation.
+				time += test_random.Float(0.0f, 0.1f);
+				if (tick % 50 == 49)
+					{ time += 0.5f; }
+				while (time > clip->duration)
+					{ time -= clip->duration; }
+
+				for (int32_t bone = 0; bone < NUM_BONES; ++bone)
+				{
+					vec3 searched_translation = VEC3_ZERO, cursor_translation = VEC3_ZERO;
+					quat searched_rotation = QUAT_IDENTITY, cursor_rotation = QUAT_IDENTITY;
+					vec3 searched_scale = VEC3_ONE, cursor_scale = VEC3_ONE;
+					clip->compressed.Sample(bone, time, true, searched_translation, searched_rotation, searched_scale);
+					clip->compressed.Sample(bone, time, true, cursor_translation, cursor_rotation, cursor_scale, &cursors[bone * ANIM_CURSORS_PER_CHANNEL]);
+					if (searched_translation != cursor_translation || searched_rotation != cursor_rotation)
+					{
+						plog::error("animation compression unit test failed: sampling with a cursor at %f gave a different result.\n", time);
+						success = false;
+						break;
+					}
+				}
+			}
+		}
+	}
+
+	// A looping clip which doesn't key its first or last frame should wrap around from its last key, instead of popping at the seam.
+	{
+		AnimationClip clip;
+		clip.duration = 2.0f;
+		clip.channels.resize(1);
+		clip.channels[0].position_keys.push_back(0.5f, vec3(0.0f, 0.0f, 0.0f));
+		clip.channels[0].position_keys.push_back(1.5f, vec3(0.0f, 0.0f, 4.0f));
+		CompressAnimationClip(clip.compressed, clip);
+
+		// 0.25 is three quarters of the way from the last key (at 1.5) around to the first (at 0.5 + 2.0).
+		vec3 looped = VEC3_ZERO, clamped = VEC3_ZERO;
+		quat rotation = QUAT_IDENTITY;
+		vec3 scale = VEC3_ONE;
+		clip.compressed.Sample(0, 0.25f, true, looped, rotation, scale);
+		clip.compressed.Sample(0, 0.25f, false, clamped, rotation, scale);
+		if (fabsf(looped.z - 1.0f) > 0.01f || fabsf(clamped.z) > 0.01f)
+		{
+			plog::error("animation compression unit test failed: sampling before the first key gave %f looping and %f not looping.\n", looped.z, clamped.z);
+			success = false;
+		}
+
+		// 1.75 is a quarter of the way from the last key around to the first.
+		clip.compressed.Sample(0, 1.75f, true, looped, rotation, scale);
+		clip.compressed.Sample(0, 1.75f, false, clamped, rotation, scale);
+		if (fabsf(looped.z - 3.0f) > 0.01f || fabsf(clamped.z - 4.0f) > 0.01f)
+		{
+			plog::error("animation compression unit test failed: sampling after the last key gave %f looping and %f not looping.\n", looped.z, clamped.z);
+			success = false;
+		}
+	}
+
+	return success;
+}
+
+void RunAnimationBenchmark()
+{
+	const int32_t NUM_BONES = 64;
+	const int NUM_KEYS = 120;
+	const int NUM_CLIPS = 32;
+	const int NUM_TICKS = 100;
+
+	// A crowd of characters each playing their own clip, so the keys don't all fit in the cache at once.
+	// The keys are jittered, so no track is evenly spaced and every version has to search for its keys.
+	std::vector<AnimationClip> clips(NUM_CLIPS), packed(NUM_CLIPS);
+	std::vector<FloatKeyBlock> blocks(NUM_CLIPS);
+	for (int c = 0; c < NUM_CLIPS; ++c)
+	{
+		AnimationClip& clip = clips[c];
+		clip.duration = (float)(NUM_KEYS - 1) / 30.0f;
+		clip.channels.resize(NUM_BONES);
+		for (int32_t bone = 0; bone < NUM_BONES; ++bone)
+		{
+			for (int key = 0; key < NUM_KEYS; ++key)
+			{
+				float time = (key == 0 || key == NUM_KEYS - 1) ? (float)key / 30.0f : ((float)key + test_random.Float(-0.25f, 0.25f)) / 30.0f;
+				clip.channels[bone].position_keys.push_back(time, vec3(test_random.Float(-1, 1), test_random.Float(-1, 1), test_random.Float(-1, 1)));
+				clip.channels[bone].rotation_keys.push_back(time, quat::euler({ test_random.Float(-1, 1), test_random.Float(-1, 1), test_random.Float(-1, 1) }).normalized());
+				clip.channels[bone].scale_keys.push_back(time, VEC3_ONE);
+			}
+		}
+
+		blocks[c].Build(clip);
+		packed[c] = clip;
+		CompressAnimationClip(packed[c].compressed, packed[c]);
+	}
+	std::vector<uint32_t> cursors(NUM_CLIPS * NUM_BONES * ANIM_CURSORS_PER_CHANNEL, 0);
+
+	// Plays every version of every clip forward, sampling every bone each tick.
+	// 0: full-precision keys per channel, 1: the same keys in one block, 2: 16-bit keys in one block, 3: the same with cursors, as AnimationController plays them.
+	double times[4];
+	vec3 checksum = VEC3_ZERO;
+	sys::Timer timer;
+	for (int version = 0; version < 4; ++version)
+	{
+		timer.update();
+		for (int tick = 0; tick < NUM_TICKS; ++tick)
+		{
+			for (int c = 0; c < NUM_CLIPS; ++c)
+			{
+				float time = fmodf((float)tick / 30.0f, clips[c].duration);
+				for (int32_t bone = 0; bone < NUM_BONES; ++bone)
+				{
+					vec3 translation = VEC3_ZERO, scale = VEC3_ONE;
+					quat rotation = QUAT_IDENTITY;
+					if (version == 0)
+						{ clips[c].getTransformForBone(bone, time, false, translation, rotation, scale); }
+					else if (version == 1)
+						{ blocks[c].Sample(bone, time, translation, rotation, scale); }
+					else if (version == 2)
+						{ packed[c].getTransformForBone(bone, time, false, translation, rotation, scale); }
+					else
+						{ packed[c].getTransformForBone(bone, time, false, translation, rotation, scale, &cursors[((c * NUM_BONES) + bone) * ANIM_CURSORS_PER_CHANNEL]); }
+					checksum += translation;
+				}
+			}
+		}
+		timer.update();
+		times[version] = timer.getDeltaTime() * 1000.0;
+	}
+
+	plog::info("Animation benchmark: %i ticks of %i clips with %i bones.\n", NUM_TICKS, NUM_CLIPS, NUM_BONES);
+	plog::info("  Layout, with full-precision keys: per channel took %.3f ms (%i bytes per clip), one block took %.3f ms (%i bytes per clip).\n",
+		times[0], (int)GetAnimationMemoryUsage(clips[0]), times[1], (int)blocks[0].getMemoryUsage());
+	plog::info("  Quantization, in one block: 16-bit keys took %.3f ms (%i bytes per clip), or %.3f ms with cursors. [%f]\n",
+		times[2], (int)packed[0].compressed.getMemoryUsage(), times[3], checksum.x + checksum.y + checksum.z);
+}
\ No newline at end of file
@@ -2,6 +2,7 @@
 
 #include "shader.h"
 #include "model.h"
+#include "math/simd/mat4.h"
 	
 #include <btBulletDynamicsCommon.h>
 #include "physics/physics_system.h"
@@ -19,8 +20,13 @@ namespace
 } // namespace <anon>
 
 AnimationController::AnimationController(Model* model, entity::ID id)
-:	model(model),
-	animspeed(1.0f)
+:	num_active_layers(0),
+	active_layers_dirty(true),
+	model(model),
+	animspeed(1.0f),
+	hold_finished_layers(false),
+	has_additive_positions(false),
+	has_additive_rotations(false)
 {
 	if (model)
 	{
@@ -108,7 +114,7 @@ const char* AnimationController::getAnimName(int layer)
 		{ return "N/A"; }
 	else
 	{
-		AnimationClip* clip = model->getAnimClip(layers[layer].now_state.anim_name.c_str);
+		AnimationClip* clip = layers[layer].now_state.clip;
 		if (clip == nullptr)
 			return "N/A";
 		else
@@ -122,7 +128,7 @@ float AnimationController::getAnimDuration(int layer)
 		{ return 0.0f; }
 	else
 	{
-		AnimationClip* clip = model->getAnimClip(layers[layer].now_state.anim_name.c_str);
+		AnimationClip* clip = layers[layer].now_state.clip;
 		if (clip == nullptr)
 			return 0.0f;
 		else
@@ -140,101 +146,143 @@ void AnimationController::Flip()
 	memcpy(bonedata.rawdata<ACM_PREV>(), bonedata.rawdata<ACM_NOW>(), sizeof(mat4) * bonedata.size());
 }
 
-vector<const char*> AnimationController::AnimationState::AdvanceTime(float delta_time)
+void AnimationController::AnimationState::setAnimation(const char* name)
 {
-	if (model == nullptr) return {};
-	AnimationClip* clip = model->getAnimClip(anim_name.c_str);
-	if (clip == nullptr) return {};
+	anim_name = name;
+	clip = (model != nullptr) ? model->getAnimClip(name) : nullptr;
+	bone_remap = nullptr;
+	num_bones = 0;
+	cursors.clear();
+	if (clip == nullptr)
+		return;
+
+	cursors.assign(clip->channels.size() * ANIM_CURSORS_PER_CHANNEL, 0);
+
+	// A model's own clips have one channel per bone in the same order, but imported clips might not.
+	bone_remap = model->getAnimBoneRemap(name);
+	num_bones = (size_t)model->getSkeleton().num_bones;
+}
+
+void AnimationController::AnimationState::AdvanceTime(float delta_time, int layer, AnimationEventList& out_events)
+{
+	if (clip == nullptr) return;
 
 	prev_time = now_time;
 	now_time += delta_time * speed;
 
+	bool wrapped = false;
 	if (looping)
 	{
 		while (now_time > clip->duration)
-			{ now_time -= clip->duration; }
+			{ now_time -= clip->duration; wrapped = true; }
 	}
 	else if (now_time > clip->duration)
 		{ now_time = clip->duration; }
 
 	// Get any animation events which have occured, so scripts can respond to them.
-	vector<const char*> result = clip->getEventsBetweenFrames(prev_time, now_time);
-
-	return result;
+	// Events right at the start only count when we're starting from there, so that no event is raised twice.
+	if (wrapped)
+	{
+		clip->getEventsBetweenFrames(prev_time, clip->duration, (prev_time <= 0.0f), layer, out_events);
+		clip->getEventsBetweenFrames(0.0f, now_time, true, layer, out_events);
+	}
+	else
+		{ clip->getEventsBetweenFrames(prev_time, now_time, (prev_time <= 0.0f), layer, out_events); }
 }
 
 void AnimationController::AnimationState::getTransformForBone(size_t bone_index, vec3& translation, quat& rotation, vec3& scale)
 {
-	if (model == nullptr) return;
-	AnimationClip* clip = model->getAnimClip(anim_name.c_str);
-	if (clip == nullptr) return;
+	if (clip == nullptr || bone_index >= num_bones) return;
+	int32_t channel = (bone_remap != nullptr) ? bone_remap[bone_index] : (int32_t)bone_index;
+	if (channel < 0 || (size_t)channel >= clip->channels.size()) return;
 
-	AnimationChannel& channel = clip->channels[bone_index];
-	if (channel.isEmpty() == false)
-	{
-		translation = channel.getValueAtTime(channel.position_keys, now_time, looping, VEC3_ZERO);
-		rotation = channel.getValueAtTime(channel.rotation_keys, now_time, looping, QUAT_IDENTITY);
-		scale = channel.getValueAtTime(channel.scale_keys, now_time, looping, VEC3_ONE);
-	}
+	clip->getTransformForBone(channel, now_time, looping, translation, rotation, scale, &cursors[channel * ANIM_CURSORS_PER_CHANNEL]);
 }
 
-vector<const char*> AnimationController::AnimationLayer::AdvanceTime(float delta_time)
+void AnimationController::AnimationLayer::AdvanceTime(float delta_time, int layer, AnimationEventList& out_events)
 {
-	if (model == nullptr) return {};
+	if (model == nullptr) return;
 
-	vector<const char*> result = prev_state.AdvanceTime(delta_time);
-	vector<const char*> result2 = now_state.AdvanceTime(delta_time);
-	result.insert(result.end(), result2.begin(), result2.end());
+	prev_state.AdvanceTime(delta_time, layer, out_events);
+	now_state.AdvanceTime(delta_time, layer, out_events);
 
 	transition_time += delta_time;
 	if (transition_time >= transition_duration)
 	{
-		prev_state.anim_name = "";
+		prev_state.setAnimation("");
 		transition_time = 0.0f;
 		transition_duration = 0.0f;
-		if (model->getAnimClip(now_state.anim_name.c_str) != nullptr && now_state.now_time >= model->getAnimClip(now_state.anim_name.c_str)->duration && now_state.looping == false)
+		if (now_state.clip != nullptr && now_state.now_time >= now_state.clip->duration && now_state.looping == false)
 		{
 			if (finished == false)
-				{ result.push_back("finished"); }
+				{ out_events.push(ANIM_EVENT_FINISHED, layer); }
 			finished = true;
 		}
 	}
-
-	return result;
 }
 
-void AnimationController::AnimationLayer::getTransformForBone(size_t bone_index, vec3& translation, quat& rotation, vec3& scale)
+void AnimationController::AnimationLayer::BlendPose(simd_4vec3* translations, simd_4quat* rotations, size_t num_bones)
 {
-	if (model == nullptr) return;
-	AnimationClip* now_clip = model->getAnimClip(now_state.anim_name.c_str);
-	AnimationClip* prev_clip = model->getAnimClip(prev_state.anim_name.c_str);
-
-	if (now_clip == nullptr && prev_clip == nullptr)
+	if (model == nullptr || (now_state.clip == nullptr && prev_state.clip == nullptr))
 		return;
 
-	vec3 now_translation = VEC3_ZERO;
-	quat now_rotation = QUAT_IDENTITY;
-	vec3 now_scale = VEC3_ONE;
-	now_state.getTransformForBone(bone_index, now_translation, now_rotation, now_scale);
+	bool transitioning = (prev_state.clip != nullptr && transition_duration > 0.0f && transition_time < transition_duration);
+	__m128 blend = _mm_set1_ps(transitioning ? (transition_time / transition_duration) : 1.0f);
+	vec3 scale = VEC3_ONE;
 
-	if (prev_clip == nullptr || transition_duration <= 0.0f || transition_time >= transition_duration)
+	for (size_t group = 0; group < (num_bones + 3) / 4; ++group)
 	{
-		translation = now_translation * weight;
-		rotation = quat::lerp(QUAT_IDENTITY, now_rotation, weight);
-		scale = now_scale * weight;
-		return;
-	}
+		// Masked bones (and the padding past the last bone) get no weight, which leaves them untouched.
+		alignas(16) float lane_weights[4];
+		bool any_bones = false;
+		for (uint32_t lane = 0; lane < 4; ++lane)
+		{
+			size_t bone = (group * 4) + lane;
+			bool affected = (bone < num_bones) && (bone >= MAX_MASKED_BONES || mask[bone]);
+			lane_weights[lane] = affected ? weight : 0.0f;
+			any_bones = any_bones || affected;
+		}
+		if (!any_bones)
+			continue;
 
-	vec3 prev_translation = VEC3_ZERO;
-	quat prev_rotation = QUAT_IDENTITY;
-	vec3 prev_scale = VEC3_ONE;
-	prev_state.getTransformForBone(bone_index, prev_translation, prev_rotation, prev_scale);
+		simd_4vec3 now_translation = simd_4vec3_zero();
+		simd_4quat now_rotation = simd_4quat_identity();
+		for (uint32_t lane = 0; lane < 4; ++lane)
+		{
+			if (lane_weights[lane] == 0.0f)
+				continue;
 
-	float blend = transition_time / transition_duration;
+			vec3 translation = VEC3_ZERO;
+			quat rotation = QUAT_IDENTITY;
+			now_state.getTransformForBone((group * 4) + lane, translation, rotation, scale);
+			set_vec3(now_translation, lane, translation);
+			set_quat(now_rotation, lane, rotation);
+		}
+
+		if (transitioning)
+		{
+			simd_4vec3 prev_translation = simd_4vec3_zero();
+			simd_4quat prev_rotation = simd_4quat_identity();
+			for (uint32_t lane = 0; lane < 4; ++lane)
+			{
+				if (lane_weights[lane] == 0.0f)
+					continue;
+
+				vec3 translation = VEC3_ZERO;
+				quat rotation = QUAT_IDENTITY;
+				prev_state.getTransformForBone((group * 4) + lane, translation, rotation, scale);
+				set_vec3(prev_translation, lane, translation);
+				set_quat(prev_rotation, lane, rotation);
+			}
 
-	translation = vec3::lerp(prev_translation, now_translation, blend) * weight;
-	rotation = quat::lerp(QUAT_IDENTITY, quat::lerp(prev_rotation, now_rotation, blend), weight);
-	scale = vec3::lerp(prev_scale, now_scale, blend) * weight;
+			now_translation = lerp(prev_translation, now_translation, blend);
+			now_rotation = lerp(prev_rotation, now_rotation, blend);
+		}
+
+		__m128 weights = _mm_load_ps(lane_weights);
+		translations[group] += now_translation * weights;
+		rotations[group] = rotations[group] * lerp(simd_4quat_identity(), now_rotation, weights);
+	}
 }
 
 void AnimationController::AnimationLayer::PlayAnimation(Model* model, const char* anim_name, bool loop, float speed, float transition)
@@ -244,7 +292,7 @@ void AnimationController::AnimationLayer::PlayAnimation(Model* model, const char
 
 	prev_state = now_state;
 //	now_state.anim_index = anim_index;
-	now_state.anim_name = anim_name;
+	now_state.setAnimation(anim_name);
 
 	now_state.prev_time = 0.0f;
 	now_state.now_time = 0.0f;
@@ -255,72 +303,174 @@ void AnimationController::AnimationLayer::PlayAnimation(Model* model, const char
 	finished = false;
 }
 
-vector<const char*> AnimationController::CalcNextFrame(mat4 root_transform, double delta_time)
+void AnimationController::UpdateActiveLayers()
 {
-	if (model == nullptr)
+	// Layers without any weight or without an animation contribute nothing, so there's no need to visit them for every bone.
+	num_active_layers = 0;
+	for (int i = 0; i < NUM_ANIM_LAYERS; ++i)
 	{
-		for (size_t i = 0; i < bonedata.size(); ++i)
-		{
-			bonedata.get<ACM_PREV>(i) = MAT4_IDENTITY;
-			bonedata.get<ACM_NOW>(i) = MAT4_IDENTITY;
-		}
-
-		return {};
+		if (layers[i].weight != 0.0f && (layers[i].now_state.clip != nullptr || layers[i].prev_state.clip != nullptr))
+			{ active_layers[num_active_layers++] = i; }
 	}
+	active_layers_dirty = false;
+}
+
+int32_t AnimationPoseKey::QuantizeBlend(float transition_time, float transition_duration)
+{
+	// This matches the test BlendPose uses to decide whether a layer is transitioning.
+	if (transition_duration <= 0.0f || transition_time >= transition_duration)
+		return -1;
+
+	return (int32_t)floorf(((transition_time / transition_duration) * BLEND_STEPS) + 0.5f);
+}
 
-	vector<const char*> result;
+size_t AnimationPoseKey::hash() const
+{
+	// FNV-1a, over every byte of the key.
+	const uint8_t* bytes = (const uint8_t*)this;
+	uint64_t result = 14695981039346656037ull;
+	for (size_t i = 0; i < sizeof(AnimationPoseKey); ++i)
+		{ result = (result ^ bytes[i]) * 1099511628211ull; }
+	return (size_t)result;
+}
+
+void AnimationController::CalcNextFrame(mat4 root_transform, double delta_time)
+{
+	AdvanceTime(delta_time);
+	CalcPose();
+	SolveIK(root_transform);
+}
+
+void AnimationController::AdvanceTime(double delta_time)
+{
+	events.clear();
+	if (model == nullptr)
+		return;
 
 	for (int i = 0; i < NUM_ANIM_LAYERS; ++i)
 	{
-		vector<const char*> layer_result = layers[i].AdvanceTime((float)delta_time * animspeed);
-		result.insert(result.end(), layer_result.begin(), layer_result.end());
+		layers[i].AdvanceTime((float)delta_time * animspeed, i, events);
 
-		if (layers[i].finished == true && i != 0)
+		// Finished layers (other than the base layer) stop playing entirely.
+		if (layers[i].finished == true && i != 0 && !hold_finished_layers && (layers[i].now_state.clip != nullptr || layers[i].prev_state.clip != nullptr))
 		{
-			layers[i].now_state.anim_name = "";
-			layers[i].prev_state.anim_name = "";
+			layers[i].now_state.setAnimation("");
+			layers[i].prev_state.setAnimation("");
+			active_layers_dirty = true;
 			continue;
 		}
 	}
 
-	// Calculate the bone transforms.
-	for (size_t i = 0; i < bonedata.size(); ++i)
+	if (active_layers_dirty)
+		{ UpdateActiveLayers(); }
+}
+
+bool AnimationController::getPoseKey(AnimationPoseKey& out, float time_quantum)
+{
+	memset(&out, 0, sizeof(AnimationPoseKey));
+	if (model == nullptr || hasAdditivePose() || time_quantum <= 0.0f)
+		return false;
+
+	// Layer masks can't be changed yet, so they're the same for everyone and don't need to be part of the key.
+	out.model = model;
+	out.num_layers = num_active_layers;
+	for (int j = 0; j < num_active_layers; ++j)
 	{
-		vec3 total_translation = VEC3_ZERO;
-		quat total_rotation = QUAT_IDENTITY;
-		vec3 total_scale = VEC3_ONE;
+		const AnimationLayer& layer = layers[active_layers[j]];
+		AnimationPoseKey::Layer& key = out.layers[j];
+
+		key.now_clip = layer.now_state.clip;
+		key.now_time = (int32_t)floorf((layer.now_state.now_time / time_quantum) + 0.5f);
+		key.looping = layer.now_state.looping ? 1 : 0;
+		key.weight = layer.weight;
 
-		for (int j = 0; j < NUM_ANIM_LAYERS; ++j)
+		// The previous animation only matters while it's still being blended out.
+		key.blend = (layer.prev_state.clip != nullptr) ? AnimationPoseKey::QuantizeBlend(layer.transition_time, layer.transition_duration) : -1;
+		if (key.blend >= 0)
 		{
-			vec3 translation = VEC3_ZERO;
-			quat rotation = QUAT_IDENTITY;
-			vec3 scale = VEC3_ONE;
+			key.prev_clip = layer.prev_state.clip;
+			key.prev_time = (int32_t)floorf((layer.prev_state.now_time / time_quantum) + 0.5f);
+			key.looping |= layer.prev_state.looping ? 2 : 0;
+		}
+	}
+
+	return true;
+}
 
-			layers[j].getTransformForBone(i, translation, rotation, scale);
+void AnimationController::CopyPose(AnimationController& source)
+{
+	if (model == nullptr || source.model != model)
+		return;
+
+	memcpy(bonedata.rawdata<ACM_NOW>(), source.bonedata.rawdata<ACM_NOW>(), sizeof(mat4) * bonedata.size());
+}
 
-			total_translation += translation;
-			total_rotation *= rotation;
-			total_scale += scale;
+void AnimationController::CalcPose()
+{
+	if (model == nullptr)
+	{
+		for (size_t i = 0; i < bonedata.size(); ++i)
+		{
+			bonedata.get<ACM_PREV>(i) = MAT4_IDENTITY;
+			bonedata.get<ACM_NOW>(i) = MAT4_IDENTITY;
 		}
-		
-		total_rotation.normalize();
 
-		// Apply the bone's local additive pose.
-		total_translation += bonedata.get<AC_ADDPOS>(i);
-		total_rotation *= bonedata.get<AC_ADDROT>(i);
+		return;
+	}
 
-		mat4 local_matrix = mat4::translation(total_translation) * mat4::rotation(total_rotation); // * mat4::scale(scale);
+	// Blend every active layer into the pose, four bones at a time.
+	size_t num_bones = bonedata.size();
+	size_t num_groups = (num_bones + 3) / 4;
+	pose_translations.assign(num_groups, simd_4vec3_zero());
+	pose_rotations.assign(num_groups, simd_4quat_identity());
+	for (int j = 0; j < num_active_layers; ++j)
+		{ layers[active_layers[j]].BlendPose(pose_translations.data(), pose_rotations.data(), num_bones); }
 
-		// Include the bone-to-parent matrix.
-		bonedata.get<ACM_NOW>(i) = model->getSkeleton().to_parent[i] * local_matrix;
+	// Calculate the bone transforms.
+	for (size_t group = 0; group < num_groups; ++group)
+	{
+		size_t first_bone = group * 4;
+		size_t num_lanes = min<size_t>(4, num_bones - first_bone);
+
+		// Apply each bone's local additive pose.
+		simd_4vec3 additive_translation = simd_4vec3_zero();
+		simd_4quat additive_rotation = simd_4quat_identity();
+		for (uint32_t lane = 0; lane < num_lanes; ++lane)
+		{
+			set_vec3(additive_translation, lane, bonedata.get<AC_ADDPOS>(first_bone + lane));
+			set_quat(additive_rotation, lane, bonedata.get<AC_ADDROT>(first_bone + lane));
+		}
+		simd_4vec3 translation = pose_translations[group] + additive_translation;
+		simd_4quat rotation = normalized(pose_rotations[group]) * additive_rotation;
+
+		mat4 local_matrices[4];
+		to_mat4(translation, rotation, local_matrices); // * mat4::scale(scale);
 
-		// If this bone has a parent (which it should if it's not 'root'), transform it according to its parent.
-		int parent_index = model->getSkeleton().parent_index[i];
-		if (parent_index >= 0 && parent_index < (int)i)
-			{ bonedata.get<ACM_NOW>(i) = bonedata.get<ACM_NOW>(parent_index) * bonedata.get<ACM_NOW>(i); }
+		for (uint32_t lane = 0; lane < num_lanes; ++lane)
+		{
+			size_t i = first_bone + lane;
+
+			// Include the bone-to-parent matrix.
+			bonedata.get<ACM_NOW>(i) = simd_multiply(model->getSkeleton().to_parent[i], local_matrices[lane]);
+
+			// If this bone has a parent (which it should if it's not 'root'), transform it according to its parent.
+			// Parents always come before their children, so even a parent in this same group is already finished.
+			int parent_index = model->getSkeleton().parent_index[i];
+			if (parent_index >= 0 && parent_index < (int)i)
+				{ bonedata.get<ACM_NOW>(i) = simd_multiply(bonedata.get<ACM_NOW>(parent_index), bonedata.get<ACM_NOW>(i)); }
+		}
 
 		// The only transformation left is the InvGlobalBindPose, which we'll do in the display update so we can use the current data right now.
-		
+	}
+}
+
+void AnimationController::ApplyMotionStates(mat4 root_transform)
+{
+	if (model == nullptr)
+		return;
+
+	for (size_t i = 0; i < bonedata.size(); ++i)
+	{
 		if (bonedata.get<AC_MOTIONSTATE>(i) != nullptr)
 		{
 			// Only do this if the rigidbody is kinematic!
@@ -339,10 +489,7 @@ vector<const char*> AnimationController::CalcNextFrame(mat4 root_transform, doub
 			world_transform.setOrigin({ world_position.x, world_position.y, world_position.z });
 			bonedata.get<AC_MOTIONSTATE>(i)->setWorldTransform(world_transform);
 		}
-	
 	}
-
-	return result;
 }
 
 void AnimationController::CalcMatrices(float interpolation)
@@ -389,6 +536,16 @@ void AnimationController::getAnimatedBoneTransform(int bone_index, vec3& out_pos
 	out_rotation = matrix.extract_rotation();
 }
 
+mat4 AnimationController::getBoneMatrix(int bone_index, float interpolation)
+{
+	if (model == nullptr || bone_index < 0 || bone_index >= (int)bonedata.size())
+		return MAT4_IDENTITY;
+
+	vec3 translation = vec3::lerp(bonedata.get<ACM_PREV>(bone_index).extract_position(), bonedata.get<ACM_NOW>(bone_index).extract_position(), interpolation);
+	quat rotation = quat::lerp(bonedata.get<ACM_PREV>(bone_index).extract_rotation(), bonedata.get<ACM_NOW>(bone_index).extract_rotation(), interpolation);
+	return model->getImportTransform() * mat4::translation(translation) * mat4::rotation(rotation);
+}
+
 // Additive pose
 
 void AnimationController::setBoneAdditivePosition(int bone_index, vmath::vec3 pos)
@@ -397,6 +554,7 @@ void AnimationController::setBoneAdditivePosition(int bone_index, vmath::vec3 po
 		return;
 
 	bonedata.get<AC_ADDPOS>(bone_index) = pos;
+	has_additive_positions = true;
 }
 
 void AnimationController::setBoneAdditivePositionLocal(int bone_index, vmath::vec3 pos)
@@ -405,6 +563,7 @@ void AnimationController::setBoneAdditivePositionLocal(int bone_index, vmath::ve
 		return;
 
 	bonedata.get<AC_ADDPOS>(bone_index) = pos;
+	has_additive_positions = true;
 
 	// Set the additive position for this bone's immediate children to be the inverse of their parent's.
 	for (int i = bone_index; i < model->getSkeleton().num_bones; ++i)
@@ -428,6 +587,7 @@ void AnimationController::ClearAdditivePositions()
 
 	for (int i = 0; i < (int)model->getSkeleton().num_bones; ++i)
 		{ bonedata.get<AC_ADDPOS>(i) = VEC3_ZERO; }
+	has_additive_positions = false;
 }
 
 void AnimationController::setBoneAdditiveRotation(int bone_index, quat rot)
@@ -436,6 +596,7 @@ void AnimationController::setBoneAdditiveRotation(int bone_index, quat rot)
 		return;
 
 	bonedata.get<AC_ADDROT>(bone_index) = rot;
+	has_additive_rotations = true;
 }
 
 void AnimationController::setBoneAdditiveRotationLocal(int bone_index, quat rot)
@@ -444,6 +605,7 @@ void AnimationController::setBoneAdditiveRotationLocal(int bone_index, quat rot)
 		return;
 
 	bonedata.get<AC_ADDROT>(bone_index) = rot;
+	has_additive_rotations = true;
 
 	// Set the additive position for this bone's immediate children to be the inverse of their parent's.
 	for (int i = bone_index; i < model->getSkeleton().num_bones; ++i)
@@ -467,4 +629,171 @@ void AnimationController::ClearAdditiveRotations()
 
 	for (int i = 0; i < (int)model->getSkeleton().num_bones; ++i)
 		{ bonedata.get<AC_ADDROT>(i) = QUAT_IDENTITY; }
+	has_additive_rotations = false;
+}
+
+// Inverse kinematics
+
+int32_t AnimationController::AddIKChain(IKSolverEnum solver, const int32_t* bones, int32_t num_bones)
+{
+	if (model == nullptr)
+		return -1;
+
+	bool valid_length = false;
+	switch (solver)
+	{
+	case IK_SOLVER_TWO_BONE: valid_length = (num_bones == 3); break;
+	case IK_SOLVER_LOOK_AT: valid_length = (num_bones == 1); break;
+	case IK_SOLVER_FABRIK: valid_length = (num_bones >= 2 && num_bones <= MAX_IK_CHAIN_BONES); break;
+	}
+	if (valid_length == false)
+	{
+		plog::error("An IK chain can't be made out of %i bones with that solver.\n", num_bones);
+		return -1;
+	}
+
+	const Model::Skeleton& skeleton = model->getSkeleton();
+	for (int32_t i = 0; i < num_bones; ++i)
+	{
+		if (bones[i] < 0 || bones[i] >= (int32_t)skeleton.num_bones)
+		{
+			plog::error("Bone %i of an IK chain doesn't exist.\n", i);
+			return -1;
+		}
+
+		// Each bone has to hang off of the one before it, or moving one wouldn't move the next.
+		if (i > 0)
+		{
+			int32_t ancestor = skeleton.parent_index[bones[i]];
+			while (ancestor >= 0 && ancestor != bones[i - 1])
+				{ ancestor = skeleton.parent_index[ancestor]; }
+			if (ancestor < 0)
+			{
+				plog::error("Bone %i of an IK chain isn't a descendant of the bone before it.\n", i);
+				return -1;
+			}
+		}
+	}
+
+	IKChain chain;
+	chain.solver = solver;
+	chain.num_bones = num_bones;
+	for (int32_t i = 0; i < num_bones; ++i)
+		{ chain.bones[i] = bones[i]; }
+	ik_chains.push_back(chain);
+	return (int32_t)ik_chains.size() - 1;
+}
+
+void AnimationController::setIKTarget(int32_t chain, vec3 target, float weight)
+{
+	if (chain < 0 || chain >= (int32_t)ik_chains.size())
+		return;
+
+	ik_chains[chain].target = target;
+	ik_chains[chain].weight = clampf(weight, 0.0f, 1.0f);
+}
+
+void AnimationController::setIKPole(int32_t chain, vec3 pole)
+{
+	if (chain < 0 || chain >= (int32_t)ik_chains.size())
+		return;
+
+	ik_chains[chain].pole = pole;
+	ik_chains[chain].has_pole = true;
+}
+
+void AnimationController::setIKLookAtAxis(int32_t chain, vec3 axis, float max_angle)
+{
+	if (chain < 0 || chain >= (int32_t)ik_chains.size() || axis.magnitude_squared() <= 0.0f)
+		return;
+
+	ik_chains[chain].aim_axis = axis.normalized();
+	ik_chains[chain].max_angle = clampf(max_angle, 0.0f, PI);
+}
+
+void AnimationController::SolveIK(const mat4& root_transform)
+{
+	if (model == nullptr || ik_chains.empty())
+		return;
+
+	// Targets are given in world space, but the pose is in the model's space.
+	mat4 world_to_model = (root_transform * model->getImportTransform()).inverted();
+	const Model::Skeleton& skeleton = model->getSkeleton();
+	ik_bone_deltas.resize(bonedata.size());
+
+	// Chains are solved in the order they were added, so a chain can build on one further up the skeleton (a spine, then an arm).
+	for (const IKChain& chain : ik_chains)
+	{
+		if (chain.weight <= 0.0f)
+			continue;
+
+		vec3 target = (world_to_model * vec4(chain.target, 1.0f)).xyz;
+		vec3 joints[MAX_IK_CHAIN_BONES];
+		for (int32_t i = 0; i < chain.num_bones; ++i)
+			{ joints[i] = bonedata.get<ACM_NOW>(chain.bones[i]).extract_position(); }
+
+		// Work out which way each bone in the chain should be pointing.
+		// A look-at bone points its aim axis at the target; otherwise, each bone points at the next joint.
+		int32_t num_segments = chain.num_bones - 1;
+		vec3 solved[MAX_IK_CHAIN_BONES];
+		vec3 aim = VEC3_ZERO;
+		switch (chain.solver)
+		{
+		case IK_SOLVER_TWO_BONE:
+		{
+			vec3 bend_hint = chain.has_pole ? (world_to_model * vec4(chain.pole, 1.0f)).xyz - joints[0] : joints[1] - joints[0];
+			SolveTwoBoneIK(joints, target, bend_hint, solved);
+		} break;
+		case IK_SOLVER_LOOK_AT:
+			num_segments = 1;
+			aim = (bonedata.get<ACM_NOW>(chain.bones[0]) * vec4(chain.aim_axis, 0.0f)).xyz;
+			solved[0] = joints[0];
+			solved[1] = target;
+			break;
+		case IK_SOLVER_FABRIK:
+			for (int32_t i = 0; i < chain.num_bones; ++i)
+				{ solved[i] = joints[i]; }
+			SolveFABRIK(solved, chain.num_bones, target, chain.max_iterations, chain.tolerance);
+			break;
+		}
+
+		// Turn the solved joints into a correction for each segment, rotating it about its first joint.
+		// Each correction includes the ones before it, since turning a bone carries everything after it along.
+		mat4 deltas[MAX_IK_CHAIN_BONES];
+		mat4 delta = MAT4_IDENTITY;
+		for (int32_t i = 0; i < num_segments; ++i)
+		{
+			vec3 pivot = (delta * vec4(joints[i], 1.0f)).xyz;
+			vec3 from = (chain.solver == IK_SOLVER_LOOK_AT) ? (delta * vec4(aim, 0.0f)).xyz : (delta * vec4(joints[i + 1], 1.0f)).xyz - pivot;
+			vec3 to = solved[i + 1] - ((chain.solver == IK_SOLVER_LOOK_AT) ? pivot : solved[i]);
+
+			vec3 axis = vec3::cross(from, to);
+			float axis_length = axis.magnitude();
+			if (axis_length > 0.000001f)
+			{
+				float angle = atan2f(axis_length, vec3::dot(from, to));
+				if (chain.solver == IK_SOLVER_LOOK_AT)
+					{ angle = fminf(angle, chain.max_angle); }
+				delta = mat4::translation(pivot) * mat4::rotation(axis / axis_length, angle * chain.weight) * mat4::translation(-pivot) * delta;
+			}
+			deltas[i] = delta;
+		}
+
+		// Apply the corrections in one pass down the skeleton, starting at the root of the chain.
+		// Bones in the chain take their own correction, and every other bone takes its parent's, so whole limbs move together.
+		int32_t next = 0;
+		for (int32_t bone = chain.bones[0]; bone < (int32_t)bonedata.size(); ++bone)
+		{
+			int32_t parent = skeleton.parent_index[bone];
+			if (next < num_segments && bone == chain.bones[next])
+				{ ik_bone_deltas[bone] = next++; }
+			else if (bone != chain.bones[0] && parent >= chain.bones[0])
+				{ ik_bone_deltas[bone] = ik_bone_deltas[parent]; }
+			else
+				{ ik_bone_deltas[bone] = -1; }
+
+			if (ik_bone_deltas[bone] >= 0)
+				{ bonedata.get<ACM_NOW>(bone) = simd_multiply(deltas[ik_bone_deltas[bone]], bonedata.get<ACM_NOW>(bone)); }
+		}
+	}
 }
\ No newline at end of file
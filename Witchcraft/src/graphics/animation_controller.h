@@ -2,14 +2,20 @@
 #define HVH_WC_GRAPHICS_ANIMATIONCONTROLLER_H
 
 #include "math/vmath.h"
+#include "math/simd/4vec3.h"
+#include "math/simd/4quat.h"
+#include "animation_events.h"
+#include "animation_ik.h"
 #include "tools/structofarrays.h"
 #include "tools/fixedstring.h"
 #include <vector>
 #include <memory>
+#include <cstring>
 
 #include "scene/entity.h"
 
 constexpr const int NUM_ANIM_LAYERS = 8;
+constexpr const int MAX_MASKED_BONES = 256;
 
 class Model;
 struct AnimationClip;
@@ -19,6 +25,44 @@ class PhysicsSystem;
 class btRigidBody;
 class btMotionState;
 
+// Identifies everything that goes into a controller's pose, so controllers which would calculate the same pose can share one.
+// Times are rounded to a 'time quantum', so controllers only need to be close to each other rather than exactly in step.
+struct AnimationPoseKey
+{
+	struct Layer
+	{
+		const AnimationClip* now_clip;
+		const AnimationClip* prev_clip;
+		int32_t now_time, prev_time;
+		int32_t blend; // How far through its transition the layer is, or -1 if it isn't transitioning.
+		int32_t looping;
+		float weight;
+	};
+
+	// Transitions are blended by how far through them a layer is, rather than how long it's been, so that's what goes in the key.
+	static constexpr const float BLEND_STEPS = 64.0f;
+	/* Rounds how far through a transition a layer is to one of BLEND_STEPS, or returns -1 if it isn't transitioning. */
+	static int32_t QuantizeBlend(float transition_time, float transition_duration);
+
+	Model* model;
+	int32_t num_layers;
+	Layer layers[NUM_ANIM_LAYERS];
+
+	// Keys are cleared before they're filled in, so even their padding can be compared.
+	bool operator==(const AnimationPoseKey& rhs) const
+		{ return memcmp(this, &rhs, sizeof(AnimationPoseKey)) == 0; }
+
+	size_t hash() const;
+};
+
+struct AnimationPoseKeyHash
+{
+	size_t operator()(const AnimationPoseKey& key) const
+		{ return key.hash(); }
+};
+
+bool RunAnimationControllerUnitTests();
+
 class AnimationController
 {
 public:
@@ -28,23 +72,62 @@ public:
 	static void initShaders();
 
 	void Flip();
-	std::vector<const char*> CalcNextFrame(vmath::mat4 root_transform, double delta_time = (1.0 / 30.0));
+	// CalcNextFrame only touches this controller, so different controllers can run it at the same time.
+	// Anything shared with Bullet waits for ApplyMotionStates, which must be called from one thread at a time.
+	void CalcNextFrame(vmath::mat4 root_transform, double delta_time = (1.0 / 30.0));
+	// CalcNextFrame is made up of these steps, which can be split up so that poses can be shared in between them.
+	// IK comes last, since it depends on where this controller's entity is, and so can't be shared.
+	void AdvanceTime(double delta_time);
+
+	// The events raised by the last AdvanceTime.
+	const AnimationEventList& getEvents()
+		{ return events; }
+	void CalcPose();
+
+	/* Describes the pose this controller is about to calculate.  Returns false if it can't be shared, because of an additive pose. */
+	bool getPoseKey(AnimationPoseKey& out, float time_quantum);
+	/* Takes the pose another controller calculated, instead of calculating it.  Both must be using the same model. */
+	void CopyPose(AnimationController& source);
+	/* Bends every IK chain with any weight towards its target, on top of the pose from CalcPose or CopyPose. */
+	void SolveIK(const vmath::mat4& root_transform);
+	void ApplyMotionStates(vmath::mat4 root_transform);
 	void CalcMatrices(float interpolation);
 	void UploadMatrices();
 
+	Model* getModel()
+		{ return model; }
+
+	// The matrices uploaded to the skinning shaders, as of the last CalcMatrices.
+	const vmath::mat4* getFinalMatrices()
+		{ return bonedata.rawdata<ACM_FINAL>(); }
+	size_t getNumBones()
+		{ return bonedata.size(); }
+
 //	int findAnimIndex(const char* anim_name);
 	void PlayAnimation(int layer, const char* anim_name, bool loop = false, float speed = 1.0f, float transition = 0.0f)
 	{
 		if (layer >= 0 && layer < NUM_ANIM_LAYERS) 
-			{ layers[layer].PlayAnimation(model, anim_name, loop, speed, transition); }
+		{
+			layers[layer].PlayAnimation(model, anim_name, loop, speed, transition);
+			active_layers_dirty = true;
+		}
 	}
 	const char* getAnimName(int layer);
 
 	void setAnimLayerWeight(int layer, float val)
-		{ if (layer >= 0 && layer < NUM_ANIM_LAYERS) layers[layer].weight = val; }
+		{ if (layer >= 0 && layer < NUM_ANIM_LAYERS) { layers[layer].weight = val; active_layers_dirty = true; } }
 	float getAnimLayerWeight(int layer)
 		{ if (layer >= 0 && layer < NUM_ANIM_LAYERS) return layers[layer].weight; else return 0.0f; }
 
+	// Sets how fast one layer's current animation plays, on top of the controller's overall speed.
+	void setAnimLayerSpeed(int layer, float val)
+		{ if (layer >= 0 && layer < NUM_ANIM_LAYERS) layers[layer].now_state.speed = val; }
+
+	// Normally, a finished non-looping animation on any layer but the first stops playing.
+	// When this is set, they hold their last frame instead, so something else can decide when they're done.
+	void setHoldFinishedLayers(bool val)
+		{ hold_finished_layers = val; }
+
 	float getAnimSpeed()
 		{ return animspeed; }
 	void setAnimSpeed(float new_speed)
@@ -68,6 +151,12 @@ public:
 		{ if (layer < 0 || layer >= NUM_ANIM_LAYERS) return 0.0f; else return layers[layer].now_state.now_time; }
 
 	void getAnimatedBoneTransform(int bone_index, vmath::vec3& out_position, vmath::quat& out_rotataion, const vmath::mat4& root_transform = vmath::MAT4_IDENTITY);
+	/* Returns the bone's matrix, interpolated between the last two poses, in the space of the entity's transform (including the model's import transform). */
+	/* This is what things attached to the bone follow. */
+	vmath::mat4 getBoneMatrix(int bone_index, float interpolation);
+
+	bool hasAdditivePose()
+		{ return (has_additive_positions || has_additive_rotations); }
 
 	void setBoneAdditivePosition(int bone_index, vmath::vec3 pos);
 	void setBoneAdditivePositionLocal(int bone_index, vmath::vec3 pos);
@@ -79,6 +168,24 @@ public:
 	vmath::quat getBoneAdditiveRotation(int bone_index);
 	void ClearAdditiveRotations();
 
+	/* Adds an IK chain made of the given bones, listed from the root of the chain to its tip (see graphics/animation_ik.h). */
+	/* Returns a handle to the chain, or -1 if the bones don't fit the solver.  New chains have no weight until they're given a target. */
+	int32_t AddIKChain(IKSolverEnum solver, const int32_t* bones, int32_t num_bones);
+	void setIKTarget(int32_t chain, vmath::vec3 target, float weight = 1.0f);
+	void setIKPole(int32_t chain, vmath::vec3 pole);
+	void ClearIKPole(int32_t chain)
+		{ if (chain >= 0 && chain < (int32_t)ik_chains.size()) ik_chains[chain].has_pole = false; }
+	void setIKWeight(int32_t chain, float weight)
+		{ if (chain >= 0 && chain < (int32_t)ik_chains.size()) ik_chains[chain].weight = clampf(weight, 0.0f, 1.0f); }
+	float getIKWeight(int32_t chain)
+		{ if (chain >= 0 && chain < (int32_t)ik_chains.size()) return ik_chains[chain].weight; else return 0.0f; }
+	void setIKLookAtAxis(int32_t chain, vmath::vec3 axis, float max_angle = PI);
+	void ClearIKChains()
+		{ ik_chains.clear(); }
+
+	bool hasIK()
+		{ return ik_chains.empty() == false; }
+
 private:
 
 	struct AnimationState
@@ -86,6 +193,9 @@ private:
 		AnimationState()
 		:	model(nullptr),
 			anim_name(""),
+			clip(nullptr),
+			bone_remap(nullptr),
+			num_bones(0),
 			prev_time(0),
 			now_time(0),
 			speed(1),
@@ -95,15 +205,26 @@ private:
 		Model* model;
 //		int anim_index;
 		FixedString<32> anim_name;
-//		AnimationClip* clip;
+		AnimationClip* clip;
+
+		// Which of the clip's channels animates each bone (see Model::getAnimBoneRemap), or nullptr if channels and bones line up.
+		const int32_t* bone_remap;
+		size_t num_bones;
+
 		float prev_time;
 		float now_time;
 		float speed;
 		bool looping;
 
+		// Where each channel's tracks were last sampled, so the next sample can start looking from there.
+		std::vector<uint32_t> cursors;
+
 		void setmodel(Model* modelptr) { model = modelptr; }
 
-		std::vector<const char*> AdvanceTime(float delta_time);
+		// Looks up the clip and the bone remap its model worked out when it was imported, so playing it doesn't have to.
+		void setAnimation(const char* name);
+
+		void AdvanceTime(float delta_time, int layer, AnimationEventList& out_events);
 		void getTransformForBone(size_t bone_index, vmath::vec3& translation, vmath::quat& rotation, vmath::vec3& scale);
 	};
 
@@ -114,8 +235,12 @@ private:
 			transition_duration(0.0f),
 			transition_time(0.0f),
 			finished(false),
-			weight(0.0f)
-		{}
+			weight(0.0f),
+			mask_blend(false)
+		{
+			for (int i = 0; i < MAX_MASKED_BONES; ++i)
+				{ mask[i] = true; }
+		}
 
 		Model* model;
 		AnimationState prev_state;
@@ -126,20 +251,42 @@ private:
 
 		float weight;
 
-		bool mask[256];
+		// Bones which are false here are left alone by this layer.
+		bool mask[MAX_MASKED_BONES];
 		bool mask_blend;
 
 		void setmodel(Model* modelptr) { model = modelptr; prev_state.setmodel(modelptr); now_state.setmodel(modelptr); }
 
-		std::vector<const char*> AdvanceTime(float delta_time);
-		void getTransformForBone(size_t bone_index, vmath::vec3& translation, vmath::quat& rotation, vmath::vec3& scale);
+		void AdvanceTime(float delta_time, int layer, AnimationEventList& out_events);
+		// Samples this layer for every bone and blends it into the pose, four bones at a time.
+		void BlendPose(vmath::simd_4vec3* translations, vmath::simd_4quat* rotations, size_t num_bones);
 		void PlayAnimation(Model* model, const char* anim_name, bool loop, float speed, float transition);
 	};
 
 	AnimationLayer layers[NUM_ANIM_LAYERS];
+	AnimationEventList events;
+
+	// The layers which have something to contribute, rebuilt whenever a layer's animation or weight changes.
+	int active_layers[NUM_ANIM_LAYERS];
+	int num_active_layers;
+	bool active_layers_dirty;
+	void UpdateActiveLayers();
+
+	// The blended pose, four bones to an element.  Kept around so it doesn't need to be reallocated every frame.
+	std::vector<vmath::simd_4vec3> pose_translations;
+	std::vector<vmath::simd_4quat> pose_rotations;
+
+	std::vector<IKChain> ik_chains;
+	// Which of a chain's corrections applies to each bone, while the chain is being solved.
+	std::vector<int32_t> ik_bone_deltas;
 
 	Model* model;
 	float animspeed;
+	bool hold_finished_layers;
+
+	// Additive poses are specific to one controller, so they keep its pose from being shared.
+	bool has_additive_positions;
+	bool has_additive_rotations;
 
 	enum PerBoneSoaEnum
 	{
@@ -0,0 +1,31 @@
+#include "animation_controller.h"
+
+#include "sys/printlog.h"
+
+bool RunAnimationControllerUnitTests()
+{
+	bool success = true;
+
+	// Two controllers 0.1 seconds into the same transition, one of which is 0.2 seconds long and the other 0.4, are at different points in it.
+	if (AnimationPoseKey::QuantizeBlend(0.1f, 0.2f) == AnimationPoseKey::QuantizeBlend(0.1f, 0.4f))
+	{
+		plog::error("animation controller unit test failed: transitions of different lengths shared a pose key.\n");
+		success = false;
+	}
+
+	// Halfway through either transition is the same blend, though, so those can share.
+	if (AnimationPoseKey::QuantizeBlend(0.1f, 0.2f) != AnimationPoseKey::QuantizeBlend(0.2f, 0.4f))
+	{
+		plog::error("animation controller unit test failed: transitions at the same blend didn't share a pose key.\n");
+		success = false;
+	}
+
+	// Layers which aren't transitioning (or have just finished) aren't blending at all.
+	if (AnimationPoseKey::QuantizeBlend(0.0f, 0.0f) != -1 || AnimationPoseKey::QuantizeBlend(0.4f, 0.4f) != -1 || AnimationPoseKey::QuantizeBlend(0.0f, 0.4f) != 0)
+	{
+		plog::error("animation controller unit test failed: the ends of a transition got the wrong pose keys.\n");
+		success = false;
+	}
+
+	return success;
+}
\ No newline at end of file
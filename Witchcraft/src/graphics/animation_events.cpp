@@ -0,0 +1,61 @@
+#include "animation_events.h"
+
+#include "tools/fixedstring.h"
+#include "sys/printlog.h"
+
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+	struct EventNames
+	{
+		EventNames()
+			{ InternName("finished"); }
+
+		std::vector<FixedString<32>> names;
+		std::unordered_map<FixedString<32>, AnimationEventID> ids;
+
+		AnimationEventID InternName(const char* name)
+		{
+			FixedString<32> key = name;
+			auto it = ids.find(key);
+			if (it != ids.end())
+				{ return it->second; }
+
+			AnimationEventID id = (AnimationEventID)names.size();
+			names.push_back(key);
+			ids[key] = id;
+			return id;
+		}
+	};
+
+	// Built the first time it's needed, so "finished" always gets ID 0 no matter when that is.
+	EventNames& getEventNames()
+	{
+		static EventNames result;
+		return result;
+	}
+
+} // namespace <anon>
+
+AnimationEventID InternAnimationEvent(const char* name)
+{
+	EventNames& event_names = getEventNames();
+	if (event_names.names.size() >= UINT16_MAX)
+	{
+		plog::error("Too many different animation events; '%s' will be treated as 'finished'.\n", name);
+		return ANIM_EVENT_FINISHED;
+	}
+
+	return event_names.InternName(name);
+}
+
+const char* getAnimationEventName(AnimationEventID id)
+{
+	EventNames& event_names = getEventNames();
+	if (id >= event_names.names.size())
+		return "";
+
+	return event_names.names[id].c_str;
+}
\ No newline at end of file
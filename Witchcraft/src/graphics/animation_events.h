@@ -0,0 +1,50 @@
+#ifndef HVH_WC_GRAPHICS_ANIMATIONEVENTS_H
+#define HVH_WC_GRAPHICS_ANIMATIONEVENTS_H
+
+#include <cstdint>
+
+/*
+Animation events are named in the model files, but every name is interned into a small integer ID when
+the model is loaded, so raising an event while animations are updated only ever copies a number.
+*/
+
+typedef uint16_t AnimationEventID;
+
+// Raised by a layer when a non-looping animation reaches its end.  Interned before anything else.
+constexpr const AnimationEventID ANIM_EVENT_FINISHED = 0;
+
+// The most events one controller can raise in one frame; any more than this are dropped.
+constexpr const int MAX_ANIM_EVENTS_PER_FRAME = 16;
+
+struct AnimationEvent
+{
+	AnimationEventID id;
+	uint16_t layer;
+};
+
+// The events a controller raised during its last update, in a fixed array so that raising them never allocates.
+struct AnimationEventList
+{
+	AnimationEvent events[MAX_ANIM_EVENTS_PER_FRAME];
+	uint32_t count = 0;
+	uint32_t dropped = 0;
+
+	inline void clear()
+		{ count = 0; dropped = 0; }
+
+	inline void push(AnimationEventID id, int layer)
+	{
+		if (count < MAX_ANIM_EVENTS_PER_FRAME)
+			{ events[count++] = { id, (uint16_t)layer }; }
+		else
+			{ dropped++; }
+	}
+};
+
+/* Returns the ID for the given event name, creating one if it's new.  Not thread safe; call this while loading. */
+AnimationEventID InternAnimationEvent(const char* name);
+
+/* Returns the name an ID was interned from, or an empty string if there's no such ID. */
+const char* getAnimationEventName(AnimationEventID id);
+
+#endif // HVH_WC_GRAPHICS_ANIMATIONEVENTS_H
\ No newline at end of file
@@ -0,0 +1,483 @@
+#include "animation_graph.h"
+
+#include "sys/printlog.h"
+#include "filesystem/file_manager.h"
+
+#include <pugixml.hpp>
+using namespace pugi;
+
+#include <map>
+#include <string>
+#include <sstream>
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+using namespace std;
+using namespace vmath;
+
+namespace {
+
+	map<string, AnimationGraph*> loaded_graphs;
+
+	const char* TEST_NAMES[] = { "greater", "less", "greater_equal", "less_equal", "equal", "not_equal", "true", "false" };
+
+	bool RunTest(AnimationGraphTestEnum test, float param, float value)
+	{
+		switch (test)
+		{
+		case ANIMGRAPH_TEST_GREATER: return (param > value);
+		case ANIMGRAPH_TEST_LESS: return (param < value);
+		case ANIMGRAPH_TEST_GREATER_EQUAL: return (param >= value);
+		case ANIMGRAPH_TEST_LESS_EQUAL: return (param <= value);
+		case ANIMGRAPH_TEST_EQUAL: return (param == value);
+		case ANIMGRAPH_TEST_NOT_EQUAL: return (param != value);
+		case ANIMGRAPH_TEST_TRUE: return (param != 0.0f);
+		case ANIMGRAPH_TEST_FALSE: return (param == 0.0f);
+		default: return false;
+		}
+	}
+
+} // namespace <anon>
+
+AnimationGraph* AnimationGraph::Load(const char* name)
+{
+	AnimationGraph* result = nullptr;
+
+	if (loaded_graphs.count(name))
+	{
+		result = loaded_graphs[name];
+		result->refcount++;
+		return result;
+	}
+
+	char full_filename[64];
+	snprintf(full_filename, 64, "%s%s%s", ANIMGRAPH_PATH, name, ANIMGRAPH_EXTENSION);
+	InFile file = filemanager::LoadSingleFile(full_filename);
+	if (!file.is_open())
+	{
+		plog::error("Could not open '%s'.\n", full_filename);
+		return nullptr;
+	}
+
+	result = new AnimationGraph();
+	const char* err = result->LoadXML(file);
+	if (err != nullptr)
+	{
+		plog::error("Failed to load animation graph '%s':\n", full_filename);
+		plog::errmore("%s\n", err);
+		delete result;
+		return nullptr;
+	}
+
+	result->refcount = 1;
+	loaded_graphs[name] = result;
+	return result;
+}
+
+void AnimationGraph::Unload(const char* name)
+{
+	if (loaded_graphs.count(name) == 0)
+		return;
+
+	AnimationGraph* ptr = loaded_graphs[name];
+	ptr->refcount--;
+	if (ptr->refcount <= 0)
+	{
+		delete ptr;
+		loaded_graphs.erase(name);
+	}
+}
+
+const char* AnimationGraph::LoadXML(istream& file)
+{
+	parameters.clear();
+	states.clear();
+	transitions.clear();
+	default_state = 0;
+
+	stringstream ss;
+	ss << file.rdbuf();
+	string file_contents = ss.str();
+
+	xml_document doc;
+	xml_parse_result parse_result = doc.load_buffer_inplace((void*)file_contents.data(), file_contents.size());
+	if (!parse_result)
+		{ return "Error parsing file."; }
+
+	xml_node root = doc.child("animation_graph");
+	if (!root)
+		{ return "Could not find 'animation_graph' root node."; }
+
+	// Parameters come first, so that states and transitions can refer to them by index.
+	for (xml_node node = root.child("parameters").child("parameter"); node; node = node.next_sibling("parameter"))
+	{
+		Parameter param;
+		param.name = node.attribute("name").as_string();
+		if (param.name.c_str[0] == '\0')
+			{ return "Parameter does not have a name."; }
+		if (findParameter(param.name.c_str) >= 0)
+			{ return "Two parameters have the same name."; }
+		param.default_value = node.attribute("default").as_float(0.0f);
+		param.trigger = node.attribute("trigger").as_bool(false);
+		parameters.push_back(param);
+	}
+
+	// States
+	xml_node states_node = root.child("states");
+	for (xml_node node = states_node.child("state"); node; node = node.next_sibling("state"))
+	{
+		State state;
+		state.name = node.attribute("name").as_string();
+		if (state.name.c_str[0] == '\0')
+			{ return "State does not have a name."; }
+		if (findState(state.name.c_str) >= 0)
+			{ return "Two states have the same name."; }
+
+		state.speed = node.attribute("speed").as_float(1.0f);
+		state.looping = node.attribute("loop").as_bool(true);
+		state.sync = node.attribute("sync").as_bool(false);
+
+		xml_attribute attrib;
+		if ((attrib = node.attribute("x")) && (state.x_param = findParameter(attrib.as_string())) < 0)
+			{ return "State's x axis refers to a parameter which doesn't exist."; }
+		if ((attrib = node.attribute("y")) && (state.y_param = findParameter(attrib.as_string())) < 0)
+			{ return "State's y axis refers to a parameter which doesn't exist."; }
+		if ((attrib = node.attribute("speed_parameter")) && (state.speed_param = findParameter(attrib.as_string())) < 0)
+			{ return "State's speed refers to a parameter which doesn't exist."; }
+		if (state.y_param >= 0 && state.x_param < 0)
+			{ return "State has a y axis but no x axis."; }
+
+		for (xml_node motion_node = node.child("motion"); motion_node; motion_node = motion_node.next_sibling("motion"))
+		{
+			if (state.num_motions >= MAX_ANIMGRAPH_MOTIONS)
+				{ return "State has too many motions."; }
+
+			Motion& motion = state.motions[state.num_motions++];
+			motion.clip = motion_node.attribute("clip").as_string();
+			motion.position = vec2(motion_node.attribute("x").as_float(0.0f), motion_node.attribute("y").as_float(0.0f));
+			motion.speed = motion_node.attribute("speed").as_float(1.0f);
+		}
+		if (state.num_motions == 0)
+			{ return "State does not have any motions."; }
+
+		// 1D blend spaces are searched in order.
+		if (state.y_param < 0)
+			{ sort(state.motions, state.motions + state.num_motions, [](const Motion& lhs, const Motion& rhs) { return lhs.position.x < rhs.position.x; }); }
+
+		states.push_back(state);
+	}
+	if (states.empty())
+		{ return "Animation graph does not have any states."; }
+
+	xml_attribute default_attrib = states_node.attribute("default");
+	if (default_attrib && (default_state = findState(default_attrib.as_string())) < 0)
+		{ return "Default state doesn't exist."; }
+
+	// Transitions
+	for (xml_node node = root.child("transitions").child("transition"); node; node = node.next_sibling("transition"))
+	{
+		Transition transition;
+		xml_attribute attrib = node.attribute("from");
+		if (attrib && strcmp(attrib.as_string(), "any") != 0 && (transition.from = findState(attrib.as_string())) < 0)
+			{ return "Transition comes from a state which doesn't exist."; }
+		if ((transition.to = findState(node.attribute("to").as_string())) < 0)
+			{ return "Transition goes to a state which doesn't exist."; }
+		transition.duration = node.attribute("duration").as_float(0.0f);
+		transition.exit_time = node.attribute("exit_time").as_float(-1.0f);
+
+		for (xml_node condition_node = node.child("condition"); condition_node; condition_node = condition_node.next_sibling("condition"))
+		{
+			Condition condition;
+			if ((condition.param = findParameter(condition_node.attribute("parameter").as_string())) < 0)
+				{ return "Transition condition refers to a parameter which doesn't exist."; }
+
+			const char* test = condition_node.attribute("test").as_string("true");
+			int i = 0;
+			while (i <= ANIMGRAPH_TEST_FALSE && strcmp(test, TEST_NAMES[i]) != 0)
+				{ ++i; }
+			if (i > ANIMGRAPH_TEST_FALSE)
+				{ return "Transition condition has an invalid test."; }
+			condition.test = (AnimationGraphTestEnum)i;
+			condition.value = condition_node.attribute("value").as_float(0.0f);
+
+			transition.conditions.push_back(condition);
+		}
+
+		transitions.push_back(transition);
+	}
+
+	return nullptr;
+}
+
+int32_t AnimationGraph::findParameter(const char* name) const
+{
+	for (size_t i = 0; i < parameters.size(); ++i)
+	{
+		if (parameters[i].name == name)
+			{ return (int32_t)i; }
+	}
+	return -1;
+}
+
+int32_t AnimationGraph::findState(const char* name) const
+{
+	for (size_t i = 0; i < states.size(); ++i)
+	{
+		if (states[i].name == name)
+			{ return (int32_t)i; }
+	}
+	return -1;
+}
+
+void AnimationGraph::CalcMotionWeights(int32_t state_index, const float* params, float out_weights[MAX_ANIMGRAPH_MOTIONS]) const
+{
+	for (int i = 0; i < MAX_ANIMGRAPH_MOTIONS; ++i)
+		{ out_weights[i] = 0.0f; }
+
+	const State& state = states[state_index];
+	if (state.num_motions == 1 || state.x_param < 0)
+	{
+		out_weights[0] = 1.0f;
+		return;
+	}
+
+	// 1D blend spaces blend between the two motions on either side of the parameter.
+	if (state.y_param < 0)
+	{
+		float x = params[state.x_param];
+		if (x <= state.motions[0].position.x)
+			{ out_weights[0] = 1.0f; return; }
+
+		for (int32_t i = 1; i < state.num_motions; ++i)
+		{
+			float lower = state.motions[i - 1].position.x, upper = state.motions[i].position.x;
+			if (x < upper)
+			{
+				float amount = (upper > lower) ? (x - lower) / (upper - lower) : 1.0f;
+				out_weights[i - 1] = 1.0f - amount;
+				out_weights[i] = amount;
+				return;
+			}
+		}
+
+		out_weights[state.num_motions - 1] = 1.0f;
+		return;
+	}
+
+	// 2D blend spaces use gradient band interpolation (Johansen 2009), which doesn't need the motions to be arranged in a grid.
+	// Each motion's weight falls off towards every other motion, and the smallest of those falloffs is the one that counts.
+	vec2 point = vec2(params[state.x_param], params[state.y_param]);
+	float total = 0.0f;
+	for (int32_t i = 0; i < state.num_motions; ++i)
+	{
+		vec2 from_motion = point - state.motions[i].position;
+		float weight = 1.0f;
+		for (int32_t j = 0; j < state.num_motions; ++j)
+		{
+			if (i == j)
+				continue;
+
+			vec2 between = state.motions[j].position - state.motions[i].position;
+			float length_sq = vec2::dot(between, between);
+			if (length_sq <= 0.0f)
+				continue;
+
+			float falloff = 1.0f - (vec2::dot(from_motion, between) / length_sq);
+			weight = fminf(weight, fminf(fmaxf(falloff, 0.0f), 1.0f));
+		}
+		out_weights[i] = weight;
+		total += weight;
+	}
+
+	if (total > 0.0f)
+	{
+		for (int32_t i = 0; i < state.num_motions; ++i)
+			{ out_weights[i] /= total; }
+	}
+	else
+		{ out_weights[0] = 1.0f; }
+}
+
+int32_t AnimationGraph::FindTransition(int32_t state, const float* params, float normalized_time) const
+{
+	for (size_t i = 0; i < transitions.size(); ++i)
+	{
+		const Transition& transition = transitions[i];
+
+		// Transitions from any state don't restart the state they lead to.
+		if ((transition.from >= 0 && transition.from != state) || (transition.from < 0 && transition.to == state))
+			continue;
+
+		if (transition.exit_time >= 0.0f && normalized_time < transition.exit_time)
+			continue;
+
+		bool pass = true;
+		for (size_t j = 0; pass && j < transition.conditions.size(); ++j)
+		{
+			const Condition& condition = transition.conditions[j];
+			pass = RunTest(condition.test, params[condition.param], condition.value);
+		}
+
+		if (pass)
+			{ return (int32_t)i; }
+	}
+
+	return -1;
+}
+
+void AnimationGraphInstance::Start(AnimationController& controller)
+{
+	if (graph == nullptr)
+		return;
+
+	params.resize(graph->numParameters());
+	for (int32_t i = 0; i < graph->numParameters(); ++i)
+		{ params[i] = graph->getParameter(i).default_value; }
+
+	// Whether a one-shot state has finished is up to its transitions, so layers hold their last frame rather than stopping.
+	controller.setHoldFinishedLayers(true);
+
+	state = -1;
+	prev_state = -1;
+	bank = 0;
+	transition_time = 0.0f;
+	transition_duration = 0.0f;
+	EnterState(controller, graph->getDefaultState(), 0.0f);
+	UpdateLayers(controller);
+}
+
+void AnimationGraphInstance::Update(AnimationController& controller, float delta_time)
+{
+	if (graph == nullptr || state < 0)
+		return;
+
+	if (transition_duration > 0.0f)
+	{
+		transition_time += delta_time;
+		if (transition_time >= transition_duration)
+		{
+			// The old state has faded out completely, so its layers can stop.
+			ClearBank(controller, 1 - bank);
+			prev_state = -1;
+			transition_time = 0.0f;
+			transition_duration = 0.0f;
+		}
+	}
+
+	// Each transition finishes before the next one is taken, so no state is ever cut off while it's still fading in.
+	if (transition_duration <= 0.0f)
+	{
+		int32_t first_layer = bank * MAX_ANIMGRAPH_MOTIONS;
+		float duration = controller.getAnimDuration(first_layer);
+		float normalized_time = (duration > 0.0f) ? (controller.getAnimTime(first_layer) / duration) : 1.0f;
+
+		int32_t index = graph->FindTransition(state, params.data(), normalized_time);
+		if (index >= 0)
+		{
+			const AnimationGraph::Transition& transition = graph->getTransition(index);
+			for (const AnimationGraph::Condition& condition : transition.conditions)
+			{
+				if (graph->getParameter(condition.param).trigger)
+					{ params[condition.param] = 0.0f; }
+			}
+			EnterState(controller, transition.to, transition.duration);
+		}
+	}
+
+	UpdateLayers(controller);
+}
+
+bool AnimationGraphInstance::setState(AnimationController& controller, const char* name, float transition)
+{
+	if (graph == nullptr)
+		return false;
+
+	int32_t index = graph->findState(name);
+	if (index < 0)
+		return false;
+
+	EnterState(controller, index, transition);
+	UpdateLayers(controller);
+	return true;
+}
+
+void AnimationGraphInstance::EnterState(AnimationController& controller, int32_t new_state, float transition)
+{
+	// The new state starts on the other bank, so the current one can fade out underneath it.
+	// If a transition is already underway, whatever was fading out is cut off.
+	if (transition > 0.0f && state >= 0)
+	{
+		prev_state = state;
+		bank = 1 - bank;
+		transition_time = 0.0f;
+		transition_duration = transition;
+	}
+	else
+	{
+		ClearBank(controller, 1 - bank);
+		prev_state = -1;
+		transition_time = 0.0f;
+		transition_duration = 0.0f;
+	}
+
+	state = new_state;
+	const AnimationGraph::State& s = graph->getState(state);
+	for (int32_t i = 0; i < MAX_ANIMGRAPH_MOTIONS; ++i)
+	{
+		int layer = (bank * MAX_ANIMGRAPH_MOTIONS) + i;
+		if (i < s.num_motions)
+			{ controller.PlayAnimation(layer, s.motions[i].clip.c_str, s.looping); }
+		else
+			{ controller.PlayAnimation(layer, ""); }
+		controller.setAnimLayerWeight(layer, 0.0f);
+	}
+}
+
+void AnimationGraphInstance::UpdateLayers(AnimationController& controller)
+{
+	float fade = (transition_duration > 0.0f) ? fminf(transition_time / transition_duration, 1.0f) : 1.0f;
+	UpdateBank(controller, bank, state, fade);
+	if (prev_state >= 0)
+		{ UpdateBank(controller, 1 - bank, prev_state, 1.0f - fade); }
+}
+
+void AnimationGraphInstance::UpdateBank(AnimationController& controller, int32_t which_bank, int32_t which_state, float weight)
+{
+	const AnimationGraph::State& s = graph->getState(which_state);
+	int first_layer = which_bank * MAX_ANIMGRAPH_MOTIONS;
+
+	float weights[MAX_ANIMGRAPH_MOTIONS];
+	graph->CalcMotionWeights(which_state, params.data(), weights);
+
+	float speed = s.speed;
+	if (s.speed_param >= 0)
+		{ speed *= params[s.speed_param]; }
+
+	// Synced motions all play at whatever speed the blend of their durations would take to finish one cycle.
+	float blended_duration = 0.0f;
+	if (s.sync)
+	{
+		for (int32_t i = 0; i < s.num_motions; ++i)
+			{ blended_duration += weights[i] * controller.getAnimDuration(first_layer + i); }
+	}
+
+	for (int32_t i = 0; i < s.num_motions; ++i)
+	{
+		float motion_speed = speed * s.motions[i].speed;
+		if (s.sync && blended_duration > 0.0f)
+			{ motion_speed = speed * (controller.getAnimDuration(first_layer + i) / blended_duration); }
+
+		controller.setAnimLayerWeight(first_layer + i, weight * weights[i]);
+		controller.setAnimLayerSpeed(first_layer + i, motion_speed);
+	}
+}
+
+void AnimationGraphInstance::ClearBank(AnimationController& controller, int32_t which_bank)
+{
+	for (int32_t i = 0; i < MAX_ANIMGRAPH_MOTIONS; ++i)
+	{
+		int layer = (which_bank * MAX_ANIMGRAPH_MOTIONS) + i;
+		controller.PlayAnimation(layer, "");
+		controller.setAnimLayerWeight(layer, 0.0f);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,149 @@
+#ifndef HVH_WC_GRAPHICS_ANIMATIONGRAPH_H
+#define HVH_WC_GRAPHICS_ANIMATIONGRAPH_H
+
+#include "animation_controller.h"
+#include "math/vmath.h"
+#include "tools/fixedstring.h"
+
+#include <vector>
+#include <iostream>
+
+constexpr const char* ANIMGRAPH_PATH = "animations/";
+constexpr const char* ANIMGRAPH_EXTENSION = ".animgraph.xml";
+
+// A state plays its motions on one half of the controller's layers, so the state it's leaving can fade out on the other half.
+constexpr const int MAX_ANIMGRAPH_MOTIONS = NUM_ANIM_LAYERS / 2;
+
+enum AnimationGraphTestEnum
+{
+	ANIMGRAPH_TEST_GREATER = 0,
+	ANIMGRAPH_TEST_LESS,
+	ANIMGRAPH_TEST_GREATER_EQUAL,
+	ANIMGRAPH_TEST_LESS_EQUAL,
+	ANIMGRAPH_TEST_EQUAL,
+	ANIMGRAPH_TEST_NOT_EQUAL,
+	ANIMGRAPH_TEST_TRUE,
+	ANIMGRAPH_TEST_FALSE,
+};
+
+// A set of states, the transitions between them, and the parameters which drive both.
+// Graphs are loaded from xml and shared by every entity using them; each entity keeps its own AnimationGraphInstance.
+class AnimationGraph
+{
+public:
+	struct Parameter
+	{
+		FixedString<32> name;
+		float default_value = 0.0f;
+		bool trigger = false; // Triggers are reset to 0 as soon as a transition uses them.
+	};
+
+	struct Motion
+	{
+		FixedString<32> clip;
+		vmath::vec2 position = vmath::vec2(0.0f, 0.0f); // Where this motion sits in its state's blend space.
+		float speed = 1.0f;
+	};
+
+	// A state with one motion just plays it.  With an x parameter its motions make a 1D blend space, and with a y parameter as well, a 2D one.
+	struct State
+	{
+		FixedString<32> name;
+		Motion motions[MAX_ANIMGRAPH_MOTIONS];
+		int32_t num_motions = 0;
+		int32_t x_param = -1;
+		int32_t y_param = -1;
+		int32_t speed_param = -1; // If set, this parameter is multiplied into the speed of every motion.
+		float speed = 1.0f;
+		bool looping = true;
+		bool sync = false; // Keeps every motion at the same point in its cycle by matching their speeds to the blended duration.  Motion speeds are ignored.
+	};
+
+	struct Condition
+	{
+		int32_t param = -1;
+		AnimationGraphTestEnum test = ANIMGRAPH_TEST_TRUE;
+		float value = 0.0f;
+	};
+
+	struct Transition
+	{
+		int32_t from = -1; // -1 means any state.
+		int32_t to = -1;
+		float duration = 0.0f;
+		float exit_time = -1.0f; // How far through its first motion the state must be (from 0 to 1) before leaving, or less than 0 for no limit.
+		std::vector<Condition> conditions;
+	};
+
+	AnimationGraph() {}
+	~AnimationGraph() {}
+
+	static AnimationGraph* Load(const char* name);
+	static void Unload(const char* name);
+
+	const char* LoadXML(std::istream& file);
+
+	int32_t numParameters() const
+		{ return (int32_t)parameters.size(); }
+	const Parameter& getParameter(int32_t index) const
+		{ return parameters[index]; }
+	int32_t numStates() const
+		{ return (int32_t)states.size(); }
+	const State& getState(int32_t index) const
+		{ return states[index]; }
+	int32_t getDefaultState() const
+		{ return default_state; }
+	const Transition& getTransition(int32_t index) const
+		{ return transitions[index]; }
+
+	/* Returns the index of the named parameter or state, or -1 if there isn't one. */
+	int32_t findParameter(const char* name) const;
+	int32_t findState(const char* name) const;
+
+	/* Works out how much each of the state's motions contributes given the current parameters.  The weights always add up to 1. */
+	void CalcMotionWeights(int32_t state, const float* params, float out_weights[MAX_ANIMGRAPH_MOTIONS]) const;
+
+	/* Returns the first transition (in the order they were listed) which can be taken from the state right now, or -1 if none can. */
+	int32_t FindTransition(int32_t state, const float* params, float normalized_time) const;
+
+private:
+	int32_t refcount = 0;
+
+	std::vector<Parameter> parameters;
+	std::vector<State> states;
+	std::vector<Transition> transitions;
+	int32_t default_state = 0;
+};
+
+// One entity's place in an animation graph.  While an entity has a graph, the graph decides what every layer of its controller plays.
+struct AnimationGraphInstance
+{
+	AnimationGraph* graph = nullptr;
+	FixedString<32> graph_name = "";
+	std::vector<float> params;
+
+	int32_t state = -1;
+	int32_t prev_state = -1; // The state being faded out, if a transition is underway.
+	int32_t bank = 0; // Which half of the controller's layers the current state is playing on.
+	float transition_time = 0.0f;
+	float transition_duration = 0.0f;
+
+	/* Resets every parameter and starts the graph's default state. */
+	void Start(AnimationController& controller);
+
+	/* Takes any transition which is ready, and sets each layer's weight and speed according to the parameters. */
+	void Update(AnimationController& controller, float delta_time);
+
+	/* Moves straight to a state, regardless of the transitions.  Returns false if there's no such state. */
+	bool setState(AnimationController& controller, const char* name, float transition);
+
+private:
+	void EnterState(AnimationController& controller, int32_t new_state, float transition);
+	void UpdateLayers(AnimationController& controller);
+	void UpdateBank(AnimationController& controller, int32_t which_bank, int32_t which_state, float weight);
+	void ClearBank(AnimationController& controller, int32_t which_bank);
+};
+
+bool RunAnimationGraphUnitTests();
+
+#endif // HVH_WC_GRAPHICS_ANIMATIONGRAPH_H
\ No newline at end of file
@@ -0,0 +1,153 @@
+#include "animation_graph.h"
+
+#include "sys/printlog.h"
+
+#include <sstream>
+#include <cmath>
+using namespace std;
+
+namespace {
+
+	const char* TEST_GRAPH =
+		"<animation_graph>"
+		"	<parameters>"
+		"		<parameter name='speed' default='0'/>"
+		"		<parameter name='lean' default='0'/>"
+		"		<parameter name='jump' trigger='true'/>"
+		"	</parameters>"
+		"	<states default='Idle'>"
+		"		<state name='Jump' loop='false'><motion clip='Jump'/></state>"
+		"		<state name='Idle'><motion clip='Idle'/></state>"
+		"		<state name='Run' x='speed'>"
+		"			<motion clip='RunF' x='4'/>"
+		"			<motion clip='Walk' x='1'/>"
+		"		</state>"
+		"		<state name='Strafe' x='lean' y='speed'>"
+		"			<motion clip='Left' x='-1' y='1'/>"
+		"			<motion clip='Right' x='1' y='1'/>"
+		"			<motion clip='Back' x='0' y='-1'/>"
+		"		</state>"
+		"	</states>"
+		"	<transitions>"
+		"		<transition from='any' to='Jump' duration='0.1'><condition parameter='jump'/></transition>"
+		"		<transition from='Jump' to='Idle' exit_time='0.9'/>"
+		"		<transition from='Idle' to='Run' duration='0.2'><condition parameter='speed' test='greater' value='0'/></transition>"
+		"		<transition from='Run' to='Idle' duration='0.2'><condition parameter='speed' test='less_equal' value='0'/></transition>"
+		"	</transitions>"
+		"</animation_graph>";
+
+	bool Close(float a, float b)
+		{ return fabsf(a - b) < 0.0001f; }
+
+} // namespace <anon>
+
+bool RunAnimationGraphUnitTests()
+{
+	bool success = true;
+
+	AnimationGraph graph;
+	istringstream file(TEST_GRAPH);
+	const char* err = graph.LoadXML(file);
+	if (err != nullptr)
+	{
+		plog::error("animation graph unit test failed: could not load the test graph: %s\n", err);
+		return false;
+	}
+
+	int32_t speed = graph.findParameter("speed"), lean = graph.findParameter("lean"), jump = graph.findParameter("jump");
+	int32_t jump_state = graph.findState("Jump"), idle = graph.findState("Idle"), run = graph.findState("Run"), strafe = graph.findState("Strafe");
+	if (graph.numParameters() != 3 || graph.numStates() != 4 || graph.getDefaultState() != idle || !graph.getParameter(jump).trigger)
+	{
+		plog::error("animation graph unit test failed: the test graph was not loaded correctly.\n");
+		success = false;
+	}
+
+	float params[3] = { 0.0f, 0.0f, 0.0f };
+	float weights[MAX_ANIMGRAPH_MOTIONS];
+
+	// 1D blend spaces are sorted by position, and clamp at either end.
+	const AnimationGraph::State& run_state = graph.getState(run);
+	if (!(run_state.motions[0].clip == FixedString<32>("Walk")))
+	{
+		plog::error("animation graph unit test failed: 1D blend space motions were not sorted.\n");
+		success = false;
+	}
+	const float speeds[] = { 0.0f, 1.0f, 2.5f, 4.0f, 10.0f };
+	const float walk_weights[] = { 1.0f, 1.0f, 0.5f, 0.0f, 0.0f };
+	for (int i = 0; i < 5; ++i)
+	{
+		params[speed] = speeds[i];
+		graph.CalcMotionWeights(run, params, weights);
+		if (!Close(weights[0], walk_weights[i]) || !Close(weights[0] + weights[1], 1.0f))
+		{
+			plog::error("animation graph unit test failed: at speed %f, walk and run weighed %f and %f.\n", speeds[i], weights[0], weights[1]);
+			success = false;
+		}
+	}
+
+	// 2D blend spaces should give all of the weight to a motion when we're right on top of it, and always add up to 1.
+	params[lean] = 1.0f; params[speed] = 1.0f;
+	graph.CalcMotionWeights(strafe, params, weights);
+	if (!Close(weights[1], 1.0f))
+	{
+		plog::error("animation graph unit test failed: 2D blend space did not pick the motion under the parameters (got %f).\n", weights[1]);
+		success = false;
+	}
+	for (int i = 0; i < 100; ++i)
+	{
+		params[lean] = -2.0f + (float)(i % 10) * 0.4f;
+		params[speed] = -2.0f + (float)(i / 10) * 0.4f;
+		graph.CalcMotionWeights(strafe, params, weights);
+		float total = weights[0] + weights[1] + weights[2];
+		if (!Close(total, 1.0f) || weights[0] < 0.0f || weights[1] < 0.0f || weights[2] < 0.0f)
+		{
+			plog::error("animation graph unit test failed: 2D blend space weights at (%f, %f) added up to %f.\n", params[lean], params[speed], total);
+			success = false;
+			break;
+		}
+	}
+
+	// Transitions are taken in the order they're listed, and only from the state they come from.
+	params[lean] = 0.0f; params[speed] = 0.0f;
+	int32_t transition;
+	if ((transition = graph.FindTransition(idle, params, 0.0f)) >= 0)
+	{
+		plog::error("animation graph unit test failed: left idle without any reason to (took transition %i).\n", transition);
+		success = false;
+	}
+	params[speed] = 1.0f;
+	if ((transition = graph.FindTransition(idle, params, 0.0f)) < 0 || graph.getTransition(transition).to != run)
+	{
+		plog::error("animation graph unit test failed: did not start running.\n");
+		success = false;
+	}
+	params[jump] = 1.0f;
+	if ((transition = graph.FindTransition(run, params, 0.0f)) < 0 || graph.getTransition(transition).to != jump_state)
+	{
+		plog::error("animation graph unit test failed: a transition from any state was not taken.\n");
+		success = false;
+	}
+
+	// A transition from any state shouldn't restart the state it leads to, and exit times should hold a state until it's done.
+	if ((transition = graph.FindTransition(jump_state, params, 0.5f)) >= 0)
+	{
+		plog::error("animation graph unit test failed: left a state before its exit time (took transition %i).\n", transition);
+		success = false;
+	}
+	if ((transition = graph.FindTransition(jump_state, params, 0.95f)) < 0 || graph.getTransition(transition).to != idle)
+	{
+		plog::error("animation graph unit test failed: did not leave a state after its exit time.\n");
+		success = false;
+	}
+
+	// Graphs which refer to things that don't exist shouldn't load.
+	AnimationGraph bad_graph;
+	istringstream bad_file("<animation_graph><states><state name='A' x='missing'><motion clip='A'/></state></states></animation_graph>");
+	if (bad_graph.LoadXML(bad_file) == nullptr)
+	{
+		plog::error("animation graph unit test failed: loaded a graph which refers to a missing parameter.\n");
+		success = false;
+	}
+
+	return success;
+}
\ No newline at end of file
@@ -0,0 +1,107 @@
+#include "animation_ik.h"
+
+#include <cmath>
+using namespace vmath;
+
+namespace {
+
+	// Keeps targets from sitting exactly at full reach, where the bend direction becomes unstable.
+	constexpr const float IK_REACH_EPSILON = 0.0001f;
+
+	// Returns a unit vector perpendicular to 'dir' which leans as far towards 'hint' as possible.
+	vec3 PerpendicularTowards(vec3 dir, vec3 hint)
+	{
+		vec3 result = hint - (dir * vec3::dot(hint, dir));
+		if (result.magnitude_squared() > 0.000001f)
+			{ return result.normalized(); }
+
+		// The hint lines up with the direction, so any perpendicular will have to do.
+		result = vec3::cross(dir, (fabsf(dir.z) < 0.9f) ? VEC3_UP : VEC3_FORWARD);
+		return result.normalized();
+	}
+
+} // namespace <anon>
+
+void SolveTwoBoneIK(const vec3 joints[3], vec3 target, vec3 bend_hint, vec3 out_joints[3])
+{
+	float upper_length = vec3::distance(joints[0], joints[1]);
+	float lower_length = vec3::distance(joints[1], joints[2]);
+	out_joints[0] = joints[0];
+
+	vec3 to_target = target - joints[0];
+	float distance = to_target.magnitude();
+	if (distance <= 0.0f || upper_length <= 0.0f || lower_length <= 0.0f)
+	{
+		out_joints[1] = joints[1];
+		out_joints[2] = joints[2];
+		return;
+	}
+	vec3 dir = to_target / distance;
+
+	// The chain can't reach any closer than the difference between its bones, or any further than their sum.
+	float min_reach = fabsf(upper_length - lower_length) + IK_REACH_EPSILON;
+	float max_reach = upper_length + lower_length - IK_REACH_EPSILON;
+	distance = clampf(distance, min_reach, max_reach);
+
+	// Law of cosines gives the angle between the upper bone and the line to the target.
+	float cos_angle = ((upper_length * upper_length) + (distance * distance) - (lower_length * lower_length)) / (2.0f * upper_length * distance);
+	cos_angle = clampf(cos_angle, -1.0f, 1.0f);
+	float sin_angle = sqrtf(1.0f - (cos_angle * cos_angle));
+
+	vec3 bend = PerpendicularTowards(dir, bend_hint);
+	out_joints[1] = joints[0] + (((dir * cos_angle) + (bend * sin_angle)) * upper_length);
+	out_joints[2] = joints[0] + (dir * distance);
+}
+
+int32_t SolveFABRIK(vec3* joints, int32_t num_joints, vec3 target, int32_t max_iterations, float tolerance)
+{
+	if (num_joints < 2)
+		return 0;
+
+	float lengths[MAX_IK_CHAIN_BONES];
+	float total_length = 0.0f;
+	for (int32_t i = 0; i < num_joints - 1; ++i)
+	{
+		lengths[i] = vec3::distance(joints[i], joints[i + 1]);
+		total_length += lengths[i];
+	}
+
+	// Out of reach targets just straighten the chain out towards them.
+	vec3 root = joints[0];
+	if (vec3::distance(root, target) >= total_length)
+	{
+		vec3 dir = (target - root).normalized();
+		for (int32_t i = 1; i < num_joints; ++i)
+			{ joints[i] = joints[i - 1] + (dir * lengths[i - 1]); }
+		return 0;
+	}
+
+	int32_t iteration = 0;
+	float tolerance_sq = tolerance * tolerance;
+	while (iteration < max_iterations && vec3::distance_squared(joints[num_joints - 1], target) > tolerance_sq)
+	{
+		// Backward: put the tip on the target, and pull each joint along behind it.
+		joints[num_joints - 1] = target;
+		for (int32_t i = num_joints - 2; i >= 0; --i)
+		{
+			vec3 dir = joints[i] - joints[i + 1];
+			float length = dir.magnitude();
+			if (length > 0.0f)
+				{ joints[i] = joints[i + 1] + (dir * (lengths[i] / length)); }
+		}
+
+		// Forward: put the root back where it belongs, and push each joint along in front of it.
+		joints[0] = root;
+		for (int32_t i = 1; i < num_joints; ++i)
+		{
+			vec3 dir = joints[i] - joints[i - 1];
+			float length = dir.magnitude();
+			if (length > 0.0f)
+				{ joints[i] = joints[i - 1] + (dir * (lengths[i - 1] / length)); }
+		}
+
+		iteration++;
+	}
+
+	return iteration;
+}
\ No newline at end of file
@@ -0,0 +1,52 @@
+#ifndef HVH_WC_GRAPHICS_ANIMATIONIK_H
+#define HVH_WC_GRAPHICS_ANIMATIONIK_H
+
+#include "math/vmath.h"
+
+#include <cstdint>
+
+constexpr const int MAX_IK_CHAIN_BONES = 16;
+
+enum IKSolverEnum
+{
+	IK_SOLVER_TWO_BONE = 0, // Upper, lower, and end bones; for arms and legs.
+	IK_SOLVER_LOOK_AT,      // A single bone, turned so one of its axes points at the target; for heads and eyes.
+	IK_SOLVER_FABRIK,       // Any number of bones, solved iteratively; for tails, tentacles, and spines.
+};
+
+// A run of bones which is bent towards a target after the animation has been sampled.
+// Bones are listed from the root of the chain to its tip, and each must be a descendant of the one before it.
+struct IKChain
+{
+	IKSolverEnum solver = IK_SOLVER_TWO_BONE;
+	int32_t bones[MAX_IK_CHAIN_BONES];
+	int32_t num_bones = 0;
+
+	// Targets and poles are in world space.  A weight of 0 leaves the animation alone, and 1 reaches the target entirely.
+	vmath::vec3 target = vmath::VEC3_ZERO;
+	float weight = 0.0f;
+
+	// Two-bone chains bend towards their pole (a knee or elbow target).  Without one, they keep bending the way the animation bends them.
+	vmath::vec3 pole = vmath::VEC3_ZERO;
+	bool has_pole = false;
+
+	// Look-at chains point this axis of the bone (in the bone's own space) at the target, turning no further than 'max_angle' radians.
+	vmath::vec3 aim_axis = vmath::VEC3_FORWARD;
+	float max_angle = PI;
+
+	// FABRIK chains stop iterating once the tip is this close to the target.
+	int32_t max_iterations = 10;
+	float tolerance = 0.001f;
+};
+
+/* Finds where the middle and end joints of a two-bone chain should go to reach the target, keeping both bones the same length. */
+/* The chain bends in the plane containing the target and 'bend_hint', on the side of 'bend_hint'.  Out of reach targets straighten it out. */
+void SolveTwoBoneIK(const vmath::vec3 joints[3], vmath::vec3 target, vmath::vec3 bend_hint, vmath::vec3 out_joints[3]);
+
+/* Moves the joints towards the target with Forward And Backward Reaching IK (Aristidou & Lasenby 2011), keeping the first joint in place. */
+/* Returns the number of iterations it took. */
+int32_t SolveFABRIK(vmath::vec3* joints, int32_t num_joints, vmath::vec3 target, int32_t max_iterations, float tolerance);
+
+bool RunIKUnitTests();
+
+#endif // HVH_WC_GRAPHICS_ANIMATIONIK_H
\ No newline at end of file
@@ -0,0 +1,79 @@
+#include "animation_ik.h"
+
+#include "sys/printlog.h"
+
+#include <cmath>
+using namespace vmath;
+
+namespace {
+
+	bool Close(float a, float b, float tolerance = 0.001f)
+		{ return fabsf(a - b) < tolerance; }
+
+} // namespace <anon>
+
+bool RunIKUnitTests()
+{
+	bool success = true;
+
+	// A straight arm along x, bending towards +y.
+	const vec3 arm[3] = { vec3(0.0f, 0.0f, 0.0f), vec3(1.0f, 0.0f, 0.0f), vec3(2.0f, 0.0f, 0.0f) };
+	vec3 solved[3];
+
+	// Reachable targets should be reached exactly, without stretching either bone.
+	const vec3 targets[] = { vec3(1.0f, 1.0f, 0.0f), vec3(0.5f, 0.0f, 1.2f), vec3(-1.0f, 0.3f, 0.2f), vec3(0.0f, 0.0f, 1.9f) };
+	for (const vec3& target : targets)
+	{
+		SolveTwoBoneIK(arm, target, VEC3_UP, solved);
+		if (vec3::distance(solved[2], target) > 0.001f || !Close(vec3::distance(solved[0], solved[1]), 1.0f) || !Close(vec3::distance(solved[1], solved[2]), 1.0f))
+		{
+			plog::error("IK unit test failed: two-bone chain missed (%f, %f, %f) by %f.\n", target.x, target.y, target.z, vec3::distance(solved[2], target));
+			success = false;
+		}
+	}
+
+	// The elbow should bend towards the hint.
+	SolveTwoBoneIK(arm, vec3(1.0f, 0.0f, 0.0f), vec3(0.0f, 0.0f, -1.0f), solved);
+	if (solved[1].z >= 0.0f || fabsf(solved[1].y) > 0.001f)
+	{
+		plog::error("IK unit test failed: two-bone chain bent towards (%f, %f, %f) instead of the hint.\n", solved[1].x, solved[1].y, solved[1].z);
+		success = false;
+	}
+
+	// Targets out of reach should straighten the chain out towards them.
+	SolveTwoBoneIK(arm, vec3(0.0f, 5.0f, 0.0f), VEC3_UP, solved);
+	if (!Close(solved[1].y, 1.0f) || !Close(solved[2].y, 2.0f))
+	{
+		plog::error("IK unit test failed: two-bone chain did not straighten out towards an unreachable target.\n");
+		success = false;
+	}
+
+	// FABRIK should get there within its iterations, and leave the root and bone lengths alone.
+	vec3 tail[5];
+	for (int i = 0; i < 5; ++i)
+		{ tail[i] = vec3(0.0f, 0.0f, (float)i); }
+	const vec3 tail_target(1.5f, 1.0f, 2.0f);
+	SolveFABRIK(tail, 5, tail_target, 20, 0.001f);
+	if (vec3::distance(tail[4], tail_target) > 0.001f || vec3::distance(tail[0], VEC3_ZERO) > 0.0001f)
+	{
+		plog::error("IK unit test failed: FABRIK chain missed its target by %f.\n", vec3::distance(tail[4], tail_target));
+		success = false;
+	}
+	for (int i = 0; i < 4; ++i)
+	{
+		if (!Close(vec3::distance(tail[i], tail[i + 1]), 1.0f))
+		{
+			plog::error("IK unit test failed: FABRIK stretched bone %i to %f.\n", i, vec3::distance(tail[i], tail[i + 1]));
+			success = false;
+		}
+	}
+
+	SolveFABRIK(tail, 5, vec3(10.0f, 0.0f, 0.0f), 20, 0.001f);
+	if (!Close(tail[4].x, 4.0f) || !Close(tail[4].z, 0.0f))
+	{
+		plog::error("IK unit test failed: FABRIK chain did not straighten out towards an unreachable target.\n");
+		success = false;
+	}
+
+	return success;
+}
\ No newline at end of file
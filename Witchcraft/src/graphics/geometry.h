@@ -57,12 +57,29 @@ public:
 		return ready_;
 	}
 
+	uint32_t getVertexFormat() const;
+
+	/* Quantized positions are stored within [0, 1], and are scaled up by 'scale' and moved by 'offset' when drawn. */
+	void setDequantization(vmath::vec3 offset, float scale)
+		{ dequant_offset_ = offset; dequant_scale_ = scale; }
+
+	/* Returns the given transform with this geometry's position dequantization folded in. */
+	vmath::mat4 applyDequantization(const vmath::mat4& transform) const
+	{
+		if (!(getVertexFormat() & VF_POSITION_QUANTIZED))
+			{ return transform; }
+		return transform * vmath::mat4::translation(dequant_offset_) * vmath::mat4::scale(dequant_scale_, dequant_scale_, dequant_scale_);
+	}
+
 	void static DrawWireCube();
 	void static DrawFullscreenQuad();
 
 private:
 	bool ready_;
 
+	vmath::vec3 dequant_offset_;
+	float dequant_scale_;
+
 #ifdef RENDERER_OPENGL
 	uint32_t vbo_, ibo_, vao_;
 	uint32_t vcount_, icount_;
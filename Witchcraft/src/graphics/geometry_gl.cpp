@@ -141,6 +141,11 @@ void Geometry::Load(GeomEnum primitive, void* vertices, VertexFormatFlags vert_f
 	ready_ = true;
 }
 
+uint32_t Geometry::getVertexFormat() const
+{
+	return vformat_;
+}
+
 void Geometry::Draw(uint32_t start, int32_t count)
 {
 	if (ready_ == false)
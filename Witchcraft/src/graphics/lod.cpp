@@ -0,0 +1,42 @@
+#include "lod.h"
+
+#include <cmath>
+
+namespace lod {
+
+float ProjectedSize(float radius, float distance, float projection_scale)
+{
+	// If we're inside the sphere, it covers the whole screen.
+	if (distance <= radius)
+		{ return 1.0f; }
+
+	return (radius * projection_scale) / distance;
+}
+
+int Select(float screen_size, const float* thresholds, int num_levels, int current_level, float hysteresis)
+{
+	if (num_levels <= 1)
+		{ return 0; }
+	if (current_level < 0 || current_level >= num_levels)
+		{ current_level = 0; }
+
+	// Find the simplest level whose threshold we're under.
+	int target = 0;
+	for (int i = 1; i < num_levels; ++i)
+	{
+		if (screen_size < thresholds[i])
+			{ target = i; }
+	}
+
+	// Moving to a simpler level requires shrinking a little past its threshold...
+	while (target > current_level && screen_size >= thresholds[target] * (1.0f - hysteresis))
+		{ target--; }
+
+	// ...and moving back to a more detailed level requires growing a little past the threshold of the level we're leaving.
+	while (target < current_level && screen_size <= thresholds[target + 1] * (1.0f + hysteresis))
+		{ target++; }
+
+	return target;
+}
+
+} // namespace lod
\ No newline at end of file
@@ -0,0 +1,36 @@
+#ifndef HVH_WC_GRAPHICS_LOD_H
+#define HVH_WC_GRAPHICS_LOD_H
+
+/*
+Level of detail selection.
+Every level past the first has a screen size threshold; once a model covers less than that fraction
+of the screen's height, the simpler level is used instead.  To keep models from flickering between
+two levels when they sit right on a threshold, changing levels requires overshooting it by a margin.
+*/
+
+namespace lod {
+
+	// The maximum number of detail levels a model can have, including the full-detail level.
+	constexpr const int MAX_LEVELS = 4;
+
+	// How far past a threshold (as a fraction of that threshold) a model has to go before it changes levels.
+	constexpr const float DEFAULT_HYSTERESIS = 0.15f;
+
+	// The default screen size thresholds used by the model converter, indexed by level.
+	// The first entry is unused, since level 0 is always used when nothing else applies.
+	constexpr const float DEFAULT_SCREEN_SIZE[MAX_LEVELS] = { 1.0f, 0.3f, 0.12f, 0.05f };
+
+	/* Returns the fraction of the screen's height covered by a sphere of the given radius at the given distance. */
+	/* 'projection_scale' is the vertical scale of the projection matrix (cot(fovy / 2), or proj.at(1,1)). */
+	float ProjectedSize(float radius, float distance, float projection_scale);
+
+	/* Chooses a level of detail for something of the given projected size, given the level it used last frame. */
+	/* 'thresholds' must hold 'num_levels' entries, and decrease with each level. */
+	int Select(float screen_size, const float* thresholds, int num_levels, int current_level, float hysteresis = DEFAULT_HYSTERESIS);
+
+} // namespace lod
+
+/* Checks that level selection behaves as expected.  Returns false if any test fails. */
+bool RunLodUnitTests();
+
+#endif // HVH_WC_GRAPHICS_LOD_H
\ No newline at end of file
@@ -0,0 +1,74 @@
+#include "lod.h"
+
+#include "sys/printlog.h"
+
+#include <cmath>
+
+using namespace lod;
+
+bool RunLodUnitTests()
+{
+	bool success = true;
+	const float thresholds[MAX_LEVELS] = { 1.0f, 0.5f, 0.25f, 0.1f };
+
+	// Starting from full detail, each threshold should only be crossed once we're well past it.
+	int level = 0;
+	if ((level = Select(0.45f, thresholds, MAX_LEVELS, level, 0.15f)) != 0)
+	{
+		plog::error("lod unit test failed: changed levels inside the hysteresis band (got %i, expected 0).\n", level);
+		success = false;
+	}
+	if ((level = Select(0.40f, thresholds, MAX_LEVELS, level, 0.15f)) != 1)
+	{
+		plog::error("lod unit test failed: did not drop to level 1 (got %i).\n", level);
+		success = false;
+	}
+
+	// Hovering around the threshold we just crossed shouldn't bring us back.
+	if ((level = Select(0.52f, thresholds, MAX_LEVELS, level, 0.15f)) != 1)
+	{
+		plog::error("lod unit test failed: returned to level 0 inside the hysteresis band (got %i).\n", level);
+		success = false;
+	}
+	if ((level = Select(0.60f, thresholds, MAX_LEVELS, level, 0.15f)) != 0)
+	{
+		plog::error("lod unit test failed: did not return to level 0 (got %i).\n", level);
+		success = false;
+	}
+
+	// Jumping straight from full detail to a tiny size should skip the levels in between.
+	if ((level = Select(0.01f, thresholds, MAX_LEVELS, 0, 0.15f)) != 3)
+	{
+		plog::error("lod unit test failed: did not skip to the last level (got %i).\n", level);
+		success = false;
+	}
+
+	// ...and vice versa.
+	if ((level = Select(0.9f, thresholds, MAX_LEVELS, 3, 0.15f)) != 0)
+	{
+		plog::error("lod unit test failed: did not skip back to level 0 (got %i).\n", level);
+		success = false;
+	}
+
+	// Models with only one level, or with an invalid current level, should always come out valid.
+	if (Select(0.01f, thresholds, 1, 0) != 0 || Select(0.9f, thresholds, MAX_LEVELS, 17) != 0)
+	{
+		plog::error("lod unit test failed: selected a level which does not exist.\n");
+		success = false;
+	}
+
+	// A unit sphere ten units away with a 90 degree field of view covers a tenth of the screen.
+	float size = ProjectedSize(1.0f, 10.0f, 1.0f / tanf(0.5f * 1.5707963f));
+	if (fabsf(size - 0.1f) > 0.0001f)
+	{
+		plog::error("lod unit test failed: ProjectedSize() returned %f, expected 0.1.\n", size);
+		success = false;
+	}
+	if (ProjectedSize(2.0f, 1.0f, 1.0f) != 1.0f)
+	{
+		plog::error("lod unit test failed: ProjectedSize() inside the sphere should cover the whole screen.\n");
+		success = false;
+	}
+
+	return success;
+}
\ No newline at end of file
@@ -46,6 +46,7 @@ enum MaterialShaderUniforms
 	UNIFORM_LIGHT_LOCAL_INDEX_13,
 	UNIFORM_LIGHT_LOCAL_INDEX_14,
 	UNIFORM_LIGHT_LOCAL_INDEX_15,
+	UNIFORM_OCTAHEDRAL_SURFACE,
 };
 
 const std::vector<const char*> MATERIAL_SHADER_UNIFORM_NAMES =
@@ -79,6 +80,7 @@ const std::vector<const char*> MATERIAL_SHADER_UNIFORM_NAMES =
 	"local_lighting.index[13]",
 	"local_lighting.index[14]",
 	"local_lighting.index[15]",
+	"octahedral_surface",
 };
 
 class Material
@@ -0,0 +1,790 @@
+#include "mesh_optimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+#include <unordered_set>
+using namespace std;
+
+#include "math/vmath.h"
+using namespace vmath;
+
+namespace meshopt {
+
+namespace {
+
+// Tuning values from Tom Forsyth's "Linear-Speed Vertex Cache Optimisation".
+constexpr const float CACHE_DECAY_POWER = 1.5f;
+constexpr const float LAST_TRI_SCORE = 0.75f;
+constexpr const float VALENCE_BOOST_SCALE = 2.0f;
+constexpr const float VALENCE_BOOST_POWER = 0.5f;
+constexpr const uint32_t MAX_VALENCE_SCORED = 32;
+
+// A FIFO cache which tracks when each vertex was last transformed, rather than the cache contents themselves.
+// A vertex is still in the cache if fewer than 'cache_size' vertices have been transformed since it was.
+class FifoCache
+{
+public:
+	FifoCache(size_t num_vertices, size_t cache_size)
+	: timestamps(num_vertices, 0), cache_size((uint32_t)cache_size), now((uint32_t)cache_size + 1) {}
+
+	// Returns true if the vertex had to be transformed.
+	inline bool touch(int vertex)
+	{
+		if (now - timestamps[vertex] > cache_size)
+		{
+			timestamps[vertex] = now++;
+			return true;
+		}
+		return false;
+	}
+
+	// Pretend the cache has been completely emptied.
+	inline void flush()
+		{ now += cache_size + 1; }
+
+private:
+	vector<uint32_t> timestamps;
+	uint32_t cache_size;
+	uint32_t now;
+};
+
+struct ForsythScoreTables
+{
+	float cache[FORSYTH_CACHE_SIZE + 3];
+	float valence[MAX_VALENCE_SCORED + 1];
+
+	ForsythScoreTables()
+	{
+		for (size_t i = 0; i < FORSYTH_CACHE_SIZE + 3; ++i)
+		{
+			if (i < 3)
+				{ cache[i] = LAST_TRI_SCORE; }
+			else if (i < FORSYTH_CACHE_SIZE)
+				{ cache[i] = powf(1.0f - (float)(i - 3) / (float)(FORSYTH_CACHE_SIZE - 3), CACHE_DECAY_POWER); }
+			else
+				{ cache[i] = 0.0f; }
+		}
+
+		valence[0] = 0.0f;
+		for (uint32_t i = 1; i <= MAX_VALENCE_SCORED; ++i)
+			{ valence[i] = VALENCE_BOOST_SCALE * powf((float)i, -VALENCE_BOOST_POWER); }
+	}
+
+	inline float score(int cache_position, uint32_t remaining_triangles) const
+	{
+		// Vertices with no remaining triangles should never attract new ones.
+		if (remaining_triangles == 0)
+			{ return -1.0f; }
+
+		float result = valence[min(remaining_triangles, MAX_VALENCE_SCORED)];
+		if (cache_position >= 0)
+			{ result += cache[cache_position]; }
+		return result;
+	}
+};
+
+const ForsythScoreTables& getScoreTables()
+{
+	static const ForsythScoreTables tables;
+	return tables;
+}
+
+inline vec3 getPosition(const float* positions, size_t stride, int vertex)
+{
+	const float* ptr = (const float*)((const char*)positions + (stride * vertex));
+	return vec3(ptr[0], ptr[1], ptr[2]);
+}
+
+struct TriangleCluster
+{
+	size_t start;
+	size_t count;
+	float sort_key;
+};
+
+// Border edges are given extra weight so that open edges (and therefore the silhouette) are preserved.
+constexpr const float BORDER_EDGE_WEIGHT = 10.0f;
+
+// A symmetric 4x4 matrix which measures the sum of squared distances from a point to a set of planes.
+struct Quadric
+{
+	float a2, b2, c2, d2, ab, ac, ad, bc, bd, cd;
+
+	static Quadric fromPlane(vec3 n, float d, float weight)
+	{
+		return { n.x*n.x*weight, n.y*n.y*weight, n.z*n.z*weight, d*d*weight,
+				 n.x*n.y*weight, n.x*n.z*weight, n.x*d*weight,
+				 n.y*n.z*weight, n.y*d*weight, n.z*d*weight };
+	}
+
+	inline Quadric& operator += (const Quadric& rhs)
+	{
+		a2 += rhs.a2; b2 += rhs.b2; c2 += rhs.c2; d2 += rhs.d2;
+		ab += rhs.ab; ac += rhs.ac; ad += rhs.ad;
+		bc += rhs.bc; bd += rhs.bd; cd += rhs.cd;
+		return *this;
+	}
+
+	inline float error(vec3 p) const
+	{
+		float result = (a2*p.x*p.x) + (b2*p.y*p.y) + (c2*p.z*p.z) + d2 +
+			2.0f * ((ab*p.x*p.y) + (ac*p.x*p.z) + (ad*p.x) + (bc*p.y*p.z) + (bd*p.y) + (cd*p.z));
+		return fabsf(result);
+	}
+};
+
+enum SimplifyVertexKind
+{
+	SVK_MANIFOLD = 0, // Can collapse onto any neighbour.
+	SVK_BORDER,       // Lies on an open edge; can only collapse along that edge.
+	SVK_LOCKED        // Lies on an attribute seam or a non-manifold edge; never collapses.
+};
+
+struct EdgeCollapse
+{
+	int from, to;
+	float cost;
+};
+
+// Calculates a meshlet's bounding sphere and normal cone from its triangles.
+void CalcMeshletBounds(Meshlet& meshlet, const int* indices, const float* positions, size_t stride)
+{
+	const int* first = indices + meshlet.start;
+	size_t num_indices = (size_t)meshlet.count;
+
+	vec3 lower = getPosition(positions, stride, first[0]), upper = lower;
+	for (size_t i = 1; i < num_indices; ++i)
+	{
+		vec3 p = getPosition(positions, stride, first[i]);
+		lower = vec3::minimum(lower, p);
+		upper = vec3::maximum(upper, p);
+	}
+	meshlet.center = (lower + upper) * 0.5f;
+
+	float radius_sq = 0.0f;
+	for (size_t i = 0; i < num_indices; ++i)
+		{ radius_sq = fmaxf(radius_sq, vec3::distance_squared(meshlet.center, getPosition(positions, stride, first[i]))); }
+	meshlet.radius = sqrtf(radius_sq);
+
+	// The cone's axis is the average of the triangles' normals, and it's wide enough to contain all of them.
+	vector<vec3> normals;
+	normals.reserve(num_indices / 3);
+	vec3 axis = VEC3_ZERO;
+	for (size_t i = 0; i + 2 < num_indices; i += 3)
+	{
+		vec3 p0 = getPosition(positions, stride, first[i]);
+		vec3 p1 = getPosition(positions, stride, first[i+1]);
+		vec3 p2 = getPosition(positions, stride, first[i+2]);
+		vec3 n = vec3::cross(p1 - p0, p2 - p0);
+		float length = n.magnitude();
+		if (length <= 0.0f)
+			continue;
+
+		normals.push_back(n / length);
+		axis += normals.back();
+	}
+
+	meshlet.cone_axis = VEC3_UP;
+	meshlet.cone_cutoff = 1.0f;
+	if (normals.size() == 0 || axis.magnitude() <= 0.0f)
+		{ return; }
+	axis.normalize();
+
+	float min_dot = 1.0f;
+	for (const vec3& n : normals)
+		{ min_dot = fminf(min_dot, vec3::dot(n, axis)); }
+
+	meshlet.cone_axis = axis;
+
+	// If the normals span more than a hemisphere (or close to it), the meshlet can never be entirely back-facing.
+	if (min_dot > 0.1f)
+		{ meshlet.cone_cutoff = sqrtf(1.0f - (min_dot * min_dot)); }
+}
+
+inline uint64_t EdgeKey(int a, int b)
+{
+	if (a > b) std::swap(a, b);
+	return ((uint64_t)a << 32) | (uint64_t)(uint32_t)b;
+}
+
+} // namespace <anon>
+
+CacheStatistics SimulateVertexCache(const int* indices, size_t num_indices, size_t num_vertices, size_t cache_size)
+{
+	CacheStatistics result = {};
+	result.triangles = (uint32_t)(num_indices / 3);
+
+	FifoCache cache(num_vertices, cache_size);
+	vector<bool> referenced(num_vertices, false);
+
+	for (size_t i = 0; i < num_indices; ++i)
+	{
+		if (cache.touch(indices[i]))
+			{ result.vertices_transformed++; }
+
+		if (!referenced[indices[i]])
+		{
+			referenced[indices[i]] = true;
+			result.vertices_referenced++;
+		}
+	}
+
+	if (result.triangles > 0)
+		{ result.acmr = (float)result.vertices_transformed / (float)result.triangles; }
+	if (result.vertices_referenced > 0)
+		{ result.atvr = (float)result.vertices_transformed / (float)result.vertices_referenced; }
+
+	return result;
+}
+
+void OptimizeVertexCache(int* indices, size_t num_indices, size_t num_vertices)
+{
+	const ForsythScoreTables& tables = getScoreTables();
+	size_t num_triangles = num_indices / 3;
+	if (num_triangles == 0)
+		{ return; }
+
+	// Build a list of which triangles use each vertex.
+	vector<uint32_t> remaining(num_vertices, 0);
+	for (size_t i = 0; i < num_triangles * 3; ++i)
+		{ remaining[indices[i]]++; }
+
+	vector<uint32_t> adjacency_offset(num_vertices + 1, 0);
+	for (size_t i = 0; i < num_vertices; ++i)
+		{ adjacency_offset[i + 1] = adjacency_offset[i] + remaining[i]; }
+
+	vector<uint32_t> adjacency(num_triangles * 3);
+	{
+		vector<uint32_t> fill(adjacency_offset.begin(), adjacency_offset.end() - 1);
+		for (size_t i = 0; i < num_triangles * 3; ++i)
+			{ adjacency[fill[indices[i]]++] = (uint32_t)(i / 3); }
+	}
+
+	// Calculate the initial scores for every vertex and triangle.
+	vector<int> cache_position(num_vertices, -1);
+	vector<float> vertex_score(num_vertices);
+	for (size_t i = 0; i < num_vertices; ++i)
+		{ vertex_score[i] = tables.score(-1, remaining[i]); }
+
+	vector<float> triangle_score(num_triangles);
+	vector<bool> emitted(num_triangles, false);
+	for (size_t i = 0; i < num_triangles; ++i)
+		{ triangle_score[i] = vertex_score[indices[i*3+0]] + vertex_score[indices[i*3+1]] + vertex_score[indices[i*3+2]]; }
+
+	vector<int> output;
+	output.reserve(num_triangles * 3);
+
+	int cache[FORSYTH_CACHE_SIZE + 3];
+	int new_cache[FORSYTH_CACHE_SIZE + 3];
+	size_t cache_count = 0;
+
+	size_t scan_cursor = 0;
+	int best_triangle = -1;
+
+	while (output.size() < num_triangles * 3)
+	{
+		// If none of the vertices in the cache have any triangles left, we have to go looking for somewhere new to start.
+		if (best_triangle < 0)
+		{
+			float best_score = -1.0f;
+			while (scan_cursor < num_triangles && emitted[scan_cursor])
+				{ ++scan_cursor; }
+			for (size_t i = scan_cursor; i < num_triangles; ++i)
+			{
+				if (!emitted[i] && triangle_score[i] > best_score)
+				{
+					best_score = triangle_score[i];
+					best_triangle = (int)i;
+				}
+			}
+		}
+
+		// Emit the triangle, and remove it from each of its vertices' adjacency lists.
+		const int* tri = indices + (best_triangle * 3);
+		emitted[best_triangle] = true;
+		for (int k = 0; k < 3; ++k)
+		{
+			int v = tri[k];
+			output.push_back(v);
+
+			uint32_t* begin = adjacency.data() + adjacency_offset[v];
+			uint32_t* end = begin + remaining[v];
+			uint32_t* found = std::find(begin, end, (uint32_t)best_triangle);
+			std::swap(*found, *(end - 1));
+			remaining[v]--;
+		}
+
+		// Push the triangle's vertices to the front of the cache.
+		size_t new_count = 0;
+		for (int k = 0; k < 3; ++k)
+			{ new_cache[new_count++] = tri[k]; }
+		for (size_t i = 0; i < cache_count; ++i)
+		{
+			int v = cache[i];
+			if (v != tri[0] && v != tri[1] && v != tri[2])
+				{ new_cache[new_count++] = v; }
+		}
+
+		// Anything which fell off the end is no longer cached.
+		for (size_t i = FORSYTH_CACHE_SIZE; i < new_count; ++i)
+		{
+			cache_position[new_cache[i]] = -1;
+			vertex_score[new_cache[i]] = tables.score(-1, remaining[new_cache[i]]);
+		}
+		cache_count = min(new_count, FORSYTH_CACHE_SIZE);
+
+		for (size_t i = 0; i < cache_count; ++i)
+		{
+			cache[i] = new_cache[i];
+			cache_position[cache[i]] = (int)i;
+			vertex_score[cache[i]] = tables.score((int)i, remaining[cache[i]]);
+		}
+
+		// Rescore every triangle touching the cache, and pick the best one to emit next.
+		best_triangle = -1;
+		float best_score = -1.0f;
+		for (size_t i = 0; i < cache_count; ++i)
+		{
+			int v = cache[i];
+			for (uint32_t j = 0; j < remaining[v]; ++j)
+			{
+				uint32_t t = adjacency[adjacency_offset[v] + j];
+				const int* adj = indices + (t * 3);
+				triangle_score[t] = vertex_score[adj[0]] + vertex_score[adj[1]] + vertex_score[adj[2]];
+				if (triangle_score[t] > best_score)
+				{
+					best_score = triangle_score[t];
+					best_triangle = (int)t;
+				}
+			}
+		}
+	}
+
+	std::copy(output.begin(), output.end(), indices);
+}
+
+void OptimizeOverdraw(int* indices, size_t num_indices, const float* positions, size_t num_vertices, size_t stride, float threshold)
+{
+	size_t num_triangles = num_indices / 3;
+	if (num_triangles < 2)
+		{ return; }
+
+	// Find the points where the cache is effectively empty again; it costs nothing to split clusters there.
+	vector<uint32_t> misses(num_triangles, 0);
+	{
+		FifoCache cache(num_vertices, DEFAULT_CACHE_SIZE);
+		for (size_t i = 0; i < num_triangles; ++i)
+		{
+			for (int k = 0; k < 3; ++k)
+				{ if (cache.touch(indices[i*3+k])) { misses[i]++; } }
+		}
+	}
+
+	vector<size_t> hard_boundaries;
+	for (size_t i = 0; i < num_triangles; ++i)
+		{ if (i == 0 || misses[i] == 3) { hard_boundaries.push_back(i); } }
+	hard_boundaries.push_back(num_triangles);
+
+	// Split each hard cluster further, so long as the cache efficiency of each piece
+	// (starting from a cold cache, since clusters will be drawn out of order) stays within the threshold.
+	vector<TriangleCluster> clusters;
+	FifoCache cache(num_vertices, DEFAULT_CACHE_SIZE);
+	for (size_t h = 0; h + 1 < hard_boundaries.size(); ++h)
+	{
+		size_t hard_start = hard_boundaries[h];
+		size_t hard_end = hard_boundaries[h+1];
+
+		uint32_t hard_misses = 0;
+		for (size_t i = hard_start; i < hard_end; ++i)
+			{ hard_misses += misses[i]; }
+		float target_acmr = threshold * (float)hard_misses / (float)(hard_end - hard_start);
+
+		size_t start = hard_start;
+		uint32_t running_misses = 0;
+		cache.flush();
+		for (size_t i = hard_start; i < hard_end; ++i)
+		{
+			for (int k = 0; k < 3; ++k)
+				{ if (cache.touch(indices[i*3+k])) { running_misses++; } }
+
+			float running_acmr = (float)running_misses / (float)(i + 1 - start);
+			if (running_acmr <= target_acmr || i + 1 == hard_end)
+			{
+				clusters.push_back({start, i + 1 - start, 0.0f});
+				start = i + 1;
+				running_misses = 0;
+				cache.flush();
+			}
+		}
+	}
+
+	if (clusters.size() < 2)
+		{ return; }
+
+	// Calculate the centroid of the whole mesh, and each cluster's (area-weighted) centroid and normal.
+	vec3 mesh_centroid = VEC3_ZERO;
+	float mesh_area = 0.0f;
+	vector<vec3> cluster_centroid(clusters.size());
+	vector<vec3> cluster_normal(clusters.size());
+	for (size_t c = 0; c < clusters.size(); ++c)
+	{
+		vec3 centroid = VEC3_ZERO;
+		vec3 normal = VEC3_ZERO;
+		float area = 0.0f;
+		for (size_t i = clusters[c].start; i < clusters[c].start + clusters[c].count; ++i)
+		{
+			vec3 p0 = getPosition(positions, stride, indices[i*3+0]);
+			vec3 p1 = getPosition(positions, stride, indices[i*3+1]);
+			vec3 p2 = getPosition(positions, stride, indices[i*3+2]);
+
+			vec3 n = vec3::cross(p1 - p0, p2 - p0);
+			float a = n.magnitude();
+			centroid += (p0 + p1 + p2) * (a / 3.0f);
+			normal += n;
+			area += a;
+		}
+
+		mesh_centroid += centroid;
+		mesh_area += area;
+		cluster_centroid[c] = (area > 0.0f) ? centroid / area : centroid;
+		cluster_normal[c] = (normal.magnitude() > 0.0f) ? normal.normalized() : VEC3_ZERO;
+	}
+	if (mesh_area > 0.0f)
+		{ mesh_centroid /= mesh_area; }
+
+	// Clusters which face away from the center of the mesh are likely to occlude the rest of it, so they should be drawn first.
+	for (size_t c = 0; c < clusters.size(); ++c)
+		{ clusters[c].sort_key = vec3::dot(cluster_centroid[c] - mesh_centroid, cluster_normal[c]); }
+
+	std::stable_sort(clusters.begin(), clusters.end(),
+		[](const TriangleCluster& lhs, const TriangleCluster& rhs) { return lhs.sort_key > rhs.sort_key; });
+
+	vector<int> output;
+	output.reserve(num_triangles * 3);
+	for (const TriangleCluster& cluster : clusters)
+		{ output.insert(output.end(), indices + (cluster.start * 3), indices + ((cluster.start + cluster.count) * 3)); }
+
+	std::copy(output.begin(), output.end(), indices);
+}
+
+size_t SimplifyMesh(vector<int>& destination, const int* indices, size_t num_indices, const float* positions, size_t num_vertices, size_t stride,
+	size_t target_index_count, float target_error, float* result_error)
+{
+	size_t index_count = (num_indices / 3) * 3;
+	destination.assign(indices, indices + index_count);
+	if (result_error)
+		{ *result_error = 0.0f; }
+	if (index_count <= target_index_count || num_vertices == 0)
+		{ return index_count; }
+
+	// Work in a unit-sized space, so that errors are relative to the size of the mesh.
+	vector<vec3> pos(num_vertices);
+	vec3 lower = getPosition(positions, stride, 0), upper = lower;
+	for (size_t i = 0; i < num_vertices; ++i)
+	{
+		pos[i] = getPosition(positions, stride, (int)i);
+		lower = vec3::minimum(lower, pos[i]);
+		upper = vec3::maximum(upper, pos[i]);
+	}
+	vec3 extent = upper - lower;
+	float scale = fmaxf(extent.x, fmaxf(extent.y, extent.z));
+	scale = (scale > 0.0f) ? 1.0f / scale : 1.0f;
+	for (vec3& p : pos)
+		{ p = (p - lower) * scale; }
+
+	// Vertices which share a position (split by UVs or normals) are treated as a single point.
+	vector<int> position_id(num_vertices);
+	size_t num_positions = 0;
+	{
+		vector<int> order(num_vertices);
+		for (size_t i = 0; i < num_vertices; ++i)
+			{ order[i] = (int)i; }
+		std::sort(order.begin(), order.end(), [&](int lhs, int rhs)
+		{
+			if (pos[lhs].x != pos[rhs].x) return pos[lhs].x < pos[rhs].x;
+			if (pos[lhs].y != pos[rhs].y) return pos[lhs].y < pos[rhs].y;
+			return pos[lhs].z < pos[rhs].z;
+		});
+		for (size_t i = 0; i < num_vertices; ++i)
+		{
+			if (i > 0 && pos[order[i]] != pos[order[i-1]])
+				{ num_positions++; }
+			position_id[order[i]] = (int)num_positions;
+		}
+		num_positions++;
+	}
+
+	// Classify each position according to the edges around it.
+	vector<uint8_t> kind(num_positions, SVK_MANIFOLD);
+	unordered_set<uint64_t> border_edges;
+	{
+		vector<int> wedges(num_positions, 0);
+		vector<bool> referenced(num_vertices, false);
+		for (size_t i = 0; i < index_count; ++i)
+		{
+			if (!referenced[destination[i]])
+			{
+				referenced[destination[i]] = true;
+				wedges[position_id[destination[i]]]++;
+			}
+		}
+
+		unordered_map<uint64_t, int> edge_uses;
+		for (size_t i = 0; i < index_count; i += 3)
+		{
+			for (int k = 0; k < 3; ++k)
+			{
+				int a = position_id[destination[i + k]], b = position_id[destination[i + ((k + 1) % 3)]];
+				if (a != b) edge_uses[EdgeKey(a, b)]++;
+			}
+		}
+
+		for (auto& it : edge_uses)
+		{
+			int a = (int)(it.first >> 32), b = (int)(it.first & 0xffffffff);
+			if (it.second == 1)
+			{
+				border_edges.insert(it.first);
+				if (kind[a] == SVK_MANIFOLD) kind[a] = SVK_BORDER;
+				if (kind[b] == SVK_MANIFOLD) kind[b] = SVK_BORDER;
+			}
+			else if (it.second > 2)
+				{ kind[a] = kind[b] = SVK_LOCKED; }
+		}
+
+		for (size_t i = 0; i < num_positions; ++i)
+			{ if (wedges[i] > 1) kind[i] = SVK_LOCKED; }
+	}
+
+	// Accumulate the planes of each triangle (and each border edge) into the quadric of every position it touches.
+	vector<Quadric> quadrics(num_positions, Quadric{});
+	for (size_t i = 0; i < index_count; i += 3)
+	{
+		vec3 p[3] = { pos[destination[i]], pos[destination[i+1]], pos[destination[i+2]] };
+		vec3 normal = vec3::cross(p[1] - p[0], p[2] - p[0]);
+		float area = normal.magnitude();
+		if (area <= 0.0f)
+			continue;
+		normal /= area;
+
+		Quadric q = Quadric::fromPlane(normal, -vec3::dot(normal, p[0]), area);
+		for (int k = 0; k < 3; ++k)
+			{ quadrics[position_id[destination[i + k]]] += q; }
+
+		for (int k = 0; k < 3; ++k)
+		{
+			int a = position_id[destination[i + k]], b = position_id[destination[i + ((k + 1) % 3)]];
+			if (border_edges.count(EdgeKey(a, b)) == 0)
+				continue;
+
+			vec3 edge = p[(k + 1) % 3] - p[k];
+			vec3 edge_normal = vec3::cross(edge, normal);
+			float length = edge_normal.magnitude();
+			if (length <= 0.0f)
+				continue;
+			edge_normal /= length;
+
+			Quadric border = Quadric::fromPlane(edge_normal, -vec3::dot(edge_normal, p[k]), edge.magnitude_squared() * BORDER_EDGE_WEIGHT);
+			quadrics[a] += border;
+			quadrics[b] += border;
+		}
+	}
+
+	float max_error_sq = target_error * target_error;
+	float result_error_sq = 0.0f;
+
+	vector<EdgeCollapse> candidates;
+	vector<uint32_t> adjacency_offset(num_vertices + 1);
+	vector<uint32_t> adjacency;
+	vector<int> remap(num_vertices);
+	vector<bool> touched(num_positions);
+
+	while (index_count > target_index_count)
+	{
+		// Gather every legal collapse along the remaining edges, cheapest first.
+		candidates.clear();
+		for (size_t i = 0; i < index_count; i += 3)
+		{
+			for (int k = 0; k < 3; ++k)
+			{
+				int v[2] = { destination[i + k], destination[i + ((k + 1) % 3)] };
+				int a = position_id[v[0]], b = position_id[v[1]];
+				if (a == b)
+					continue;
+
+				for (int dir = 0; dir < 2; ++dir)
+				{
+					int from = v[dir], to = v[1 - dir];
+					uint8_t from_kind = kind[position_id[from]];
+					if (from_kind == SVK_LOCKED)
+						continue;
+					if (from_kind == SVK_BORDER && border_edges.count(EdgeKey(a, b)) == 0)
+						continue;
+
+					float cost = quadrics[position_id[from]].error(pos[to]) + quadrics[position_id[to]].error(pos[to]);
+					candidates.push_back({ from, to, cost });
+				}
+			}
+		}
+
+		std::sort(candidates.begin(), candidates.end(),
+			[](const EdgeCollapse& lhs, const EdgeCollapse& rhs) { return lhs.cost < rhs.cost; });
+
+		// Build a list of which triangles use each vertex, so we can check for triangles flipping over.
+		std::fill(adjacency_offset.begin(), adjacency_offset.end(), 0);
+		for (size_t i = 0; i < index_count; ++i)
+			{ adjacency_offset[destination[i] + 1]++; }
+		for (size_t i = 0; i < num_vertices; ++i)
+			{ adjacency_offset[i + 1] += adjacency_offset[i]; }
+		adjacency.resize(index_count);
+		{
+			vector<uint32_t> fill(adjacency_offset.begin(), adjacency_offset.end() - 1);
+			for (size_t i = 0; i < index_count; ++i)
+				{ adjacency[fill[destination[i]]++] = (uint32_t)(i / 3); }
+		}
+
+		for (size_t i = 0; i < num_vertices; ++i)
+			{ remap[i] = (int)i; }
+		std::fill(touched.begin(), touched.end(), false);
+
+		size_t triangles_to_remove = (index_count - target_index_count) / 3;
+		size_t triangles_removed = 0;
+		size_t collapses = 0;
+
+		for (const EdgeCollapse& collapse : candidates)
+		{
+			if (collapse.cost > max_error_sq || triangles_removed >= triangles_to_remove)
+				break;
+
+			int from_pos = position_id[collapse.from], to_pos = position_id[collapse.to];
+			if (touched[from_pos] || touched[to_pos])
+				continue;
+
+			// Reject the collapse if it would flip any of the surrounding triangles.
+			bool flips = false;
+			for (uint32_t j = adjacency_offset[collapse.from]; j < adjacency_offset[collapse.from + 1] && !flips; ++j)
+			{
+				const int* tri = destination.data() + (adjacency[j] * 3);
+				if (position_id[tri[0]] == to_pos || position_id[tri[1]] == to_pos || position_id[tri[2]] == to_pos)
+					continue;
+
+				vec3 before[3], after[3];
+				for (int k = 0; k < 3; ++k)
+				{
+					before[k] = pos[tri[k]];
+					after[k] = (tri[k] == collapse.from) ? pos[collapse.to] : pos[tri[k]];
+				}
+				vec3 n0 = vec3::cross(before[1] - before[0], before[2] - before[0]);
+				vec3 n1 = vec3::cross(after[1] - after[0], after[2] - after[0]);
+				if (vec3::dot(n0, n1) <= 0.0f)
+					flips = true;
+			}
+			if (flips)
+				continue;
+
+			remap[collapse.from] = collapse.to;
+			quadrics[to_pos] += quadrics[from_pos];
+			result_error_sq = fmaxf(result_error_sq, collapse.cost);
+
+			// Don't let any other collapse in this pass touch the neighbourhood we just changed.
+			for (uint32_t j = adjacency_offset[collapse.from]; j < adjacency_offset[collapse.from + 1]; ++j)
+			{
+				const int* tri = destination.data() + (adjacency[j] * 3);
+				for (int k = 0; k < 3; ++k)
+					{ touched[position_id[tri[k]]] = true; }
+			}
+
+			triangles_removed += (kind[from_pos] == SVK_BORDER) ? 1 : 2;
+			collapses++;
+		}
+
+		if (collapses == 0)
+			break;
+
+		// Apply the collapses, and throw out any triangles which have become degenerate.
+		size_t write = 0;
+		for (size_t i = 0; i < index_count; i += 3)
+		{
+			int a = remap[destination[i]], b = remap[destination[i+1]], c = remap[destination[i+2]];
+			if (position_id[a] == position_id[b] || position_id[b] == position_id[c] || position_id[a] == position_id[c])
+				continue;
+
+			destination[write++] = a;
+			destination[write++] = b;
+			destination[write++] = c;
+		}
+		index_count = write;
+		destination.resize(index_count);
+	}
+
+	if (result_error)
+		{ *result_error = sqrtf(result_error_sq); }
+
+	return index_count;
+}
+
+void BuildMeshlets(vector<Meshlet>& meshlets, const int* indices, size_t num_indices, const float* positions, size_t num_vertices, size_t stride,
+	size_t max_vertices, size_t max_triangles)
+{
+	meshlets.clear();
+
+	// Tracks which meshlet each vertex was last added to, so we only count each vertex once per meshlet.
+	vector<int> vertex_owner(num_vertices, -1);
+
+	Meshlet current = {};
+	size_t current_vertices = 0;
+	for (size_t i = 0; i + 2 < num_indices; i += 3)
+	{
+		int owner = (int)meshlets.size();
+		size_t new_vertices = 0;
+		for (int k = 0; k < 3; ++k)
+			{ if (vertex_owner[indices[i + k]] != owner) { new_vertices++; } }
+
+		// Close off the current meshlet if this triangle won't fit.
+		if (current.count > 0 && (current_vertices + new_vertices > max_vertices || (size_t)(current.count / 3) + 1 > max_triangles))
+		{
+			CalcMeshletBounds(current, indices, positions, stride);
+			meshlets.push_back(current);
+
+			current = {};
+			current.start = (int32_t)i;
+			current_vertices = 0;
+			owner = (int)meshlets.size();
+		}
+
+		for (int k = 0; k < 3; ++k)
+		{
+			if (vertex_owner[indices[i + k]] != owner)
+			{
+				vertex_owner[indices[i + k]] = owner;
+				current_vertices++;
+			}
+		}
+		current.count += 3;
+	}
+
+	if (current.count > 0)
+	{
+		CalcMeshletBounds(current, indices, positions, stride);
+		meshlets.push_back(current);
+	}
+}
+
+size_t OptimizeVertexFetch(vector<int>& remap, int* indices, size_t num_indices, size_t num_vertices)
+{
+	remap.assign(num_vertices, -1);
+
+	int next_vertex = 0;
+	for (size_t i = 0; i < num_indices; ++i)
+	{
+		int& index = indices[i];
+		if (remap[index] < 0)
+			{ remap[index] = next_vertex++; }
+		index = remap[index];
+	}
+
+	return (size_t)next_vertex;
+}
+
+} // namespace meshopt
\ No newline at end of file
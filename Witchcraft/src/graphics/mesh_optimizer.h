@@ -0,0 +1,72 @@
+#ifndef HVH_WC_GRAPHICS_MESHOPTIMIZER_H
+#define HVH_WC_GRAPHICS_MESHOPTIMIZER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "meshlet.h"
+
+namespace meshopt {
+
+	// Post-transform cache size assumed by the optimizer and the simulator.
+	// Most hardware behaves like a FIFO somewhere in the 16-32 entry range.
+	constexpr const size_t DEFAULT_CACHE_SIZE = 16;
+	constexpr const size_t FORSYTH_CACHE_SIZE = 32;
+
+	// How much the cache efficiency is allowed to degrade (as a ratio of ACMR)
+	// in exchange for ordering triangle clusters to reduce overdraw.
+	constexpr const float DEFAULT_OVERDRAW_THRESHOLD = 1.05f;
+
+	struct CacheStatistics
+	{
+		uint32_t vertices_transformed;
+		uint32_t vertices_referenced;
+		uint32_t triangles;
+
+		float acmr; // Average cache miss ratio; transformed vertices per triangle.  0.5 is the theoretical best, 3.0 is the worst.
+		float atvr; // Average transform to vertex ratio; transformed vertices per unique vertex.  1.0 is ideal.
+	};
+
+	/* Runs the given triangle list through a simulated FIFO post-transform vertex cache. */
+	CacheStatistics SimulateVertexCache(const int* indices, size_t num_indices, size_t num_vertices, size_t cache_size = DEFAULT_CACHE_SIZE);
+
+	/* Reorders triangles in-place to improve post-transform vertex cache hits (Tom Forsyth's linear-speed algorithm). */
+	void OptimizeVertexCache(int* indices, size_t num_indices, size_t num_vertices);
+
+	/* Reorders clusters of cache-optimized triangles so outward-facing clusters are drawn first, reducing overdraw. */
+	/* 'positions' points to the x co-ordinate of the first vertex, and each vertex is 'stride' bytes apart. */
+	void OptimizeOverdraw(int* indices, size_t num_indices, const float* positions, size_t num_vertices, size_t stride, float threshold = DEFAULT_OVERDRAW_THRESHOLD);
+
+	/* Simplifies a triangle list using quadric error metrics.  Edges are collapsed onto existing vertices, */
+	/* so the result references the same vertex buffer as the original and can be stored as an additional index range. */
+	/* 'target_error' is relative to the size of the mesh; simplification stops at whichever target is reached first. */
+	/* Returns the number of indices written to 'destination', and optionally the relative error of the result. */
+	size_t SimplifyMesh(std::vector<int>& destination, const int* indices, size_t num_indices, const float* positions, size_t num_vertices, size_t stride,
+		size_t target_index_count, float target_error, float* result_error = nullptr);
+
+	/* Splits a triangle list into meshlets; consecutive runs of triangles which stay within the given limits. */
+	/* Triangles are not reordered, so this should run after the other optimizations.  Meshlet ranges are relative to 'indices'. */
+	void BuildMeshlets(std::vector<Meshlet>& meshlets, const int* indices, size_t num_indices, const float* positions, size_t num_vertices, size_t stride,
+		size_t max_vertices = MESHLET_MAX_VERTICES, size_t max_triangles = MESHLET_MAX_TRIANGLES);
+
+	/* Builds a table which renumbers vertices in the order they are first referenced by the index buffer, and rewrites the indices to match. */
+	/* remap[old_index] is the new index, or -1 if the vertex is never referenced.  Returns the number of vertices still in use. */
+	size_t OptimizeVertexFetch(std::vector<int>& remap, int* indices, size_t num_indices, size_t num_vertices);
+
+	/* Applies a remap table produced by OptimizeVertexFetch to a vertex array. */
+	template <typename T>
+	void RemapVertices(std::vector<T>& vertices, const std::vector<int>& remap, size_t new_count)
+	{
+		std::vector<T> result(new_count);
+		for (size_t i = 0; i < vertices.size(); ++i)
+		{
+			if (remap[i] >= 0)
+				{ result[remap[i]] = vertices[i]; }
+		}
+		vertices.swap(result);
+	}
+
+} // namespace meshopt
+
+#endif // HVH_WC_GRAPHICS_MESHOPTIMIZER_H
\ No newline at end of file
@@ -0,0 +1,71 @@
+#ifndef HVH_WC_GRAPHICS_MESHLET_H
+#define HVH_WC_GRAPHICS_MESHLET_H
+
+#include "math/vmath.h"
+
+/*
+A meshlet is a small run of triangles within a mesh's index range, small enough to be culled on its own.
+Each one carries a bounding sphere for frustum culling, and a cone which contains every triangle's normal,
+so that a meshlet which faces entirely away from the camera can be skipped.
+Everything is stored in the model's local space.
+*/
+
+// Limits used when splitting meshes into meshlets.
+constexpr const size_t MESHLET_MAX_VERTICES = 64;
+constexpr const size_t MESHLET_MAX_TRIANGLES = 124;
+
+struct Meshlet
+{
+	// Range of indices within the model's index buffer.
+	int32_t start, count;
+
+	vmath::vec3 center;
+	float radius;
+
+	// A cone_cutoff of 1 or more means the normals are too spread out for the meshlet to ever be back-facing.
+	vmath::vec3 cone_axis;
+	float cone_cutoff;
+
+	/* Returns true if every triangle in the meshlet faces away from the given (local space) eye position. */
+	inline bool isBackfacing(vmath::vec3 eye_pos) const
+	{
+		if (cone_cutoff >= 1.0f)
+			{ return false; }
+
+		vmath::vec3 to_center = center - eye_pos;
+		return vmath::vec3::dot(to_center, cone_axis) >= (cone_cutoff * to_center.magnitude()) + radius;
+	}
+
+	/* Returns true if the meshlet's bounding sphere is at least partially inside the given frustum planes. */
+	inline bool isInFrustum(const vmath::vec4 planes[6]) const
+	{
+		for (int i = 0; i < 6; ++i)
+		{
+			if (vmath::vec4::dot(planes[i], vmath::vec4(center, 1.0f)) < -radius)
+				{ return false; }
+		}
+		return true;
+	}
+};
+
+/* Extracts the six planes of a view frustum from a (model-view-)projection matrix, with normals facing inward. */
+/* Planes are normalized, so distances measured against them are in the matrix's input space. */
+inline void ExtractFrustumPlanes(const vmath::mat4& mvp, vmath::vec4 planes[6])
+{
+	vmath::vec4 r0 = mvp.row(0), r1 = mvp.row(1), r2 = mvp.row(2), r3 = mvp.row(3);
+	planes[0] = r3 + r0; // left
+	planes[1] = r3 - r0; // right
+	planes[2] = r3 + r1; // bottom
+	planes[3] = r3 - r1; // top
+	planes[4] = r3 + r2; // near
+	planes[5] = r3 - r2; // far
+
+	for (int i = 0; i < 6; ++i)
+	{
+		float length = sqrtf((planes[i].x * planes[i].x) + (planes[i].y * planes[i].y) + (planes[i].z * planes[i].z));
+		if (length > 0.0f)
+			{ planes[i] /= length; }
+	}
+}
+
+#endif // HVH_WC_GRAPHICS_MESHLET_H
\ No newline at end of file
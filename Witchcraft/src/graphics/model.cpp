@@ -19,6 +19,8 @@ void Model::Clear()
 {
 	refcount = 0;
 	import_transform = MAT4_IDENTITY;
+	bounds_center = VEC3_ZERO;
+	bounds_radius = 0.0f;
 
 	// Geometry
 	{
@@ -32,6 +34,11 @@ void Model::Clear()
 		geom.positions_ptr = nullptr;
 		geom.surface_ptr = nullptr;
 		geom.skin_ptr = nullptr;
+		geom.surface_octahedral_ptr = nullptr;
+		geom.position_offset = VEC3_ZERO;
+		geom.position_scale = 1.0f;
+		geom.quantize_positions = false;
+		geom.octahedral_surfaces = false;
 
 		geom.num_indices = 0;
 		geom.index_size = 0;
@@ -48,6 +55,18 @@ void Model::Clear()
 		meshes.primcount = nullptr;
 		meshes.material_id = nullptr;
 		meshes.material_ptr = nullptr;
+
+		meshes.num_lods = 1;
+		for (int i = 0; i < lod::MAX_LEVELS; ++i)
+			{ meshes.lod_screen_size[i] = (i == 0) ? 1.0f : 0.0f; }
+	}
+
+	// Meshlets
+	{
+		meshlets.count = 0;
+		meshlets.meshlet = nullptr;
+		meshlets.mesh_first = nullptr;
+		meshlets.mesh_count = nullptr;
 	}
 
 	// Skeleton
@@ -91,10 +110,12 @@ void Model::Clear()
 		animations.clip = nullptr;
 
 		animations.anim_map.clear();
+		animations.anim_bone_remap.clear();
+		animations.import_bone_remaps.clear();
 
 #ifndef MODEL_CONVERTER
 		for (auto& it : animations.imports)
-			{ Model::Unload(it.first.c_str); }
+			{ Model::UnloadAnimations(it.first.c_str); }
 		animations.imports.clear();
 #endif
 	}
@@ -119,12 +140,42 @@ void Model::Clear()
 	ragbone_flags = nullptr;
 }
 
+void Model::CalcBounds()
+{
+	if (geom.num_vertices <= 0 || geom.positions_ptr == nullptr)
+	{
+		bounds_center = VEC3_ZERO;
+		bounds_radius = 0.0f;
+		return;
+	}
+
+	// Center the sphere on the bounding box, which is close enough to optimal for culling and LOD selection.
+	vec3 lower = geom.positions_ptr[0].to_vec3();
+	vec3 upper = lower;
+	for (int32_t i = 1; i < geom.num_vertices; ++i)
+	{
+		lower = vec3::minimum(lower, geom.positions_ptr[i].to_vec3());
+		upper = vec3::maximum(upper, geom.positions_ptr[i].to_vec3());
+	}
+	bounds_center = (lower + upper) * 0.5f;
+
+	float radius_sq = 0.0f;
+	for (int32_t i = 0; i < geom.num_vertices; ++i)
+		{ radius_sq = fmaxf(radius_sq, vec3::distance_squared(bounds_center, geom.positions_ptr[i].to_vec3())); }
+	bounds_radius = sqrtf(radius_sq);
+}
+
 #ifndef MODEL_CONVERTER
 #include "renderer.h"
 #include "material.h"
+#include "camera.h"
+#include "scene/transform.h"
 
 map<string, Model*> loaded_models;
 
+// Files which have only been loaded for their animations.  These never own any geometry or materials.
+map<string, Model*> loaded_animation_libraries;
+
 Model* Model::Load(const char* filename)
 {
 	Model* result = nullptr;
@@ -164,12 +215,18 @@ Model* Model::Load(const char* filename)
 		}
 	}
 
+	result->CalcBounds();
+	result->CompressVertices();
+	result->CompressAnimations();
+	result->InternAnimationEvents();
+
 	if (result->geom.num_vertices > 0)
 	{
 		// Send the model data to the graphics card.
 		result->geom.geometry.Load(GEOMETRY_PRIMITIVE_TRIANGLES,
 			result->geom.buffer_ptr, (VertexFormatFlags)result->geom.vertex_format, result->geom.num_vertices,
 			result->geom.indices_ptr, result->geom.index_size, result->geom.num_indices);
+		result->geom.geometry.setDequantization(result->geom.position_offset, result->geom.position_scale);
 	}
 	
 
@@ -184,6 +241,164 @@ Model* Model::Load(const char* filename)
 	return result;
 }
 
+void Model::CompressVertices()
+{
+	if (geom.num_vertices <= 0 || geom.buffer_ptr == nullptr)
+		{ return; }
+
+	// Large skins don't have a stream of their own to copy across, so those models are left exactly as they were loaded.
+	if (geom.vertex_format & VF_SKIN_LARGE)
+		{ return; }
+
+	// Positions stay as floats unless the model asked otherwise.
+	// Skinned positions are transformed by their bones before anything else touches them, so they always stay as floats.
+	bool quantize_positions = geom.quantize_positions && (geom.vertex_format & VF_POSITION) && !(geom.vertex_format & VF_SKIN);
+	bool octahedral_surface = geom.octahedral_surfaces && (geom.vertex_format & VF_SURFACE);
+	if (!quantize_positions && !octahedral_surface)
+		{ return; }
+
+	uint32_t format = geom.vertex_format;
+	if (quantize_positions)
+		{ format = (format & ~VF_POSITION) | VF_POSITION_QUANTIZED; }
+	if (octahedral_surface)
+		{ format = (format & ~VF_SURFACE) | VF_SURFACE_OCTAHEDRAL; }
+
+	// Attributes are stored one after another in the same order InitVertex expects them in.
+	uint32_t vertex_buffer_size = calc_bytes_per_vertex(format) * geom.num_vertices;
+	uint32_t index_buffer_size = geom.index_size * geom.num_indices;
+	char* buffer = new char[vertex_buffer_size + index_buffer_size];
+	char* running_ptr = buffer;
+
+	if (quantize_positions)
+	{
+		// Every axis shares the largest extent as its scale, so the dequantization never skews normals.
+		vec3 lower = geom.positions_ptr[0].to_vec3();
+		vec3 upper = lower;
+		for (int32_t i = 1; i < geom.num_vertices; ++i)
+		{
+			lower = vec3::minimum(lower, geom.positions_ptr[i].to_vec3());
+			upper = vec3::maximum(upper, geom.positions_ptr[i].to_vec3());
+		}
+		vec3 extent = upper - lower;
+		geom.position_offset = lower;
+		geom.position_scale = fmaxf(fmaxf(extent.x, extent.y), extent.z);
+		if (geom.position_scale <= 0.0f)
+			{ geom.position_scale = 1.0f; }
+
+		VertexPositionQuantized* positions = (VertexPositionQuantized*)running_ptr;
+		for (int32_t i = 0; i < geom.num_vertices; ++i)
+			{ positions[i].quantize(geom.positions_ptr[i].to_vec3(), geom.position_offset, geom.position_scale); }
+		running_ptr = (char*)(positions + geom.num_vertices);
+	}
+	else if (geom.vertex_format & VF_POSITION)
+	{
+		memcpy(running_ptr, geom.positions_ptr, sizeof(VertexPosition) * geom.num_vertices);
+		running_ptr += sizeof(VertexPosition) * geom.num_vertices;
+	}
+
+	if (octahedral_surface)
+	{
+		VertexSurfaceOctahedral* surfaces = (VertexSurfaceOctahedral*)running_ptr;
+		for (int32_t i = 0; i < geom.num_vertices; ++i)
+		{
+			VertexSurface& in = geom.surface_ptr[i];
+			surfaces[i].s = in.s;
+			surfaces[i].t = in.t;
+			surfaces[i].shading = in.shading;
+			surfaces[i].vec3_to_normal(in.normal_to_vec3());
+			surfaces[i].vec3_to_tangent(in.tangent_to_vec3(), (in.bs < 0) ? -1.0f : 1.0f);
+		}
+		geom.surface_octahedral_ptr = surfaces;
+		running_ptr = (char*)(surfaces + geom.num_vertices);
+	}
+
+	if (geom.vertex_format & VF_SKIN)
+	{
+		memcpy(running_ptr, geom.skin_ptr, sizeof(VertexSkin) * geom.num_vertices);
+		geom.skin_ptr = (VertexSkin*)running_ptr;
+		running_ptr += sizeof(VertexSkin) * geom.num_vertices;
+	}
+
+	memcpy(running_ptr, geom.indices_ptr, index_buffer_size);
+	geom.indices_ptr = running_ptr;
+
+	// The float positions and full surfaces are gone now.
+	if (quantize_positions)
+		{ geom.positions_ptr = nullptr; }
+	else if (geom.vertex_format & VF_POSITION)
+		{ geom.positions_ptr = (VertexPosition*)buffer; }
+	geom.surface_ptr = nullptr;
+
+	delete[] (char*)geom.buffer_ptr;
+	geom.buffer_ptr = buffer;
+	geom.buffer_size = vertex_buffer_size + index_buffer_size;
+	geom.vertex_format = format;
+}
+
+void Model::getVertexNormals(std::vector<vec3>& out)
+{
+	out.clear();
+	if (geom.surface_octahedral_ptr != nullptr)
+	{
+		out.resize(geom.num_vertices);
+		for (int32_t i = 0; i < geom.num_vertices; ++i)
+			{ out[i] = geom.surface_octahedral_ptr[i].normal_to_vec3(); }
+	}
+	else if (geom.surface_ptr != nullptr)
+	{
+		out.resize(geom.num_vertices);
+		for (int32_t i = 0; i < geom.num_vertices; ++i)
+			{ out[i] = geom.surface_ptr[i].normal_to_vec3(); }
+	}
+}
+
+void Model::CalcBoneRemap(const Skeleton& source, vector<int32_t>& out)
+{
+	out.clear();
+
+	bool identical = (skeleton.num_bones <= source.num_bones);
+	for (int32_t i = 0; identical && i < skeleton.num_bones; ++i)
+		{ identical = (skeleton.bone_name[i] == source.bone_name[i]); }
+	if (identical)
+		{ return; }
+
+	out.assign(skeleton.num_bones, -1);
+	for (int32_t i = 0; i < skeleton.num_bones; ++i)
+	{
+		auto it = source.bone_map.find(skeleton.bone_name[i]);
+		if (it != source.bone_map.end())
+			{ out[i] = it->second; }
+	}
+}
+
+void Model::InternAnimationEvents()
+{
+	for (int32_t i = 0; i < animations.count; ++i)
+	{
+		AnimationClip& clip = animations.clip[i];
+		clip.event_ids.resize(clip.events.size());
+		for (size_t j = 0; j < clip.events.size(); ++j)
+			{ clip.event_ids[j] = InternAnimationEvent(clip.events.get<1>(j).c_str); }
+	}
+}
+
+void Model::CompressAnimations()
+{
+	for (int32_t i = 0; i < animations.count; ++i)
+	{
+		AnimationClip& clip = animations.clip[i];
+		CompressAnimationClip(clip.compressed, clip);
+
+		// Nothing reads the channels once the clip is compressed, but their names are kept for any tools which need them.
+		for (AnimationChannel& channel : clip.channels)
+		{
+			channel.position_keys = StructOfArrays<float, vec3>();
+			channel.rotation_keys = StructOfArrays<float, quat>();
+			channel.scale_keys = StructOfArrays<float, vec3>();
+		}
+	}
+}
+
 void Model::Unload(const char* filename)
 {
 	if (loaded_models.count(filename) == 0)
@@ -204,9 +419,80 @@ void Model::Unload(const char* filename)
 	}
 }
 
+Model* Model::LoadAnimations(const char* filename)
+{
+	Model* result = nullptr;
+
+	// Check to see if the library's already been loaded.
+	if (loaded_animation_libraries.count(filename) != 0)
+	{
+		result = loaded_animation_libraries[filename];
+		result->refcount++;
+		return result;
+	}
+
+	// If the whole model is already loaded, its clips are just as good.
+	if (loaded_models.count(filename) != 0)
+	{
+		result = loaded_models[filename];
+		result->refcount++;
+		return result;
+	}
+
+	// Open the file.
+	char full_filename[64];
+	snprintf(full_filename, 64, "%s%s", MODEL_FOLDER, filename);
+	InFile file = filemanager::LoadSingleFile(full_filename, ios::binary);
+	if (file.is_open() == false)
+	{
+		plog::error("Failed to open animation file '%s'.\n", filename);
+		return nullptr;
+	}
+
+	result = new Model();
+
+	const char* err = nullptr;
+	if ((err = result->LoadXML(file, true)) != nullptr)
+	{
+		plog::error("Failed to load animation file '%s':\n", filename);
+		plog::errmore("%s\n", err);
+		delete result;
+		return nullptr;
+	}
+
+	result->CompressAnimations();
+	result->InternAnimationEvents();
+
+	result->refcount = 1;
+	loaded_animation_libraries[filename] = result;
+	return result;
+}
+
+void Model::UnloadAnimations(const char* filename)
+{
+	// Anything which isn't a library was shared from a full model, so it goes back through the usual path.
+	if (loaded_animation_libraries.count(filename) == 0)
+	{
+		Model::Unload(filename);
+		return;
+	}
+
+	Model* ptr = loaded_animation_libraries[filename];
+	ptr->refcount--;
+	if (ptr->refcount <= 0)
+	{
+		delete ptr;
+		loaded_animation_libraries.erase(filename);
+	}
+}
+
 void Model::ImportAnimations(const char* filename)
 {
-	Model* ptr = Model::Load(filename);
+	if (animations.imports.count(filename) != 0)
+		{ return; }
+
+	// Only the clips are needed, so the file's geometry and materials are never loaded.
+	Model* ptr = Model::LoadAnimations(filename);
 	if (!ptr)
 	{
 		plog::error("Couldn't import animations from '%s'.\n", filename);
@@ -215,6 +501,18 @@ void Model::ImportAnimations(const char* filename)
 
 	animations.imports[filename] = ptr;
 
+	// Every clip in the file shares its skeleton, so they can all share one remap.
+	vector<int32_t>& remap = animations.import_bone_remaps[filename];
+	CalcBoneRemap(ptr->skeleton, remap);
+	if (remap.size() > 0)
+	{
+		int32_t num_matched = 0;
+		for (int32_t source_bone : remap)
+			{ if (source_bone >= 0) num_matched++; }
+		if (num_matched < skeleton.num_bones)
+			{ plog::warning("Only %i of %i bones are animated by the animations imported from '%s'.\n", num_matched, skeleton.num_bones, filename); }
+	}
+
 	for (int32_t i = 0; i < ptr->animations.count; ++i)
 	{
 		AnimationClip* anim = &ptr->animations.clip[i];
@@ -227,18 +525,66 @@ void Model::ImportAnimations(const char* filename)
 		}
 
 		animations.anim_map[anim->name] = anim;
+		if (remap.size() > 0)
+			{ animations.anim_bone_remap[anim->name] = remap.data(); }
 
 	} // for each animation
 }
 
-void Model::Draw(entity::ID transformid)
+void Model::Draw(entity::ID transformid, int lod, const UniformBufferCamera* camera)
 {
+	if (lod < 0 || lod >= meshes.num_lods)
+		{ lod = 0; }
+
+	// Skinned models don't stay inside their bind pose's bounds, so only static models cull their meshlets.
+	bool cull_meshlets = (camera != nullptr && lod == 0 && meshlets.count > 0 && skeleton.num_bones == 0);
+	vec4 frustum[6];
+	vec3 local_eye = VEC3_ZERO;
+	if (cull_meshlets)
+	{
+		// Bring the camera into the model's space, rather than bringing every meshlet into world space.
+		mat4 world = entity::transform::getMatrix(transformid);
+		ExtractFrustumPlanes(camera->projview * world, frustum);
+		local_eye = (world.inverted() * vec4(camera->eye_pos.xyz, 1.0f)).xyz;
+	}
+
+	const int32_t* start = meshes.start + (lod * meshes.count);
+	const int32_t* primcount = meshes.primcount + (lod * meshes.count);
 	for (size_t i = 0; i < meshes.count; ++i)
 	{
 		if (meshes.material_ptr[i] == nullptr)
 			{ continue; }
 
-		renderer::SubmitRenderable(transformid, &geom.geometry, meshes.material_ptr[i], meshes.start[i], meshes.primcount[i]);
+		if (!cull_meshlets || meshlets.mesh_count[i] == 0)
+		{
+			renderer::SubmitRenderable(transformid, &geom.geometry, meshes.material_ptr[i], start[i], primcount[i]);
+			continue;
+		}
+
+		// The light sees things the camera doesn't, so shadows get the whole mesh and only the main view is culled.
+		renderer::SubmitRenderable(transformid, &geom.geometry, meshes.material_ptr[i], start[i], primcount[i], renderer::SUBMIT_SHADOW);
+
+		// Merge runs of visible meshlets, so we submit as few ranges as possible.
+		int32_t run_start = 0, run_end = -1;
+		const Meshlet* mesh_meshlets = meshlets.meshlet + meshlets.mesh_first[i];
+		for (int32_t j = 0; j < meshlets.mesh_count[i]; ++j)
+		{
+			const Meshlet& meshlet = mesh_meshlets[j];
+			if (meshlet.isBackfacing(local_eye) || !meshlet.isInFrustum(frustum))
+				{ continue; }
+
+			if (meshlet.start == run_end)
+				{ run_end += meshlet.count; }
+			else
+			{
+				if (run_end >= 0)
+					{ renderer::SubmitRenderable(transformid, &geom.geometry, meshes.material_ptr[i], run_start, run_end - run_start, renderer::SUBMIT_MAIN_VIEW); }
+				run_start = meshlet.start;
+				run_end = meshlet.start + meshlet.count;
+			}
+		}
+		if (run_end >= 0)
+			{ renderer::SubmitRenderable(transformid, &geom.geometry, meshes.material_ptr[i], run_start, run_end - run_start, renderer::SUBMIT_MAIN_VIEW); }
 	}
 }
 
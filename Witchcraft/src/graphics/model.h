@@ -3,11 +3,16 @@
 
 #ifndef MODEL_CONVERTER
 class Material;
+struct UniformBufferCamera;
 #include "geometry.h"
 #include "scene/entity.h"
 #endif // MODEL_CONVERTER
 
 #include "vertex.h"
+#include "lod.h"
+#include "meshlet.h"
+#include "animation_compression.h"
+#include "animation_events.h"
 #include "math/vmath.h"
 #include "tools/structofarrays.h"
 #include "tools/fixedstring.h"
@@ -110,22 +115,46 @@ struct AnimationClip
 	StructOfArrays<float, FixedString<32>> events;
 	std::vector<AnimationChannel> channels;
 
-	std::vector<const char*> getEventsBetweenFrames(float prev_time, float this_time)
+	// Each event's interned ID, in the same order as 'events'.  Filled in when the model is loaded.
+	std::vector<AnimationEventID> event_ids;
+
+	// Once a clip has been compressed, its channels are emptied and every sample comes from here instead.
+	CompressedAnimationClip compressed;
+
+	void getTransformForBone(size_t bone_index, float now, bool loop, vmath::vec3& translation, vmath::quat& rotation, vmath::vec3& scale, uint32_t* cursor = nullptr)
 	{
-		std::vector<const char*> result;
+		if (compressed.isEmpty() == false)
+		{
+			compressed.Sample(bone_index, now, loop, translation, rotation, scale, cursor);
+			return;
+		}
+
+		if (bone_index >= channels.size())
+			return;
 
-		for (size_t i = 0; i < events.size(); ++i)
+		AnimationChannel& channel = channels[bone_index];
+		if (channel.isEmpty() == false)
 		{
-			if (events.get<0>(i) < prev_time)
+			translation = channel.getValueAtTime(channel.position_keys, now, loop, vmath::VEC3_ZERO);
+			rotation = channel.getValueAtTime(channel.rotation_keys, now, loop, vmath::QUAT_IDENTITY);
+			scale = channel.getValueAtTime(channel.scale_keys, now, loop, vmath::VEC3_ONE);
+		}
+	}
+
+	// Adds every event after 'prev_time' and up to 'this_time' to 'out'.  If 'include_start' is true, events right at 'prev_time' count too.
+	void getEventsBetweenFrames(float prev_time, float this_time, bool include_start, int layer, AnimationEventList& out)
+	{
+		for (size_t i = 0; i < event_ids.size(); ++i)
+		{
+			float event_time = events.get<0>(i);
+			if (event_time < prev_time || (event_time == prev_time && !include_start))
 				continue;
 
-			if (events.get<0>(i) > this_time)
+			if (event_time > this_time)
 				break;
 
-			result.push_back(events.get<1>(i).c_str);
+			out.push(event_ids[i], layer);
 		}
-
-		return result;
 	}
 };
 
@@ -142,7 +171,8 @@ public:
 
 	void Clear();
 
-	const char* LoadXML(std::istream& file);
+	/* If 'animations_only' is set, only the skeleton and animation clips are read; geometry, meshes, and physics are skipped. */
+	const char* LoadXML(std::istream& file, bool animations_only = false);
 	const char* SaveXML(std::ostream& file);
 
 	const char* LoadBin(std::istream& file) { return ""; }
@@ -150,17 +180,47 @@ public:
 
 #ifdef MODEL_CONVERTER
 	bool LoadFBX(const char* filename, const char* password = nullptr);
+
+	// Removes animation keys which can be rebuilt within tolerance, optionally logging how well each clip compresses.
+	void ReduceAnimations(bool report);
+
+	// Marks the model to have its positions quantized to 16 bits when it's loaded (see Model::CompressVertices).
+	void setQuantizePositions(bool val)
+		{ geom.quantize_positions = val; }
+
+	// Marks the model to have its normals and tangents packed into octahedral surfaces when it's loaded (see Model::CompressVertices).
+	void setOctahedralSurfaces(bool val)
+		{ geom.octahedral_surfaces = val; }
 #endif
 
 #ifndef MODEL_CONVERTER
 	static Model* Load(const char* filename);
 	static void Unload(const char* filename);
 
+	/* Loads a model file as an animation library; only its skeleton and clips, with nothing sent to the graphics card. */
+	/* If the file is already loaded as a full model, that model is shared instead. */
+	static Model* LoadAnimations(const char* filename);
+	static void UnloadAnimations(const char* filename);
+
 	void ImportAnimations(const char* filename);
 
-	void Draw(entity::ID transform_id);
+	/* Submits each mesh to the renderer at the given level of detail. */
+	/* If a camera is given, static models cull their meshlets against it and only submit the visible ranges. */
+	void Draw(entity::ID transform_id, int lod = 0, const UniformBufferCamera* camera = nullptr);
 
 	int numMeshes() { return (int)meshes.count; }
+	int numLods() { return (int)meshes.num_lods; }
+	const float* getLodScreenSizes() { return meshes.lod_screen_size; }
+
+	// Skinned models keep their float positions and bone weights, so they can be skinned on the CPU (see skinning.h).
+	int32_t numVertices() { return geom.num_vertices; }
+	const VertexPosition* getVertexPositions() { return geom.positions_ptr; }
+	const VertexSkin* getVertexSkin() { return geom.skin_ptr; }
+	/* Decodes every vertex's normal.  Leaves 'out' empty if the model has no surface data. */
+	void getVertexNormals(std::vector<vmath::vec3>& out);
+
+	vmath::vec3 getBoundsCenter() { return bounds_center; }
+	float getBoundsRadius() { return bounds_radius; }
 	void AssignMaterial(int mesh_id, const char* material_name);
 #endif
 
@@ -172,6 +232,14 @@ public:
 			return animations.anim_map[anim_name];
 	}
 
+	/* Returns which channel of the named clip animates each of this model's bones (-1 for none), */
+	/* or nullptr if the clip's channels already line up with this model's bones one for one. */
+	const int32_t* getAnimBoneRemap(const char* anim_name)
+	{
+		auto it = animations.anim_bone_remap.find(anim_name);
+		return (it != animations.anim_bone_remap.end()) ? it->second : nullptr;
+	}
+
 	struct Skeleton {
 
 		int32_t num_bones = 0;
@@ -228,6 +296,24 @@ private:
 	// Import Transform
 	vmath::mat4 import_transform = vmath::MAT4_IDENTITY;
 
+	// Bounding sphere around the model's vertices (in its bind pose, if it has a skeleton).
+	vmath::vec3 bounds_center = vmath::VEC3_ZERO;
+	float bounds_radius = 0.0f;
+	void CalcBounds();
+
+	// Repacks the geometry into the quantized vertex formats before it's sent to the graphics card.
+	// Positions are only packed if 'geom.quantize_positions' is set, and surfaces only if 'geom.octahedral_surfaces' is.
+	void CompressVertices();
+
+	// Quantizes the animation clips and frees their full-precision keys.
+	void CompressAnimations();
+
+	// Matches our bones to another skeleton's by name.  Leaves 'out' empty if they already match one for one.
+	void CalcBoneRemap(const Skeleton& source, std::vector<int32_t>& out);
+
+	// Looks up the IDs for every animation event, so they never have to be handled by name while playing.
+	void InternAnimationEvents();
+
 	// Geometry
 	struct Geom {
 
@@ -239,6 +325,17 @@ private:
 		VertexPosition* positions_ptr = nullptr;
 		VertexSurface* surface_ptr = nullptr;
 		VertexSkin* skin_ptr = nullptr;
+		VertexSurfaceOctahedral* surface_octahedral_ptr = nullptr;
+
+		// Positions are only quantized when the model asks for it, since each model is quantized against its own bounds.
+		// Modular pieces which have to meet up exactly should leave this off, so they don't end up on different grids.
+		bool quantize_positions = false;
+		// Octahedral surfaces only keep a coarse tangent direction, so they're left off unless the model asks for them too.
+		bool octahedral_surfaces = false;
+
+		// Used to scale quantized positions back up to their original size.
+		vmath::vec3 position_offset = vmath::VEC3_ZERO;
+		float position_scale = 1.0f;
 
 		int32_t num_indices = 0;
 		uint32_t index_size = 0;
@@ -264,10 +361,29 @@ private:
 		FixedString<32>* material_id = nullptr;
 		Material** material_ptr = nullptr;
 
+		// Simplified levels of detail are extra ranges in the same index buffer.
+		// 'start' and 'primcount' hold 'count' entries per level, so [(lod * count) + mesh] finds a mesh's range at a given level.
+		int32_t num_lods = 1;
+		float lod_screen_size[lod::MAX_LEVELS] = { 1.0f, 0.0f, 0.0f, 0.0f };
+
 		static constexpr size_t meshsize = sizeof(int32_t) + sizeof(int32_t) + sizeof(FixedString<32>) + sizeof(Material*);
+		static constexpr size_t lodsize = sizeof(int32_t) + sizeof(int32_t);
 
 	} meshes;
 
+	// Meshlets; runs of triangles within each full-detail mesh which can be culled individually.
+	// Meshlets are stored mesh by mesh, so each mesh's meshlets are 'mesh_count[mesh]' entries starting at 'mesh_first[mesh]'.
+	struct Meshlets {
+
+		int32_t count = 0;
+		Meshlet* meshlet = nullptr;
+		int32_t* mesh_first = nullptr;
+		int32_t* mesh_count = nullptr;
+
+		static constexpr size_t permeshsize = sizeof(int32_t) + sizeof(int32_t);
+
+	} meshlets;
+
 	// Skeleton
 	Skeleton skeleton;
 
@@ -283,6 +399,13 @@ private:
 		std::unordered_map<FixedString<32>, AnimationClip*> anim_map;
 		std::map<FixedString<32>, Model*> imports;
 
+		// For each imported file, which of its bones (and so which channel of its clips) animates each of our bones.
+		// These are worked out once when the file is imported, and left empty if both skeletons match bone for bone.
+		std::map<FixedString<32>, std::vector<int32_t>> import_bone_remaps;
+
+		// Which of those remaps each imported clip in 'anim_map' plays through.
+		std::unordered_map<FixedString<32>, const int32_t*> anim_bone_remap;
+
 	} animations;
 
 	// Ragdoll
@@ -5,6 +5,8 @@ using namespace std;
 #include <fbxsdk.h>
 
 #include "sys/printlog.h"
+#include "mesh_optimizer.h"
+#include "lod.h"
 
 using namespace vmath;
 
@@ -124,8 +126,90 @@ struct MeshGeometry
 	int start;
 	int count;
 	bool has_skinning;
+
+	// Simplified index lists for levels of detail past the first, using the same vertices.
+	vector<vector<int>> lods;
+	int vertex_base;
+
+	// Cullable runs of triangles within the full-detail index list.
+	vector<Meshlet> meshlets;
 };
 
+// Reorders a mesh's triangles for the post-transform vertex cache and for overdraw,
+// then reorders its vertices to match the order the triangles fetch them in.
+void OptimizeMeshGeometry(MeshGeometry& mesh)
+{
+	if (mesh.indices.size() == 0)
+		{ return; }
+
+	meshopt::CacheStatistics before = meshopt::SimulateVertexCache(mesh.indices.data(), mesh.indices.size(), mesh.vertices.size());
+
+	meshopt::OptimizeVertexCache(mesh.indices.data(), mesh.indices.size(), mesh.vertices.size());
+	meshopt::OptimizeOverdraw(mesh.indices.data(), mesh.indices.size(), &mesh.vertices[0].position.x, mesh.vertices.size(), sizeof(PackedVertexInformation));
+
+	vector<int> remap;
+	size_t used_vertices = meshopt::OptimizeVertexFetch(remap, mesh.indices.data(), mesh.indices.size(), mesh.vertices.size());
+	meshopt::RemapVertices(mesh.vertices, remap, used_vertices);
+
+	meshopt::CacheStatistics after = meshopt::SimulateVertexCache(mesh.indices.data(), mesh.indices.size(), mesh.vertices.size());
+
+	plog::info("Optimized mesh '%s' (%u vertices, %u triangles).\n", mesh.material.c_str(), after.vertices_referenced, after.triangles);
+	plog::infomore("ACMR: %.3f -> %.3f\n", before.acmr, after.acmr);
+	plog::infomore("ATVR: %.3f -> %.3f\n", before.atvr, after.atvr);
+}
+
+// How much each level of detail tries to reduce the triangle count, relative to the full-detail mesh,
+// and how much error (relative to the size of the mesh) it's allowed to introduce to get there.
+constexpr const float LOD_TARGET_RATIO[lod::MAX_LEVELS] = { 1.0f, 0.5f, 0.25f, 0.125f };
+constexpr const float LOD_TARGET_ERROR[lod::MAX_LEVELS] = { 0.0f, 0.01f, 0.03f, 0.08f };
+
+// A level of detail which doesn't remove at least this fraction of the previous level's triangles isn't worth keeping.
+constexpr const float LOD_MIN_REDUCTION = 0.15f;
+
+// Generates simplified index lists for a mesh whose vertices have already been optimized.
+void GenerateMeshLods(MeshGeometry& mesh)
+{
+	mesh.lods.clear();
+	if (mesh.indices.size() == 0)
+		{ return; }
+
+	size_t prev_count = mesh.indices.size();
+
+	for (int level = 1; level < lod::MAX_LEVELS; ++level)
+	{
+		size_t target_count = ((size_t)(mesh.indices.size() * LOD_TARGET_RATIO[level]) / 3) * 3;
+
+		vector<int> lod_indices;
+		float error = 0.0f;
+		size_t count = meshopt::SimplifyMesh(lod_indices, mesh.indices.data(), mesh.indices.size(),
+			&mesh.vertices[0].position.x, mesh.vertices.size(), sizeof(PackedVertexInformation),
+			target_count, LOD_TARGET_ERROR[level], &error);
+
+		if (count == 0 || (float)count > (float)prev_count * (1.0f - LOD_MIN_REDUCTION))
+			break;
+
+		meshopt::OptimizeVertexCache(lod_indices.data(), lod_indices.size(), mesh.vertices.size());
+		plog::infomore("LOD %i: %u triangles (error %.4f).\n", level, (unsigned)(count / 3), error);
+
+		mesh.lods.push_back(lod_indices);
+		prev_count = count;
+	}
+}
+
+// Splits a mesh's full-detail triangles into meshlets for culling.
+// Skinned meshes move too far from their bind pose for the bounds to hold, so they don't get any.
+void GenerateMeshlets(MeshGeometry& mesh)
+{
+	mesh.meshlets.clear();
+	if (mesh.indices.size() == 0 || mesh.has_skinning)
+		{ return; }
+
+	meshopt::BuildMeshlets(mesh.meshlets, mesh.indices.data(), mesh.indices.size(),
+		&mesh.vertices[0].position.x, mesh.vertices.size(), sizeof(PackedVertexInformation));
+
+	plog::infomore("Split into %u meshlets.\n", (unsigned)mesh.meshlets.size());
+}
+
 struct AnimationKey
 {
 	float timestamp;
@@ -134,27 +218,6 @@ struct AnimationKey
 	vec3 scale;
 };
 
-// Determines whether or not "mid_val" is a linear interpolation between start_val and end_val according to the indicated times.
-// This is used to remove redundant keyframes.
-template <typename T>
-bool isLerp(float start_time, float mid_time, float end_time, T start_val, T mid_val, T end_val)
-{
-	// Move t0 to 0 and adjust other times accordingly.
-	end_time -= start_time;
-	mid_time -= start_time;
-	start_time = 0.0f;
-
-	// Move t2 to 1 and adjust t1 accordingly.
-	float timescale = 1 / end_time;
-	mid_time *= timescale;
-	end_time *= timescale;
-
-	// Right now, start_time should be 0, end_time should be 1, and mid_time should be somewhere in between.
-	// We can now use mid_time to calculate a mid_val and compare it to the actual mid_val.
-	T calculated_mid = T::lerp(start_val, end_val, mid_time);
-	return T::close_enough(mid_val, calculated_mid);
-}
-
 struct AnimChannelInformation
 {
 	string bone_name;
@@ -356,8 +419,6 @@ bool Model::LoadFBX(const char* filename, const char* password)
 		}
 	}
 
-	// This is where we'd like to do post-load processing, such as vertex cache optimization.
-
 	// Here we assemble the vertices and indices from each mesh together.
 	vector<PackedVertexInformation> vertices;
 	vector<int> indices;
@@ -367,10 +428,16 @@ bool Model::LoadFBX(const char* filename, const char* password)
 	for (size_t i = 0; i < geom.size(); ++i)
 	{
 		RemoveDuplicateVertices(geom[i].vertices, geom[i].indices, 0);
+		OptimizeMeshGeometry(geom[i]);
+		GenerateMeshLods(geom[i]);
+		GenerateMeshlets(geom[i]);
 		vertices.insert(vertices.end(), geom[i].vertices.begin(), geom[i].vertices.end());
 		for (auto& index : geom[i].indices) { index += running_index; }
 		indices.insert(indices.end(), geom[i].indices.begin(), geom[i].indices.end());
 		geom[i].start = running_count;
+		geom[i].vertex_base = running_index;
+		for (Meshlet& meshlet : geom[i].meshlets)
+			{ meshlet.start += running_count; }
 
 		running_index += (int)geom[i].vertices.size();
 		running_count += geom[i].count;
@@ -379,6 +446,40 @@ bool Model::LoadFBX(const char* filename, const char* password)
 			has_skinning = true;
 	}
 
+	// The simplified levels of detail go after every full-detail mesh, one level at a time.
+	// Meshes which ran out of levels early just keep using the last one they have.
+	int num_lods = 1;
+	for (size_t i = 0; i < geom.size(); ++i)
+		{ num_lods = max(num_lods, 1 + (int)geom[i].lods.size()); }
+
+	vector<int> lod_start(geom.size() * num_lods);
+	vector<int> lod_count(geom.size() * num_lods);
+	for (int level = 0; level < num_lods; ++level)
+	{
+		for (size_t i = 0; i < geom.size(); ++i)
+		{
+			size_t slot = (level * geom.size()) + i;
+			if (level == 0)
+			{
+				lod_start[slot] = geom[i].start;
+				lod_count[slot] = geom[i].count;
+			}
+			else if (level > (int)geom[i].lods.size())
+			{
+				lod_start[slot] = lod_start[slot - geom.size()];
+				lod_count[slot] = lod_count[slot - geom.size()];
+			}
+			else
+			{
+				const vector<int>& lod_indices = geom[i].lods[level - 1];
+				lod_start[slot] = (int)indices.size();
+				lod_count[slot] = (int)lod_indices.size();
+				for (int index : lod_indices)
+					{ indices.push_back(index + geom[i].vertex_base); }
+			}
+		}
+	}
+
 	// Arrange the data in our vertex buffer format
 	this->geom.vertex_format = VF_POSITION | VF_SURFACE;
 	if (has_skinning) this->geom.vertex_format |= VF_SKIN;
@@ -450,6 +551,16 @@ bool Model::LoadFBX(const char* filename, const char* password)
 	persistant_buffer_size = 0;
 
 	persistant_buffer_size += (uint32_t)(this->meshes.meshsize * geom.size());
+	persistant_buffer_size += (uint32_t)(this->meshes.lodsize * geom.size() * (num_lods - 1));
+
+	int32_t num_meshlets = 0;
+	for (size_t i = 0; i < geom.size(); ++i)
+		{ num_meshlets += (int32_t)geom[i].meshlets.size(); }
+	if (num_meshlets > 0)
+	{
+		persistant_buffer_size += (uint32_t)(sizeof(Meshlet) * num_meshlets);
+		persistant_buffer_size += (uint32_t)(this->meshlets.permeshsize * geom.size());
+	}
 
 	persistant_buffer_size += (uint32_t)(this->skeleton.bonesize * boneinfo.size());
 
@@ -473,19 +584,42 @@ bool Model::LoadFBX(const char* filename, const char* password)
 	// Get our pointers from within the persistant buffer.
 	{
 		meshes.count = (int32_t)geom.size();
-		meshes.start = (int32_t*)running_ptr; running_ptr = (void*)(meshes.start + meshes.count);
-		meshes.primcount = (int32_t*)running_ptr; running_ptr = (void*)(meshes.primcount + meshes.count);
+		meshes.num_lods = num_lods;
+		meshes.start = (int32_t*)running_ptr; running_ptr = (void*)(meshes.start + (meshes.count * meshes.num_lods));
+		meshes.primcount = (int32_t*)running_ptr; running_ptr = (void*)(meshes.primcount + (meshes.count * meshes.num_lods));
 		meshes.material_id = (FixedString<32>*)running_ptr; running_ptr = (void*)(meshes.material_id + meshes.count);
 		meshes.material_ptr = (Material**)running_ptr; running_ptr = (void*)(meshes.material_ptr + meshes.count);
 
 		// Get the per-mesh information
 		for (size_t i = 0; i < meshes.count; ++i)
 		{
-			meshes.start[i] = geom[i].start;
-			meshes.primcount[i] = geom[i].count;
 			meshes.material_id[i] = geom[i].material.c_str();
 			meshes.material_ptr[i] = nullptr;
 		}
+		for (size_t i = 0; i < lod_start.size(); ++i)
+		{
+			meshes.start[i] = lod_start[i];
+			meshes.primcount[i] = lod_count[i];
+		}
+		for (int level = 0; level < lod::MAX_LEVELS; ++level)
+			{ meshes.lod_screen_size[level] = lod::DEFAULT_SCREEN_SIZE[level]; }
+
+		meshlets.count = num_meshlets;
+		if (meshlets.count > 0)
+		{
+			meshlets.meshlet = (Meshlet*)running_ptr; running_ptr = (void*)(meshlets.meshlet + meshlets.count);
+			meshlets.mesh_first = (int32_t*)running_ptr; running_ptr = (void*)(meshlets.mesh_first + meshes.count);
+			meshlets.mesh_count = (int32_t*)running_ptr; running_ptr = (void*)(meshlets.mesh_count + meshes.count);
+
+			int32_t current_meshlet = 0;
+			for (size_t i = 0; i < meshes.count; ++i)
+			{
+				meshlets.mesh_first[i] = current_meshlet;
+				meshlets.mesh_count[i] = (int32_t)geom[i].meshlets.size();
+				for (const Meshlet& meshlet : geom[i].meshlets)
+					{ meshlets.meshlet[current_meshlet++] = meshlet; }
+			}
+		}
 
 		skeleton.num_bones = (int32_t)boneinfo.size();
 		if (skeleton.num_bones > 0)
@@ -733,6 +867,33 @@ bool Model::LoadFBX(const char* filename, const char* password)
 	return true;
 }
 
+void Model::ReduceAnimations(bool report)
+{
+	for (int32_t i = 0; i < animations.count; ++i)
+	{
+		AnimationClip& clip = animations.clip[i];
+		if (!report)
+		{
+			ReduceAnimationKeys(clip, skeleton.parent_index, skeleton.to_parent, skeleton.num_bones);
+			continue;
+		}
+
+		// Keep the original around so the result can be measured against it.
+		AnimationClip original = clip;
+		ReduceAnimationKeys(clip, skeleton.parent_index, skeleton.to_parent, skeleton.num_bones);
+
+		AnimationClip compressed = clip;
+		CompressAnimationClip(compressed.compressed, compressed);
+
+		size_t original_size = GetAnimationMemoryUsage(original);
+		size_t compressed_size = GetAnimationMemoryUsage(compressed);
+		float error = MeasureEndEffectorError(original, compressed, skeleton.parent_index, skeleton.to_parent, skeleton.num_bones);
+		plog::info("Animation '%s': %i bytes -> %i bytes (%.2f:1), max end effector error %f.\n",
+			clip.name.c_str, (int)original_size, (int)compressed_size,
+			(compressed_size > 0) ? (float)original_size / (float)compressed_size : 0.0f, error);
+	}
+}
+
 void LoadFbxSkeleton(FbxNode* node, vector<BoneInfo>& skeleton, unordered_map<FixedString<32>, int32_t>& bone_map, int parent_index)
 {
 	int my_index = -1;
@@ -1089,10 +1250,17 @@ void LoadFbxMesh(FbxNode* node, vector<MeshGeometry>& geom, vector<BoneInfo>& sk
 				// Skinning information
 				if (meshinfo.has_skinning)
 				{
+					// Quantize the weights together so they still add up to exactly 1.0 (255).
+					VertexSkin skin;
+					float weights[4];
+					for (int i = 0; i < 4; ++i)
+						{ weights[i] = vertex_bone_weights[ctrlpoint].list[i].weight; }
+					skin.set_weights(weights);
+
 					for (int i = 0; i < 4; ++i)
 					{
 						pvert.bone[i] = (uint8_t)vertex_bone_weights[ctrlpoint].list[i].index;
-						pvert.weight[i] = (uint8_t)(vertex_bone_weights[ctrlpoint].list[i].weight * (float)UCHAR_MAX);
+						pvert.weight[i] = skin.weight[i];
 					}
 				}
 
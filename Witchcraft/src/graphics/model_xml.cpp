@@ -3,10 +3,12 @@
 using namespace pugi;
 
 #include <sstream>
+#include <iomanip>
+#include <limits>
 using namespace std;
 using namespace vmath;
 
-const char* Model::LoadXML(istream& file)
+const char* Model::LoadXML(istream& file, bool animations_only)
 {
 	Clear();
 
@@ -25,8 +27,9 @@ const char* Model::LoadXML(istream& file)
 	if (!root)
 		{ return "Could not find 'model' root node."; }
 
+	// An animation library only needs its skeleton and clips, so geometry, meshes, and physics are never read.
 	// Geometry section
-	xml_node geometry_node = root.child("geometry");
+	xml_node geometry_node = animations_only ? xml_node() : root.child("geometry");
 	if (geometry_node)
 	{
 		// Number of vertices in the model
@@ -34,6 +37,8 @@ const char* Model::LoadXML(istream& file)
 		if (!numvertices_node)
 			{ return "Model geometry does not have a 'num_vertices' node."; }
 		geom.num_vertices = numvertices_node.text().as_uint();
+		geom.quantize_positions = geometry_node.attribute("quantize_positions").as_bool(false);
+		geom.octahedral_surfaces = geometry_node.attribute("octahedral_surfaces").as_bool(false);
 
 		// Number of triangles (and therefore indices) in the model
 		xml_node numtriangles_node = geometry_node.child("num_indices");
@@ -325,9 +330,9 @@ const char* Model::LoadXML(istream& file)
 	}
 
 	// We have to determine the size of the persistant buffer.
-	xml_node meshes_node = root.child("meshes");
+	xml_node meshes_node = animations_only ? xml_node() : root.child("meshes");
 	xml_node skeleton_node = root.child("skeleton");
-	xml_node collision_node = root.child("physics");
+	xml_node collision_node = animations_only ? xml_node() : root.child("physics");
 	xml_node animations_node = root.child("animations");
 
 	if (meshes_node)
@@ -339,7 +344,28 @@ const char* Model::LoadXML(istream& file)
 		if (meshes.count <= 0)
 			{ return "Model must have at least one mesh."; }
 
+		xml_node num_lods_node = meshes_node.child("num_lods");
+		if (num_lods_node)
+		{
+			meshes.num_lods = num_lods_node.text().as_int();
+			if (meshes.num_lods < 1 || meshes.num_lods > lod::MAX_LEVELS)
+				{ return "Model has an invalid number of levels of detail."; }
+		}
+
 		persistant_buffer_size += meshes.meshsize * meshes.count;
+		persistant_buffer_size += meshes.lodsize * meshes.count * (meshes.num_lods - 1);
+
+		for (xml_node mesh_node = meshes_node.child("mesh"); mesh_node; mesh_node = mesh_node.next_sibling("mesh"))
+		{
+			xml_node meshlets_node = mesh_node.child("meshlets");
+			if (meshlets_node)
+				{ meshlets.count += meshlets_node.attribute("count").as_int(); }
+		}
+		if (meshlets.count > 0)
+		{
+			persistant_buffer_size += sizeof(Meshlet) * meshlets.count;
+			persistant_buffer_size += meshlets.permeshsize * meshes.count;
+		}
 	}
 
 	if (skeleton_node)
@@ -475,7 +501,7 @@ const char* Model::LoadXML(istream& file)
 
 			skeleton.collider_flags[bone_index] = 0;
 
-			xml_node bone_collider_node = bone_node.child("collider");
+			xml_node bone_collider_node = animations_only ? xml_node() : bone_node.child("collider");
 			if (bone_collider_node)
 			{
 				SimpleShapeCollider collider;
@@ -555,11 +581,34 @@ const char* Model::LoadXML(istream& file)
 	if (meshes_node)
 	{
 		meshes.start = (int32_t*)running_ptr;
-		meshes.primcount = (int32_t*)(meshes.start + meshes.count);
-		meshes.material_id = (FixedString<32>*)(meshes.primcount + meshes.count);
+		meshes.primcount = (int32_t*)(meshes.start + (meshes.count * meshes.num_lods));
+		meshes.material_id = (FixedString<32>*)(meshes.primcount + (meshes.count * meshes.num_lods));
 		meshes.material_ptr = (Material * *)(meshes.material_id + meshes.count);
 		running_ptr = (void*)(meshes.material_ptr + meshes.count);
 
+		if (meshlets.count > 0)
+		{
+			meshlets.meshlet = (Meshlet*)running_ptr;
+			meshlets.mesh_first = (int32_t*)(meshlets.meshlet + meshlets.count);
+			meshlets.mesh_count = (int32_t*)(meshlets.mesh_first + meshes.count);
+			running_ptr = (void*)(meshlets.mesh_count + meshes.count);
+
+			for (int32_t i = 0; i < meshes.count; ++i)
+				{ meshlets.mesh_first[i] = 0; meshlets.mesh_count[i] = 0; }
+		}
+		int32_t current_meshlet = 0;
+
+		for (int level = 0; level < lod::MAX_LEVELS; ++level)
+			{ meshes.lod_screen_size[level] = lod::DEFAULT_SCREEN_SIZE[level]; }
+
+		xml_node screen_sizes_node = meshes_node.child("lod_screen_sizes");
+		if (screen_sizes_node)
+		{
+			ss.clear(); ss.str(screen_sizes_node.text().as_string());
+			for (int level = 0; level < meshes.num_lods; ++level)
+				{ ss >> meshes.lod_screen_size[level]; }
+		}
+
 		for (xml_node mesh_node = meshes_node.child("mesh"); mesh_node; mesh_node = mesh_node.next_sibling("mesh"))
 		{
 			uint32_t index = mesh_node.attribute("index").as_uint();
@@ -579,6 +628,47 @@ const char* Model::LoadXML(istream& file)
 				meshes.primcount[index] = countnode.text().as_int();
 			}
 
+			// Levels of detail which aren't listed fall back to the level before them.
+			for (int level = 1; level < meshes.num_lods; ++level)
+			{
+				size_t slot = (level * meshes.count) + index;
+				meshes.start[slot] = meshes.start[slot - meshes.count];
+				meshes.primcount[slot] = meshes.primcount[slot - meshes.count];
+			}
+			for (xml_node lod_node = mesh_node.child("lod"); lod_node; lod_node = lod_node.next_sibling("lod"))
+			{
+				int level = lod_node.attribute("level").as_int();
+				if (level < 1 || level >= meshes.num_lods)
+					{ return "Mesh level of detail is out of bounds."; }
+
+				for (int next = level; next < meshes.num_lods; ++next)
+				{
+					size_t slot = (next * meshes.count) + index;
+					meshes.start[slot] = lod_node.child("start").text().as_int();
+					meshes.primcount[slot] = lod_node.child("count").text().as_int();
+				}
+			}
+
+			// Each meshlet is written as "start count center.x center.y center.z radius axis.x axis.y axis.z cutoff".
+			xml_node meshlets_node = mesh_node.child("meshlets");
+			if (meshlets_node)
+			{
+				int32_t count = meshlets_node.attribute("count").as_int();
+				meshlets.mesh_first[index] = current_meshlet;
+				meshlets.mesh_count[index] = count;
+
+				ss.clear(); ss.str(meshlets_node.text().as_string());
+				for (int32_t i = 0; i < count; ++i)
+				{
+					Meshlet& meshlet = meshlets.meshlet[current_meshlet++];
+					ss >> meshlet.start >> meshlet.count;
+					ss >> meshlet.center.x >> meshlet.center.y >> meshlet.center.z >> meshlet.radius;
+					ss >> meshlet.cone_axis.x >> meshlet.cone_axis.y >> meshlet.cone_axis.z >> meshlet.cone_cutoff;
+				}
+				if (ss.fail())
+					{ return "Mesh has fewer meshlets than it claims."; }
+			}
+
 			xml_node bonenode = mesh_node.child("bone_attach");
 			if (bonenode && geom.skin_ptr)
 			{
@@ -808,6 +898,11 @@ const char* Model::SaveXML(ostream& file)
 
 	xml_node geometry_node = root.append_child("geometry");
 	{
+		if (geom.quantize_positions)
+			{ geometry_node.append_attribute("quantize_positions").set_value(true); }
+		if (geom.octahedral_surfaces)
+			{ geometry_node.append_attribute("octahedral_surfaces").set_value(true); }
+
 		ss.clear(); ss.str("");
 		ss << geom.num_vertices;
 		geometry_node.append_child("num_vertices").text() = ss.str().c_str();
@@ -907,6 +1002,17 @@ const char* Model::SaveXML(ostream& file)
 		ss.clear(); ss.str(""); ss << meshes.count;
 		meshes_node.append_child("num_meshes").text() = ss.str().c_str();
 
+		if (meshes.num_lods > 1)
+		{
+			ss.clear(); ss.str(""); ss << meshes.num_lods;
+			meshes_node.append_child("num_lods").text() = ss.str().c_str();
+
+			ss.clear(); ss.str("");
+			for (int level = 0; level < meshes.num_lods; ++level)
+				{ ss << meshes.lod_screen_size[level] << ' '; }
+			meshes_node.append_child("lod_screen_sizes").text() = ss.str().c_str();
+		}
+
 		for (int32_t i = 0; i < meshes.count; ++i)
 		{
 			xml_node mesh_node = meshes_node.append_child("mesh");
@@ -917,6 +1023,37 @@ const char* Model::SaveXML(ostream& file)
 			mesh_node.append_child("start").text() = ss.str().c_str();
 			ss.clear(); ss.str(""); ss << meshes.primcount[i];
 			mesh_node.append_child("count").text() = ss.str().c_str();
+
+			for (int level = 1; level < meshes.num_lods; ++level)
+			{
+				size_t slot = (level * meshes.count) + i;
+				xml_node lod_node = mesh_node.append_child("lod");
+				lod_node.append_attribute("level").set_value(level);
+				ss.clear(); ss.str(""); ss << meshes.start[slot];
+				lod_node.append_child("start").text() = ss.str().c_str();
+				ss.clear(); ss.str(""); ss << meshes.primcount[slot];
+				lod_node.append_child("count").text() = ss.str().c_str();
+			}
+
+			if (meshlets.count > 0 && meshlets.mesh_count[i] > 0)
+			{
+				xml_node meshlets_node = mesh_node.append_child("meshlets");
+				meshlets_node.append_attribute("count").set_value(meshlets.mesh_count[i]);
+
+				// The bounds are written at full precision, since culling against a sphere or cone which has been rounded down
+				// would drop clusters which are actually visible.
+				streamsize old_precision = ss.precision();
+				ss.clear(); ss.str(""); ss << setprecision(numeric_limits<float>::max_digits10);
+				for (int32_t j = 0; j < meshlets.mesh_count[i]; ++j)
+				{
+					const Meshlet& meshlet = meshlets.meshlet[meshlets.mesh_first[i] + j];
+					ss << meshlet.start << ' ' << meshlet.count << ' ';
+					ss << meshlet.center.x << ' ' << meshlet.center.y << ' ' << meshlet.center.z << ' ' << meshlet.radius << ' ';
+					ss << meshlet.cone_axis.x << ' ' << meshlet.cone_axis.y << ' ' << meshlet.cone_axis.z << ' ' << meshlet.cone_cutoff << '\n';
+				}
+				meshlets_node.text() = ss.str().c_str();
+				ss << setprecision(old_precision);
+			}
 		}
 	}
 
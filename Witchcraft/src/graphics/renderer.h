@@ -33,7 +33,16 @@ namespace renderer
 
 	void InitLua();
 
-	void SubmitRenderable(entity::ID transformid, Geometry* geom, Material* mat, int start = 0, int count = 0);
+	// Which passes a submitted range is drawn in.
+	// Ranges culled against the main camera should only be drawn in the main view, since the light can still see what the camera can't.
+	enum SubmitPassEnum
+	{
+		SUBMIT_ALL = 0,
+		SUBMIT_MAIN_VIEW,
+		SUBMIT_SHADOW
+	};
+
+	void SubmitRenderable(entity::ID transformid, Geometry* geom, Material* mat, int start = 0, int count = 0, SubmitPassEnum passes = SUBMIT_ALL);
 
 	void DrawShadows(const UniformBufferCamera& cam);
 
@@ -41,6 +50,7 @@ namespace renderer
 	struct RenderQueueEntry
 	{
 		entity::ID transformid;
+		entity::transform::Index transform; // Resolved when the entry is queued, so drawing it doesn't have to look the entity up again.
 		Geometry* geom;
 		Material* mat;
 		int start, count;
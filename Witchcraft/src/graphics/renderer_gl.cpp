@@ -140,7 +140,6 @@ void DrawFrame(float interpolation)
 	// Calculate transform matrices.
 	entity::transform::CalcMatrices(interpolation);
 	scene::getRenderableComponent().ApplyImportTransforms();
-	scene::getAnimatorComponent().DisplayUpdate(interpolation);
 
 	// Get the size of the window and account for it changing.
 	int w, h;
@@ -158,7 +157,14 @@ void DrawFrame(float interpolation)
 	camera.aspect_ratio = (float)screen_width / (float)screen_height;
 	camera.frame_interpolation = interpolation;
 
-	if (entity::transform::has(camera_entity))
+	if (entity::transform::getParent(camera_entity) != 0)
+	{
+		// A camera following something else only knows where it is in the world from its matrix.
+		mat4 world = entity::transform::getMatrix(camera_entity);
+		camera.view = (world * mat4::rotation(quat::euler(TO_RADIANS*-90, 0, 0))).inverted();
+		camera.eye_pos = vec4(world.extract_position(), 0.0f);
+	}
+	else if (entity::transform::has(camera_entity))
 	{
 		camera.view = mat4::rotation(-entity::transform::interpolateRot(camera_entity, interpolation) * quat::euler(TO_RADIANS*-90, 0, 0)) *
 					  mat4::translation(-entity::transform::interpolatePos(camera_entity, interpolation));
@@ -179,6 +185,9 @@ void DrawFrame(float interpolation)
 
 	Shader::UploadUniformBuffer(camera_buffer_loc, sizeof(UniformBufferCamera), &camera);
 
+	// Animations need the camera to know which entities are visible and how detailed they need to be.
+	scene::getAnimatorComponent().DisplayUpdate(interpolation, &camera);
+
 	// Clear the frmebuffer so we can draw to it.
 	glClear(GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
 
@@ -186,7 +195,7 @@ void DrawFrame(float interpolation)
 	pipelines.ClearAll();
 
 	// Populate the rendering lists
-	scene::getRenderableComponent().DrawEverything();
+	scene::getRenderableComponent().DrawEverything(camera);
 
 	// Do directional lighting
 //	glCullFace(GL_FRONT);
@@ -248,29 +257,41 @@ void setGuiLayer(GuiLayer* newguilayer)
 
 void LoadSkybox(const char* name) { skybox->Load(name); }
 
-void SubmitRenderable(entity::ID transformid, Geometry* geom, Material* mat, int start, int count)
+void SubmitRenderable(entity::ID transformid, Geometry* geom, Material* mat, int start, int count, SubmitPassEnum passes)
 {
-	if (!entity::transform::has(transformid) || !geom || !mat)
+	entity::transform::Index transform = entity::transform::resolve(transformid);
+	if (!transform.valid() || !geom || !mat)
 		{ plog::error("Objects require a valid transform id, geometry, and material to be drawn.\n"); return; }
 
+	bool main_view = (passes != SUBMIT_SHADOW);
+	bool shadow = (passes != SUBMIT_MAIN_VIEW);
+	bool skinned = scene::getAnimatorComponent().hasEntry(transformid);
+
 	if (mat->flags() & MATERIAL_FLAG_TRANSPARENT)
 	{
-		if (scene::getAnimatorComponent().hasEntry(transformid))
-			{ pipelines.transparent_skinned.queue.push_back({ transformid, geom, mat, start, count }); }
+		if (!main_view)
+			return;
+
+		if (skinned)
+			{ pipelines.transparent_skinned.queue.push_back({ transformid, transform, geom, mat, start, count }); }
 		else
-			{ pipelines.transparent_static.queue.push_back({ transformid, geom, mat, start, count }); }
+			{ pipelines.transparent_static.queue.push_back({ transformid, transform, geom, mat, start, count }); }
 	}
 	else
 	{
-		if (scene::getAnimatorComponent().hasEntry(transformid))
+		if (skinned)
 		{
-			pipelines.opaque_skinned.queue.push_back({ transformid, geom, mat, start, count });
-			pipelines.shadow_skinned.queue.push_back({ transformid, geom, mat, start, count });
+			if (main_view)
+				{ pipelines.opaque_skinned.queue.push_back({ transformid, transform, geom, mat, start, count }); }
+			if (shadow)
+				{ pipelines.shadow_skinned.queue.push_back({ transformid, transform, geom, mat, start, count }); }
 		}
 		else
 		{
-			pipelines.opaque_static.queue.push_back({ transformid, geom, mat, start, count });
-			pipelines.shadow_static.queue.push_back({ transformid, geom, mat, start, count });
+			if (main_view)
+				{ pipelines.opaque_static.queue.push_back({ transformid, transform, geom, mat, start, count }); }
+			if (shadow)
+				{ pipelines.shadow_static.queue.push_back({ transformid, transform, geom, mat, start, count }); }
 		}
 	}
 }
@@ -284,7 +305,7 @@ void DrawShadows(const UniformBufferCamera& cam)
 	{
 		RenderQueueEntry& item = pipelines.shadow_static.queue[i];
 
-		mat4 matrix = entity::transform::getMatrix(item.transformid);
+		mat4 matrix = item.geom->applyDequantization(entity::transform::getMatrix(item.transform));
 		mat4 mvp = cam.projview * matrix;
 
 		pipelines.shadow_static.shader->setUniform(0, mvp);
@@ -300,7 +321,7 @@ void DrawShadows(const UniformBufferCamera& cam)
 	{
 		RenderQueueEntry& item = pipelines.shadow_skinned.queue[i];
 
-		mat4 matrix = entity::transform::getMatrix(item.transformid);
+		mat4 matrix = entity::transform::getMatrix(item.transform);
 		mat4 mvp = cam.projview * matrix;
 
 		scene::getAnimatorComponent().UploadSkeleton(item.transformid);
@@ -327,11 +348,12 @@ void DrawQueue(Pipeline& pipeline, const UniformBufferCamera& cam)
 
 		// TODO: Set up point lights for this object.
 
-		mat4 matrix = entity::transform::getMatrix(item.transformid);
+		mat4 matrix = item.geom->applyDequantization(entity::transform::getMatrix(item.transform));
 		mat4 mvp = cam.projview * matrix;
 
 		pipeline.shader->setUniform(UNIFORM_MATRIX_TRANSFORM, matrix);
 		pipeline.shader->setUniform(UNIFORM_MATRIX_MVP, mvp);
+		pipeline.shader->setUniform(UNIFORM_OCTAHEDRAL_SURFACE, (item.geom->getVertexFormat() & VF_SURFACE_OCTAHEDRAL) ? 1 : 0);
 
 		// Finally draw the item.
 		item.geom->Draw(item.start, item.count);
@@ -8,6 +8,7 @@ R"==(
 
 uniform mat4 mvp;
 uniform mat4 transform;
+uniform bool octahedral_surface;
 
 layout (location = 0) in vec3 in_position;
 layout (location = 1) in vec2 in_texcoord;
@@ -16,6 +17,39 @@ layout (location = 3) in vec4 in_tangent;
 
 #include inc/skeletal_animation.glsl
 
+// Octahedral surfaces pack the normal into in_normal.xy, the shading into in_normal.z,
+// and the tangent's angle around the normal into in_normal.w, with the bitangent sign as its sign.
+vec3 surface_normal;
+vec4 surface_tangent;
+float surface_shading;
+void UnpackSurface()
+{
+	if (!octahedral_surface)
+	{
+		surface_normal = in_normal.xyz;
+		surface_tangent = in_tangent;
+		surface_shading = in_normal.w;
+		return;
+	}
+
+	vec3 n = vec3(in_normal.xy, 1.0 - abs(in_normal.x) - abs(in_normal.y));
+	if (n.z < 0)
+		{ n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0 ? 1.0 : -1.0, n.y >= 0 ? 1.0 : -1.0); }
+	n = normalize(n);
+
+	// This basis must match the one in vertex.cpp.
+	float s = n.z >= 0 ? 1.0 : -1.0;
+	float a = -1.0 / (s + n.z);
+	float b = n.x * n.y * a;
+	vec3 b1 = vec3(1.0 + s * n.x * n.x * a, s * b, -s * n.x);
+	vec3 b2 = vec3(b, s + n.y * n.y * a, -n.y);
+	float angle = (round(abs(in_normal.w) * 127.0) - 1.0) * (6.28318530718 / 127.0);
+
+	surface_normal = n;
+	surface_tangent = vec4((b1 * cos(angle)) + (b2 * sin(angle)), in_normal.w < 0 ? -1.0 : 1.0);
+	surface_shading = in_normal.z;
+}
+
 out vec3 vert_normal;
 #ifdef TEX_NORMAL
 out vec3 vert_tangent;
@@ -26,17 +60,19 @@ out float vert_color;
 
 void main()
 {
+	UnpackSurface();
+
 #ifdef SKELETAL_ANIMATION
 	
 	vec3 skinned_pos = ApplyBoneTransform(vec4(in_position.xyz, 1)).xyz;
 	gl_Position = mvp * vec4(skinned_pos, 1);
-	vec3 skinned_nrm = ApplyBoneTransform(vec4(in_normal.xyz, 0)).xyz;
+	vec3 skinned_nrm = ApplyBoneTransform(vec4(surface_normal, 0)).xyz;
 	vert_normal = (transform * vec4(skinned_nrm, 0)).xyz;
 
 	#ifdef TEX_NORMAL
-		vec3 skinned_tan = ApplyBoneTransform(vec4(in_tangent.xyz, 0)).xyz;
+		vec3 skinned_tan = ApplyBoneTransform(vec4(surface_tangent.xyz, 0)).xyz;
 		vert_tangent = (transform * vec4(skinned_tan, 0)).xyz;
-		vert_bitangent = cross(vert_normal, vert_tangent) * in_tangent.w;
+		vert_bitangent = cross(vert_normal, vert_tangent) * surface_tangent.w;
 	#endif // TEX_NORMAL
 		
 	CalcVertexLightVals(transform, skinned_pos);
@@ -44,11 +80,11 @@ void main()
 #else // not SKELETAL_ANIMATION
 
 	gl_Position = mvp * vec4(in_position, 1);
-	vert_normal = (transform * vec4(in_normal.xyz, 0)).xyz;
+	vert_normal = (transform * vec4(surface_normal, 0)).xyz;
 
 	#ifdef TEX_NORMAL
-		vert_tangent = (transform * vec4(in_tangent.xyz, 0)).xyz;
-		vert_bitangent = cross(vert_normal, vert_tangent) * in_tangent.w;
+		vert_tangent = (transform * vec4(surface_tangent.xyz, 0)).xyz;
+		vert_bitangent = cross(vert_normal, vert_tangent) * surface_tangent.w;
 	#endif // TEX_NORMAL
 	
 	#ifndef SKIP_LIGHTING
@@ -59,7 +95,7 @@ void main()
 
 
 	vert_texcoord = in_texcoord;
-	vert_color = in_normal.w;
+	vert_color = surface_shading;
 	
 }
 
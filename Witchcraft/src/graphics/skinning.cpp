@@ -0,0 +1,100 @@
+#include "skinning.h"
+
+#include "math/simd/vmath_simd.h"
+#include "sys/jobs.h"
+
+using namespace vmath;
+
+namespace {
+
+	constexpr const float WEIGHT_SCALE = 1.0f / 255.0f;
+
+	inline __m128 LoadColumn(const mat4& matrix, int column)
+		{ return _mm_loadu_ps(matrix.columns[column].data); }
+
+	inline vec3 StoreVec3(__m128 val)
+	{
+		alignas(16) float result[4];
+		_mm_store_ps(result, val);
+		return { result[0], result[1], result[2] };
+	}
+
+	void SkinRange(const VertexPosition* positions, const vec3* normals, const VertexSkin* skin, size_t begin, size_t end,
+		const mat4* bone_matrices, vec3* out_positions, vec3* out_normals)
+	{
+		for (size_t v = begin; v < end; ++v)
+		{
+			// Blend the four matrices a column at a time.  Zero weights are cheaper to multiply by than to branch on.
+			const VertexSkin& s = skin[v];
+			const mat4& m0 = bone_matrices[s.bone[0]];
+			const mat4& m1 = bone_matrices[s.bone[1]];
+			const mat4& m2 = bone_matrices[s.bone[2]];
+			const mat4& m3 = bone_matrices[s.bone[3]];
+			__m128 w0 = _mm_set1_ps((float)s.weight[0] * WEIGHT_SCALE);
+			__m128 w1 = _mm_set1_ps((float)s.weight[1] * WEIGHT_SCALE);
+			__m128 w2 = _mm_set1_ps((float)s.weight[2] * WEIGHT_SCALE);
+			__m128 w3 = _mm_set1_ps((float)s.weight[3] * WEIGHT_SCALE);
+
+			__m128 columns[4];
+			for (int c = 0; c < 4; ++c)
+				{ columns[c] = (LoadColumn(m0, c) * w0) + (LoadColumn(m1, c) * w1) + (LoadColumn(m2, c) * w2) + (LoadColumn(m3, c) * w3); }
+
+			const VertexPosition& p = positions[v];
+			__m128 position = (columns[0] * _mm_set1_ps(p.x)) + (columns[1] * _mm_set1_ps(p.y)) + (columns[2] * _mm_set1_ps(p.z)) + columns[3];
+			out_positions[v] = StoreVec3(position);
+
+			if (normals != nullptr && out_normals != nullptr)
+			{
+				const vec3& n = normals[v];
+				__m128 normal = (columns[0] * _mm_set1_ps(n.x)) + (columns[1] * _mm_set1_ps(n.y)) + (columns[2] * _mm_set1_ps(n.z));
+				out_normals[v] = StoreVec3(normal).normalized();
+			}
+		}
+	}
+
+} // namespace <anon>
+
+void SkinVertices(const VertexPosition* positions, const vec3* normals, const VertexSkin* skin, size_t num_vertices,
+	const mat4* bone_matrices, vec3* out_positions, vec3* out_normals, bool multithreaded)
+{
+	if (positions == nullptr || skin == nullptr || bone_matrices == nullptr || out_positions == nullptr)
+		return;
+
+	if (multithreaded == false)
+	{
+		SkinRange(positions, normals, skin, 0, num_vertices, bone_matrices, out_positions, out_normals);
+		return;
+	}
+
+	// Every vertex is independent, so the workers can each take a range.
+	jobs::ParallelFor(num_vertices, SKINNING_BATCH_SIZE, [&](size_t begin, size_t end)
+		{ SkinRange(positions, normals, skin, begin, end, bone_matrices, out_positions, out_normals); });
+}
+
+void SkinVerticesReference(const VertexPosition* positions, const vec3* normals, const VertexSkin* skin, size_t num_vertices,
+	const mat4* bone_matrices, vec3* out_positions, vec3* out_normals)
+{
+	if (positions == nullptr || skin == nullptr || bone_matrices == nullptr || out_positions == nullptr)
+		return;
+
+	for (size_t v = 0; v < num_vertices; ++v)
+	{
+		vec4 position = vec4(positions[v].x, positions[v].y, positions[v].z, 1.0f);
+		vec4 normal = (normals != nullptr) ? vec4(normals[v], 0.0f) : vec4(0.0f, 0.0f, 0.0f, 0.0f);
+		vec4 skinned_position = vec4(0.0f, 0.0f, 0.0f, 0.0f);
+		vec4 skinned_normal = vec4(0.0f, 0.0f, 0.0f, 0.0f);
+		for (int i = 0; i < 4; ++i)
+		{
+			float weight = (float)skin[v].weight[i] * WEIGHT_SCALE;
+			skinned_position += (bone_matrices[skin[v].bone[i]] * position) * weight;
+			skinned_normal += (bone_matrices[skin[v].bone[i]] * normal) * weight;
+		}
+
+		out_positions[v] = skinned_position.xyz;
+		if (normals != nullptr && out_normals != nullptr)
+		{
+			vec3 skinned = skinned_normal.xyz;
+			out_normals[v] = skinned.normalized();
+		}
+	}
+}
\ No newline at end of file
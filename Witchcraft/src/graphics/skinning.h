@@ -0,0 +1,35 @@
+#ifndef HVH_WC_GRAPHICS_SKINNING_H
+#define HVH_WC_GRAPHICS_SKINNING_H
+
+#include "vertex.h"
+#include "math/vmath.h"
+
+#include <cstddef>
+
+/*
+Skinning on the CPU, for anything which needs to know where a skinned model's vertices actually end up:
+hit detection, decals, servers without a GPU, and tests.  This does exactly what the SKELETAL_ANIMATION shaders do;
+each vertex is moved by the weighted sum of up to four of an AnimationController's final bone matrices.
+Results are in the model's space, before the entity's transform is applied.
+*/
+
+// Vertices are handed out to worker threads this many at a time.
+constexpr const size_t SKINNING_BATCH_SIZE = 2048;
+
+/* Skins 'num_vertices' vertices, blending the bone matrices four lanes at a time. */
+/* 'normals' and 'out_normals' can be null if only positions are needed; skinned normals are renormalized. */
+/* Bone indices aren't checked, so every vertex's bones must be within 'bone_matrices'. */
+void SkinVertices(const VertexPosition* positions, const vmath::vec3* normals, const VertexSkin* skin, size_t num_vertices,
+	const vmath::mat4* bone_matrices, vmath::vec3* out_positions, vmath::vec3* out_normals, bool multithreaded = false);
+
+/* The same as SkinVertices, one plain matrix at a time, for checking its results against. */
+void SkinVerticesReference(const VertexPosition* positions, const vmath::vec3* normals, const VertexSkin* skin, size_t num_vertices,
+	const vmath::mat4* bone_matrices, vmath::vec3* out_positions, vmath::vec3* out_normals);
+
+/* Checks that the SIMD kernel agrees with the reference.  Returns false if any test fails. */
+bool RunSkinningUnitTests();
+
+/* Times the kernel on one thread and on every thread, and logs how many vertices per second each manages. */
+void RunSkinningBenchmark();
+
+#endif // HVH_WC_GRAPHICS_SKINNING_H
\ No newline at end of file
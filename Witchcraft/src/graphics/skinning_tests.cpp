@@ -0,0 +1,139 @@
+#include "skinning.h"
+
+#include "sys/printlog.h"
+#include "sys/timer.h"
+#include "sys/jobs.h"
+#include "tools/testrandom.h"
+
+#include <cmath>
+#include <vector>
+using namespace vmath;
+
+namespace {
+
+	TestRandom test_random(24680);
+
+	// Fills in a random skinned mesh and a random pose for it.
+	void MakeTestMesh(size_t num_vertices, int num_bones, std::vector<VertexPosition>& positions, std::vector<vec3>& normals,
+		std::vector<VertexSkin>& skin, std::vector<mat4>& bones)
+	{
+		positions.resize(num_vertices);
+		normals.resize(num_vertices);
+		skin.resize(num_vertices);
+		for (size_t v = 0; v < num_vertices; ++v)
+		{
+			positions[v] = vec3(test_random.Float(-1, 1), test_random.Float(0, 2), test_random.Float(-1, 1));
+			normals[v] = vec3(test_random.Float(-1, 1), test_random.Float(-1, 1), test_random.Float(-1, 1) + 2.0f).normalized();
+
+			float weights[4] = { test_random.Float(0, 1), test_random.Float(0, 1), test_random.Float(0, 1), (v % 4) ? test_random.Float(0, 1) : 0.0f };
+			float total = weights[0] + weights[1] + weights[2] + weights[3];
+			for (int i = 0; i < 4; ++i)
+			{
+				weights[i] /= total;
+				skin[v].bone[i] = (uint8_t)test_random.Float(0.0f, (float)num_bones);
+			}
+			skin[v].set_weights(weights);
+		}
+
+		bones.resize(num_bones);
+		for (int i = 0; i < num_bones; ++i)
+		{
+			bones[i] = mat4::translation(test_random.Float(-1, 1), test_random.Float(-1, 1), test_random.Float(-1, 1)) *
+					   mat4::rotation(quat::euler({ test_random.Float(-3, 3), test_random.Float(-3, 3), test_random.Float(-3, 3) }));
+		}
+	}
+
+} // namespace <anon>
+
+bool RunSkinningUnitTests()
+{
+	bool success = true;
+	const size_t NUM_VERTICES = 5000;
+	const int NUM_BONES = 32;
+
+	std::vector<VertexPosition> positions;
+	std::vector<vec3> normals;
+	std::vector<VertexSkin> skin;
+	std::vector<mat4> bones;
+	MakeTestMesh(NUM_VERTICES, NUM_BONES, positions, normals, skin, bones);
+
+	std::vector<vec3> reference_positions(NUM_VERTICES), reference_normals(NUM_VERTICES);
+	std::vector<vec3> simd_positions(NUM_VERTICES), simd_normals(NUM_VERTICES);
+	std::vector<vec3> threaded_positions(NUM_VERTICES), threaded_normals(NUM_VERTICES);
+
+	// With every bone at the identity, nothing should move.
+	{
+		std::vector<mat4> identity(NUM_BONES, MAT4_IDENTITY);
+		SkinVertices(positions.data(), normals.data(), skin.data(), NUM_VERTICES, identity.data(), simd_positions.data(), simd_normals.data());
+		for (size_t v = 0; v < NUM_VERTICES; ++v)
+		{
+			if (vec3::distance(simd_positions[v], positions[v].to_vec3()) > 0.0001f || vec3::distance(simd_normals[v], normals[v]) > 0.0001f)
+			{
+				plog::error("skinning unit test failed: vertex %i moved under the identity pose.\n", (int)v);
+				success = false;
+				break;
+			}
+		}
+	}
+
+	// The SIMD kernel should agree with the plain version, on one thread or many.
+	SkinVerticesReference(positions.data(), normals.data(), skin.data(), NUM_VERTICES, bones.data(), reference_positions.data(), reference_normals.data());
+	SkinVertices(positions.data(), normals.data(), skin.data(), NUM_VERTICES, bones.data(), simd_positions.data(), simd_normals.data());
+	SkinVertices(positions.data(), normals.data(), skin.data(), NUM_VERTICES, bones.data(), threaded_positions.data(), threaded_normals.data(), true);
+
+	float worst_position = 0.0f, worst_normal = 0.0f;
+	for (size_t v = 0; v < NUM_VERTICES; ++v)
+	{
+		worst_position = fmaxf(worst_position, vec3::distance(simd_positions[v], reference_positions[v]));
+		worst_normal = fmaxf(worst_normal, vec3::distance(simd_normals[v], reference_normals[v]));
+
+		if (threaded_positions[v] != simd_positions[v] || threaded_normals[v] != simd_normals[v])
+		{
+			plog::error("skinning unit test failed: vertex %i came out differently when skinned on several threads.\n", (int)v);
+			success = false;
+			break;
+		}
+	}
+	if (worst_position > 0.0001f || worst_normal > 0.0001f)
+	{
+		plog::error("skinning unit test failed: SIMD skinning was off by up to %f (positions) and %f (normals).\n", worst_position, worst_normal);
+		success = false;
+	}
+
+	return success;
+}
+
+void RunSkinningBenchmark()
+{
+	const size_t NUM_VERTICES = 200000;
+	const int NUM_BONES = 64;
+	const int NUM_PASSES = 10;
+
+	std::vector<VertexPosition> positions;
+	std::vector<vec3> normals;
+	std::vector<VertexSkin> skin;
+	std::vector<mat4> bones;
+	MakeTestMesh(NUM_VERTICES, NUM_BONES, positions, normals, skin, bones);
+	std::vector<vec3> out_positions(NUM_VERTICES), out_normals(NUM_VERTICES);
+
+	sys::Timer timer;
+	double seconds[3];
+	for (int mode = 0; mode < 3; ++mode)
+	{
+		timer.update();
+		for (int pass = 0; pass < NUM_PASSES; ++pass)
+		{
+			if (mode == 0)
+				{ SkinVerticesReference(positions.data(), normals.data(), skin.data(), NUM_VERTICES, bones.data(), out_positions.data(), out_normals.data()); }
+			else
+				{ SkinVertices(positions.data(), normals.data(), skin.data(), NUM_VERTICES, bones.data(), out_positions.data(), out_normals.data(), (mode == 2)); }
+		}
+		timer.update();
+		seconds[mode] = timer.getDeltaTime();
+	}
+
+	double vertices = (double)(NUM_VERTICES * NUM_PASSES);
+	plog::info("Skinning benchmark: %i vertices with normals; reference %.1f M/s, SIMD %.1f M/s, SIMD on %i threads %.1f M/s. [%f]\n",
+		(int)NUM_VERTICES, vertices / seconds[0] / 1000000.0, vertices / seconds[1] / 1000000.0,
+		(int)jobs::getNumWorkers() + 1, vertices / seconds[2] / 1000000.0, out_positions[NUM_VERTICES / 2].x);
+}
\ No newline at end of file
@@ -0,0 +1,130 @@
+#include "vertex.h"
+
+#include <cmath>
+#include <cstdlib>
+using namespace vmath;
+
+namespace {
+
+	// The tangent angle uses 127 steps, stored as 1-127 so that its sign is never lost to zero.
+	constexpr const float TANGENT_ANGLE_STEPS = 127.0f;
+	constexpr const float TWO_PI = 6.28318530718f;
+
+	// Matches how the GPU unpacks normalized signed bytes.
+	inline float unpack_snorm8(int8_t val)
+		{ return fmaxf((float)val / (float)SCHAR_MAX, -1.0f); }
+
+	inline int8_t pack_snorm8(float val)
+		{ return (int8_t)roundf(fminf(fmaxf(val, -1.0f), 1.0f) * (float)SCHAR_MAX); }
+
+	// Builds two axes perpendicular to a unit vector (Duff et al. 2017).
+	// The shader uses the same construction to rebuild tangents, so the two must stay in sync.
+	void OrthonormalBasis(vec3 n, vec3& b1, vec3& b2)
+	{
+		float sign = (n.z >= 0.0f) ? 1.0f : -1.0f;
+		float a = -1.0f / (sign + n.z);
+		float b = n.x * n.y * a;
+		b1 = vec3(1.0f + (sign * n.x * n.x * a), sign * b, -sign * n.x);
+		b2 = vec3(b, sign + (n.y * n.y * a), -n.y);
+	}
+
+} // namespace <anon>
+
+void VertexPositionQuantized::quantize(vec3 in, vec3 offset, float scale)
+{
+	vec3 unorm = (in - offset) / scale;
+	x = (uint16_t)roundf(fminf(fmaxf(unorm.x, 0.0f), 1.0f) * (float)USHRT_MAX);
+	y = (uint16_t)roundf(fminf(fmaxf(unorm.y, 0.0f), 1.0f) * (float)USHRT_MAX);
+	z = (uint16_t)roundf(fminf(fmaxf(unorm.z, 0.0f), 1.0f) * (float)USHRT_MAX);
+	pad = 0;
+}
+
+vec3 VertexPositionQuantized::dequantize(vec3 offset, float scale) const
+{
+	return offset + (vec3((float)x, (float)y, (float)z) * (scale / (float)USHRT_MAX));
+}
+
+vec3 VertexSurfaceOctahedral::normal_to_vec3() const
+{
+	vec3 result = vec3(unpack_snorm8(nu), unpack_snorm8(nv), 0.0f);
+	result.z = 1.0f - fabsf(result.x) - fabsf(result.y);
+	if (result.z < 0.0f)
+	{
+		// Unfold the lower half of the octahedron.
+		float u = result.x, v = result.y;
+		result.x = (1.0f - fabsf(v)) * ((u >= 0.0f) ? 1.0f : -1.0f);
+		result.y = (1.0f - fabsf(u)) * ((v >= 0.0f) ? 1.0f : -1.0f);
+	}
+	return result.normalized();
+}
+
+void VertexSurfaceOctahedral::vec3_to_normal(vec3 in)
+{
+	// Project onto the octahedron, then fold the lower half over the upper half.
+	float length = fabsf(in.x) + fabsf(in.y) + fabsf(in.z);
+	if (length <= 0.0f)
+		{ nu = 0; nv = 0; return; }
+
+	float u = in.x / length, v = in.y / length;
+	if (in.z < 0.0f)
+	{
+		float fu = (1.0f - fabsf(v)) * ((u >= 0.0f) ? 1.0f : -1.0f);
+		float fv = (1.0f - fabsf(u)) * ((v >= 0.0f) ? 1.0f : -1.0f);
+		u = fu; v = fv;
+	}
+	nu = pack_snorm8(u);
+	nv = pack_snorm8(v);
+}
+
+vec3 VertexSurfaceOctahedral::tangent_to_vec3() const
+{
+	vec3 b1, b2;
+	OrthonormalBasis(normal_to_vec3(), b1, b2);
+
+	float steps = (float)abs((int)tangent) - 1.0f;
+	float angle = steps * (TWO_PI / TANGENT_ANGLE_STEPS);
+	return (b1 * cosf(angle)) + (b2 * sinf(angle));
+}
+
+void VertexSurfaceOctahedral::vec3_to_tangent(vec3 in, float bitangent_sign)
+{
+	// Measure the angle against the basis of the normal as it will be decoded, not as it was given.
+	vec3 b1, b2;
+	OrthonormalBasis(normal_to_vec3(), b1, b2);
+
+	float angle = atan2f(vec3::dot(in, b2), vec3::dot(in, b1));
+	if (angle < 0.0f)
+		{ angle += TWO_PI; }
+
+	int steps = (int)roundf(angle * (TANGENT_ANGLE_STEPS / TWO_PI)) % (int)TANGENT_ANGLE_STEPS;
+	tangent = (int8_t)((bitangent_sign < 0.0f) ? -(steps + 1) : (steps + 1));
+}
+
+void VertexSkin::set_weights(const float in[4])
+{
+	// Round everything down, then hand out what's left to the weights which lost the most.
+	float remainder[4];
+	int total = 0;
+	for (int i = 0; i < 4; ++i)
+	{
+		float scaled = fminf(fmaxf(in[i], 0.0f), 1.0f) * (float)UCHAR_MAX;
+		weight[i] = (uint8_t)scaled;
+		remainder[i] = scaled - (float)weight[i];
+		total += weight[i];
+	}
+
+	while (total < UCHAR_MAX)
+	{
+		int best = 0;
+		for (int i = 1; i < 4; ++i)
+		{
+			if (remainder[i] > remainder[best])
+				{ best = i; }
+		}
+		if (weight[best] == UCHAR_MAX)
+			{ break; }
+		weight[best]++;
+		remainder[best] -= 1.0f;
+		total++;
+	}
+}
\ No newline at end of file
@@ -12,6 +12,8 @@ enum VertexFormatFlags
 	VF_SKIN = 1 << 2,
 	VF_SKIN_LARGE = 1 << 3,
 	VF_2D = 1 << 4,
+	VF_POSITION_QUANTIZED = 1 << 5,
+	VF_SURFACE_OCTAHEDRAL = 1 << 6,
 };
 
 
@@ -25,7 +27,18 @@ struct VertexPosition
 	vmath::vec3 to_vec3()
 		{ return {x, y, z}; }
 
-}; // 12 bytes; can possibly reduce to 8 by using ushorts and scaling the mesh using its matrix.
+}; // 12 bytes; see VertexPositionQuantized for the 8 byte version.
+
+// Positions quantized to 16 bits per axis within the mesh's bounding cube.
+// Every axis shares one scale so the dequantization can be folded into the mesh's matrix without skewing its normals.
+struct VertexPositionQuantized
+{
+	uint16_t x, y, z, pad;
+
+	void quantize(vmath::vec3 in, vmath::vec3 offset, float scale);
+	vmath::vec3 dequantize(vmath::vec3 offset, float scale) const;
+
+}; // 8 bytes; the padding keeps each position 4-byte aligned.
 
 struct VertexSurface
 {
@@ -52,13 +65,35 @@ struct VertexSurface
 		{ tx = (int8_t)(in.x * CHAR_MAX); ty = (int8_t)(in.y * CHAR_MAX); tz = (int8_t)(in.z * CHAR_MAX); }
 
 
-}; // 12 bytes; can possibly reduce to 8 by using qtangents.
+}; // 12 bytes; see VertexSurfaceOctahedral for the 8 byte version.
+
+// Surface information with the normal stored as an octahedral projection,
+// and the tangent stored as an angle around the normal with the bitangent sign in the sign bit.
+// The normal lines up with VertexSurface's normal and shading so both formats can share a vertex attribute.
+struct VertexSurfaceOctahedral
+{
+	vmath::half s, t;
+	int8_t nu, nv, shading, tangent;
+
+	vmath::vec3 normal_to_vec3() const;
+	void vec3_to_normal(vmath::vec3 in);
+
+	// The tangent is stored relative to the normal, so the normal must be set first.
+	vmath::vec3 tangent_to_vec3() const;
+	float bitangent_sign() const
+		{ return (tangent < 0) ? -1.0f : 1.0f; }
+	void vec3_to_tangent(vmath::vec3 in, float bitangent_sign);
+
+}; // 8 bytes
 
 struct VertexSkin
 {
 	uint8_t bone[4];
 	uint8_t weight[4];
 
+	// Quantizes normalized weights so they add up to exactly 255.
+	void set_weights(const float in[4]);
+
 }; // 8 bytes; could reduce to 4 by limiting to 2 bones per vertex, but do we really want to?
 
 struct VertexSkinLarge
@@ -79,8 +114,12 @@ inline uint32_t calc_bytes_per_vertex(uint32_t format)
 
 	if (format & VF_POSITION)
 		result += sizeof(VertexPosition);
+	if (format & VF_POSITION_QUANTIZED)
+		result += sizeof(VertexPositionQuantized);
 	if (format & VF_SURFACE)
 		result += sizeof(VertexSurface);
+	if (format & VF_SURFACE_OCTAHEDRAL)
+		result += sizeof(VertexSurfaceOctahedral);
 	if (format & VF_SKIN)
 		result += sizeof(VertexSkin);
 	if (format & VF_SKIN_LARGE)
@@ -93,4 +132,7 @@ inline uint32_t calc_bytes_per_vertex(uint32_t format)
 
 size_t InitVertex(VertexFormatFlags format, uint32_t num_vertices, size_t offset = 0);
 
+/* Checks the quantized vertex formats' encoding and decoding on the CPU. */
+bool RunVertexUnitTests();
+
 #endif // HVH_WC_GRAPHICS_VERTEX_H
\ No newline at end of file
@@ -7,7 +7,7 @@
 
 size_t InitVertex(VertexFormatFlags format, uint32_t num_vertices, size_t offset)
 {
-	if ((format & (VF_POSITION | VF_SURFACE | VF_SKIN | VF_SKIN_LARGE)) && (format & VF_2D))
+	if ((format & (VF_POSITION | VF_POSITION_QUANTIZED | VF_SURFACE | VF_SURFACE_OCTAHEDRAL | VF_SKIN | VF_SKIN_LARGE)) && (format & VF_2D))
 	{
 		plog::error("2D vertices should not have 3D information.\n");
 		return offset;
@@ -19,6 +19,18 @@ size_t InitVertex(VertexFormatFlags format, uint32_t num_vertices, size_t offset
 		return offset;
 	}
 
+	if ((format & VF_POSITION) && (format & VF_POSITION_QUANTIZED))
+	{
+		plog::error("Full and quantized positions are mutually exclusive.\n");
+		return offset;
+	}
+
+	if ((format & VF_SURFACE) && (format & VF_SURFACE_OCTAHEDRAL))
+	{
+		plog::error("Full and octahedral surface information are mutually exclusive.\n");
+		return offset;
+	}
+
 	if (format & VF_POSITION)
 	{
 		// Position uses index 0 and is a 'float3'.
@@ -27,6 +39,14 @@ size_t InitVertex(VertexFormatFlags format, uint32_t num_vertices, size_t offset
 		offset += sizeof(VertexPosition) * num_vertices;
 	}
 
+	if (format & VF_POSITION_QUANTIZED)
+	{
+		// Quantized positions also use index 0, as a normalized 'ushort3' which the geometry's matrix scales back up.
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(VertexPositionQuantized), (void*)offset);
+		offset += sizeof(VertexPositionQuantized) * num_vertices;
+	}
+
 	if (format & VF_SURFACE)
 	{
 		// Texture coordinates use index 1 and is a 'half2'
@@ -41,6 +61,17 @@ size_t InitVertex(VertexFormatFlags format, uint32_t num_vertices, size_t offset
 		offset += sizeof(VertexSurface) * num_vertices;
 	}
 
+	if (format & VF_SURFACE_OCTAHEDRAL)
+	{
+		// Texture coordinates use index 1 and is a 'half2'
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(1, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(VertexSurfaceOctahedral), (void*)(offset + offsetof(VertexSurfaceOctahedral, s)));
+		// The packed normal, shading, and tangent angle use index 2 and is a 'byte4'; the shader unpacks the tangent itself.
+		glEnableVertexAttribArray(2);
+		glVertexAttribPointer(2, 4, GL_BYTE, GL_TRUE, sizeof(VertexSurfaceOctahedral), (void*)(offset + offsetof(VertexSurfaceOctahedral, nu)));
+		offset += sizeof(VertexSurfaceOctahedral) * num_vertices;
+	}
+
 	if (format & VF_SKIN)
 	{
 		// Bone indices use index 4 and is a 'ubyte4'.
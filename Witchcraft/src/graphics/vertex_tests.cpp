@@ -0,0 +1,126 @@
+#include "vertex.h"
+
+#include "sys/printlog.h"
+#include "tools/testrandom.h"
+
+#include <cmath>
+using namespace vmath;
+
+namespace {
+
+	TestRandom test_random(12345);
+
+	vec3 RandomDirection()
+	{
+		vec3 result;
+		do { result = vec3(test_random.Float(-1, 1), test_random.Float(-1, 1), test_random.Float(-1, 1)); }
+		while (result.magnitude_squared() < 0.01f || result.magnitude_squared() > 1.0f);
+		return result.normalized();
+	}
+
+	inline float AngleBetween(vec3 a, vec3 b)
+		{ return acosf(fminf(fmaxf(vec3::dot(a, b), -1.0f), 1.0f)) * (180.0f / 3.14159265f); }
+
+} // namespace <anon>
+
+bool RunVertexUnitTests()
+{
+	bool success = true;
+	const int NUM_SAMPLES = 10000;
+
+	// Positions should come back within half a step of where they started.
+	{
+		vec3 lower = vec3(-12.5f, 3.0f, -0.25f);
+		float scale = 40.0f;
+		float tolerance = (scale / (float)USHRT_MAX) * 0.51f;
+		for (int i = 0; i < NUM_SAMPLES; ++i)
+		{
+			vec3 pos = lower + vec3(test_random.Float(0, scale), test_random.Float(0, scale), test_random.Float(0, scale));
+			VertexPositionQuantized quantized;
+			quantized.quantize(pos, lower, scale);
+			vec3 result = quantized.dequantize(lower, scale);
+			if (fabsf(result.x - pos.x) > tolerance || fabsf(result.y - pos.y) > tolerance || fabsf(result.z - pos.z) > tolerance)
+			{
+				plog::error("vertex unit test failed: quantized position (%f, %f, %f) came back as (%f, %f, %f).\n",
+					pos.x, pos.y, pos.z, result.x, result.y, result.z);
+				success = false;
+				break;
+			}
+		}
+	}
+
+	// Octahedral normals should be at least as accurate as the 8-bit normals they replace.
+	{
+		float worst = 0.0f;
+		const vec3 axes[] = { {1,0,0}, {-1,0,0}, {0,1,0}, {0,-1,0}, {0,0,1}, {0,0,-1} };
+		for (int i = 0; i < NUM_SAMPLES + 6; ++i)
+		{
+			vec3 normal = (i < 6) ? axes[i] : RandomDirection();
+			VertexSurfaceOctahedral surface;
+			surface.vec3_to_normal(normal);
+			worst = fmaxf(worst, AngleBetween(normal, surface.normal_to_vec3()));
+		}
+		if (worst > 1.5f)
+		{
+			plog::error("vertex unit test failed: octahedral normals were off by up to %f degrees.\n", worst);
+			success = false;
+		}
+	}
+
+	// Tangents are rebuilt around the decoded normal, so they should stay perpendicular to it and keep their handedness.
+	{
+		float worst = 0.0f;
+		for (int i = 0; i < NUM_SAMPLES; ++i)
+		{
+			vec3 normal = RandomDirection();
+			vec3 tangent = vec3::cross(normal, RandomDirection()).normalized();
+			float sign = (i % 2) ? -1.0f : 1.0f;
+
+			VertexSurfaceOctahedral surface;
+			surface.vec3_to_normal(normal);
+			surface.vec3_to_tangent(tangent, sign);
+			vec3 result = surface.tangent_to_vec3();
+
+			if (surface.bitangent_sign() != sign || fabsf(vec3::dot(result, surface.normal_to_vec3())) > 0.001f)
+			{
+				plog::error("vertex unit test failed: tangent lost its handedness or is not perpendicular to its normal.\n");
+				success = false;
+				break;
+			}
+			worst = fmaxf(worst, AngleBetween(tangent, result));
+		}
+		if (worst > 3.0f)
+		{
+			plog::error("vertex unit test failed: tangents were off by up to %f degrees.\n", worst);
+			success = false;
+		}
+	}
+
+	// Bone weights should always add up to exactly 255, with no weight more than one step from where it started.
+	{
+		for (int i = 0; i < NUM_SAMPLES; ++i)
+		{
+			float weights[4] = { test_random.Float(0, 1), test_random.Float(0, 1), test_random.Float(0, 1), (i % 3) ? test_random.Float(0, 1) : 0.0f };
+			float total = weights[0] + weights[1] + weights[2] + weights[3];
+			for (int j = 0; j < 4; ++j)
+				{ weights[j] /= total; }
+
+			VertexSkin skin;
+			skin.set_weights(weights);
+			int sum = skin.weight[0] + skin.weight[1] + skin.weight[2] + skin.weight[3];
+			bool close = true;
+			for (int j = 0; j < 4; ++j)
+				{ close = close && (fabsf((float)skin.weight[j] - (weights[j] * (float)UCHAR_MAX)) < 1.0f); }
+
+			if (sum != UCHAR_MAX || !close)
+			{
+				plog::error("vertex unit test failed: weights (%f, %f, %f, %f) quantized to (%i, %i, %i, %i).\n",
+					weights[0], weights[1], weights[2], weights[3], skin.weight[0], skin.weight[1], skin.weight[2], skin.weight[3]);
+				success = false;
+				break;
+			}
+		}
+	}
+
+	return success;
+}
\ No newline at end of file
@@ -7,17 +7,28 @@
 #include "sys/window.h"
 #include "physics/physics_system.h"
 #include "scene/scene.h"
+#include "scene/transform_kernel.h"
 #include "graphics/renderer.h"
+#include "graphics/lod.h"
+#include "graphics/vertex.h"
+#include "graphics/animation_compression.h"
+#include "graphics/animation_graph.h"
+#include "graphics/animation_controller.h"
+#include "graphics/animation_ik.h"
+#include "graphics/skinning.h"
 #include "gui/guilayer.h"
 
 #include "appconfig.h"
 
 #include "sys/timer.h"
+#include "sys/jobs.h"
 
 #include "math/lua/vmath_lua.h"
 
 #include "tools/stringhelper.h"
 
+#include <cstring>
+
 
 /* A simple convenience function which shows the crash reports and then returns 1, to be returned from main(). */
 int Crash()
@@ -26,11 +37,20 @@ int Crash()
 	return 1;
 }
 
-int main(int, char**)
+int main(int argc, char** argv)
 {
 	// Hello World!
 
+	// '-benchmark' times the systems which have benchmarks, after their unit tests.  They take a while, so they never run otherwise.
+	bool run_benchmarks = false;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "-benchmark") == 0)
+			{ run_benchmarks = true; }
+	}
+
 	// Initialize subsystems.
+	if (!jobs::Init()) return Crash();
 	if (!filemanager::Init()) return Crash();
 	if (!lua::Init()) return Crash();
 	vmath::InitLua();
@@ -39,6 +59,27 @@ int main(int, char**)
 	if (!renderer::Init()) return Crash();
 	scene::InitLua();
 
+	// Check the systems which can be tested on the CPU alone, in debug builds.
+#ifdef _DEBUG
+	if (app::use_debug)
+	{
+		RunLodUnitTests();
+		RunVertexUnitTests();
+		RunAnimationCompressionUnitTests();
+		RunAnimationGraphUnitTests();
+		RunAnimationControllerUnitTests();
+		RunIKUnitTests();
+		RunSkinningUnitTests();
+		RunTransformUnitTests();
+	}
+#endif
+	if (run_benchmarks)
+	{
+		RunAnimationBenchmark();
+		RunSkinningBenchmark();
+		RunTransformBenchmark();
+	}
+
 	// Timing variables used by the main loop.
 	uint32_t logical_frame_counter = 0;
 	uint32_t game_frame_counter = 0;
@@ -155,6 +196,7 @@ int main(int, char**)
 	renderer::Cleanup();
 	window::Close();
 	filemanager::Shutdown();
+	jobs::Shutdown();
 
 	// Display any fatal errors as message boxes.
 	plog::ShowCrashReports();
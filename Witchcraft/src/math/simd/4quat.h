@@ -0,0 +1,68 @@
+#ifndef HVH_WC_MATH_SIMD_4QUAT_H
+#define HVH_WC_MATH_SIMD_4QUAT_H
+
+#include "vmath_simd.h"
+
+#include "../quat.h"
+
+namespace vmath {
+
+
+// Four quaternions stored one component at a time, the same way as simd_4vec3.
+struct simd_4quat
+{
+	union
+	{
+		struct { __m128 x, y, z, w; };
+		__m128 data[4];
+		float fdata[4][4];
+	};
+};
+
+inline simd_4quat simd_4quat_identity()
+	{ return{ _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps(), _mm_set1_ps(1.0f) }; }
+
+inline quat get_quat(const simd_4quat& in, uint32_t i)
+{
+	return{ in.fdata[0][i], in.fdata[1][i], in.fdata[2][i], in.fdata[3][i] };
+}
+
+inline void set_quat(simd_4quat& out, uint32_t i, quat in)
+{
+	out.fdata[0][i] = in.x;
+	out.fdata[1][i] = in.y;
+	out.fdata[2][i] = in.z;
+	out.fdata[3][i] = in.w;
+}
+
+// Matches quat::operator*, four at a time.
+inline simd_4quat operator * (const simd_4quat& lhs, const simd_4quat& rhs)
+{
+	return{ (rhs.w * lhs.x) + (rhs.x * lhs.w) + (rhs.y * lhs.z) - (rhs.z * lhs.y),
+			(rhs.w * lhs.y) + (rhs.y * lhs.w) + (rhs.z * lhs.x) - (rhs.x * lhs.z),
+			(rhs.w * lhs.z) + (rhs.z * lhs.w) + (rhs.x * lhs.y) - (rhs.y * lhs.x),
+			(rhs.w * lhs.w) - (rhs.x * lhs.x) - (rhs.y * lhs.y) - (rhs.z * lhs.z) };
+}
+
+inline simd_4quat operator * (const simd_4quat& lhs, __m128 rhs)
+	{ return{ lhs.x * rhs, lhs.y * rhs, lhs.z * rhs, lhs.w * rhs }; }
+
+inline simd_4quat operator + (const simd_4quat& lhs, const simd_4quat& rhs)
+	{ return{ lhs.x + rhs.x, lhs.y + rhs.y, lhs.z + rhs.z, lhs.w + rhs.w }; }
+
+inline __m128 dot(const simd_4quat& lhs, const simd_4quat& rhs)
+	{ return (lhs.x * rhs.x) + (lhs.y * rhs.y) + (lhs.z * rhs.z) + (lhs.w * rhs.w); }
+
+inline simd_4quat normalized(const simd_4quat& in)
+{
+	__m128 inv_magnitude = _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(dot(in, in)));
+	return in * inv_magnitude;
+}
+
+// Matches quat::lerp; a normalized lerp which doesn't flip 'to' onto the shortest path.
+inline simd_4quat lerp(const simd_4quat& from, const simd_4quat& to, __m128 amount)
+	{ return normalized((from * _mm_sub_ps(_mm_set1_ps(1.0f), amount)) + (to * amount)); }
+
+
+} // namespace vmath
+#endif // HVH_WC_MATH_SIMD_4QUAT_H
\ No newline at end of file
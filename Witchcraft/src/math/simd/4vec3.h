@@ -50,6 +50,16 @@ inline vec3 get_vec3(const simd_4vec3& in, uint32_t i)
 	return{ in.fdata[0][i], in.fdata[1][i], in.fdata[2][i] };
 }
 
+inline void set_vec3(simd_4vec3& out, uint32_t i, vec3 in)
+{
+	out.fdata[0][i] = in.x;
+	out.fdata[1][i] = in.y;
+	out.fdata[2][i] = in.z;
+}
+
+inline simd_4vec3 simd_4vec3_zero()
+	{ return{ _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps() }; }
+
 inline simd_4vec3 operator + (const simd_4vec3& lhs, const simd_4vec3& rhs)
 	{ return{ _mm_add_ps(lhs.x, rhs.x), _mm_add_ps(lhs.y, rhs.y), _mm_add_ps(lhs.z, rhs.z) }; }
 inline simd_4vec3 operator - (const simd_4vec3& lhs, const simd_4vec3& rhs)
@@ -85,6 +95,9 @@ inline void normalize(simd_4vec3& in)
 inline simd_4vec3 normalized(const simd_4vec3& in)
 	{ return in / magnitude(in); }
 
+inline simd_4vec3 lerp(const simd_4vec3& from, const simd_4vec3& to, __m128 amount)
+	{ return from + ((to - from) * amount); }
+
 
 
 } // namespace vmath
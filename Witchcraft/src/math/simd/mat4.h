@@ -2,6 +2,8 @@
 #define HVH_WC_MATH_SIMD_MAT4_H
 
 #include "vmath_simd.h"
+#include "4vec3.h"
+#include "4quat.h"
 #include "../mat4.h"
 
 namespace vmath {
@@ -16,19 +18,19 @@ struct simd_mat4
 	};
 };
 
-simd_mat4 operator * (const simd_mat4& lhs, const simd_mat4& rhs)
+inline simd_mat4 operator * (const simd_mat4& lhs, const simd_mat4& rhs)
 {
 	simd_mat4 result;
 	__m128 b_line;
 	for (int i = 0; i < 4; ++i)
 	{
 		// Unroll the first iteration of the loop to avoid initializing 'result' to zero.
-		b_line = _mm_set1_ps(rhs.base.data2d[i][0]);
+		b_line = _mm_set1_ps(rhs.base.at(0, i));
 		result.xmm[i] = _mm_mul_ps(lhs.xmm[0], b_line);
 
 		for (int j = 1; j < 4; ++j)
 		{
-			b_line = _mm_set1_ps(rhs.base.data2d[i][j]);
+			b_line = _mm_set1_ps(rhs.base.at(j, i));
 			result.xmm[i] = _mm_add_ps(_mm_mul_ps(lhs.xmm[j], b_line), result.xmm[i]);
 		}
 	}
@@ -36,6 +38,58 @@ simd_mat4 operator * (const simd_mat4& lhs, const simd_mat4& rhs)
 	return result;
 }
 
+// Matrix * Matrix for plain mat4s, using the SIMD version under the hood.
+inline mat4 simd_multiply(const mat4& lhs, const mat4& rhs)
+{
+	simd_mat4 a, b;
+	a.base = lhs;
+	b.base = rhs;
+	return (a * b).base;
+}
+
+// Builds the four matrices 'translation(t) * rotation(r)', matching mat4::translation and mat4::rotation.
+// The rotations don't have to be normalized; like mat4::rotation, any scale is squared into the result.
+inline void to_mat4(const simd_4vec3& t, const simd_4quat& r, mat4 out[4])
+{
+	__m128 two = _mm_set1_ps(2.0f);
+	__m128 ww = r.w * r.w, xx = r.x * r.x, yy = r.y * r.y, zz = r.z * r.z;
+
+	simd_4vec3 columns[3];
+	columns[0] = { ww + xx - yy - zz, two * ((r.x * r.y) + (r.w * r.z)), two * ((r.x * r.z) - (r.w * r.y)) };
+	columns[1] = { two * ((r.x * r.y) - (r.w * r.z)), ww - xx + yy - zz, two * ((r.w * r.x) + (r.y * r.z)) };
+	columns[2] = { two * ((r.w * r.y) + (r.x * r.z)), two * ((r.y * r.z) - (r.w * r.x)), ww - xx - yy + zz };
+
+	for (uint32_t i = 0; i < 4; ++i)
+	{
+		for (int c = 0; c < 3; ++c)
+			{ out[i].columns[c] = vec4(get_vec3(columns[c], i), 0.0f); }
+		out[i].columns[3] = vec4(get_vec3(t, i), 1.0f);
+	}
+}
+
+// Builds the four matrices 'translation(t) * rotation(r) * scale(s)', matching mat4::translation, mat4::rotation, and mat4::scale.
+// Each column is transposed from one component per register to one matrix per register, so it can be stored whole.
+inline void to_mat4(const simd_4vec3& t, const simd_4quat& r, const simd_4vec3& s, mat4 out[4])
+{
+	__m128 two = _mm_set1_ps(2.0f);
+	__m128 ww = r.w * r.w, xx = r.x * r.x, yy = r.y * r.y, zz = r.z * r.z;
+
+	__m128 columns[4][4] =
+	{
+		{ (ww + xx - yy - zz) * s.x, two * ((r.x * r.y) + (r.w * r.z)) * s.x, two * ((r.x * r.z) - (r.w * r.y)) * s.x, _mm_setzero_ps() },
+		{ two * ((r.x * r.y) - (r.w * r.z)) * s.y, (ww - xx + yy - zz) * s.y, two * ((r.w * r.x) + (r.y * r.z)) * s.y, _mm_setzero_ps() },
+		{ two * ((r.w * r.y) + (r.x * r.z)) * s.z, two * ((r.y * r.z) - (r.w * r.x)) * s.z, (ww - xx - yy + zz) * s.z, _mm_setzero_ps() },
+		{ t.x, t.y, t.z, _mm_set1_ps(1.0f) },
+	};
+
+	for (int c = 0; c < 4; ++c)
+	{
+		_MM_TRANSPOSE4_PS(columns[c][0], columns[c][1], columns[c][2], columns[c][3]);
+		for (int i = 0; i < 4; ++i)
+			{ _mm_storeu_ps(out[i].columns[c].data, columns[c][i]); }
+	}
+}
+
 
 } // namespace vmath
 #endif // HVH_WC_MATH_SIMD_MAT4_H
\ No newline at end of file
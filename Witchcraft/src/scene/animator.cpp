@@ -1,7 +1,60 @@
 #include "animator.h"
 
 #include "graphics/model.h"
+#include "graphics/camera.h"
+#include "graphics/lod.h"
+#include "graphics/meshlet.h"
+#include "graphics/skinning.h"
 #include "physics//physics_system.h"
+#include "sys/jobs.h"
+
+#include <cmath>
+
+namespace {
+
+	// Controllers are handed out to worker threads this many at a time.
+	constexpr const size_t ANIMATOR_BATCH_SIZE = 4;
+
+	inline bool SphereInFrustum(const vmath::vec4 frustum[6], vmath::vec3 center, float radius)
+	{
+		for (int i = 0; i < 6; ++i)
+		{
+			if (vmath::vec4::dot(frustum[i], vmath::vec4(center, 1.0f)) < -radius)
+				{ return false; }
+		}
+		return true;
+	}
+
+} // namespace <anon>
+
+vmath::mat4 AnimatorComponent::getRootTransform(entity::ID id)
+	{ return getRootTransform(entity::transform::resolve(id)); }
+
+vmath::mat4 AnimatorComponent::getRootTransform(entity::transform::Index transform)
+{
+	if (transform.valid() == false)
+		return vmath::MAT4_IDENTITY;
+
+	return vmath::mat4::translation(entity::transform::getPos(transform)) *
+		   vmath::mat4::rotation(entity::transform::getRot(transform)) *
+		   vmath::mat4::scale(entity::transform::getScale(transform));
+}
+
+AnimatorComponent::~AnimatorComponent()
+{
+	for (size_t i = 1; i < soa.size(); ++i)
+	{
+		if (soa.get<ACE_GRAPH>(i).graph)
+			{ AnimationGraph::Unload(soa.get<ACE_GRAPH>(i).graph_name.c_str); }
+	}
+}
+
+void AnimatorComponent::Remove(entity::ID id)
+{
+	if (hasEntry(id) && soa.get<ACE_GRAPH>(index(id)).graph)
+		{ AnimationGraph::Unload(soa.get<ACE_GRAPH>(index(id)).graph_name.c_str); }
+	RemoveEntry(id);
+}
 
 void AnimatorComponent::ImportAnimations(entity::ID id, const char* filename)
 {
@@ -11,57 +64,384 @@ void AnimatorComponent::ImportAnimations(entity::ID id, const char* filename)
 
 void AnimatorComponent::LogicalUpdate(double delta_time)
 {
+	// Transforms are read on this thread, so the workers don't have to share the transform tables.
+	// This is also where we find out which entities are due for an update; the rest just keep track of the time they've missed.
+	root_transforms.resize(soa.size());
+	transform_indices.resize(soa.size());
+	entity::transform::resolve(soa.rawdata<ACE_ENTITYID>(), soa.size(), transform_indices.data());
+	update_list.clear();
 	for (size_t i = 1; i < soa.size(); ++i)
 	{
-		entity::ID id = soa.get<ACE_ENTITYID>(i);
+		root_transforms[i] = getRootTransform(transform_indices[i]);
+
+		AnimationLod& lod = soa.get<ACE_LOD>(i);
+		lod.pending_time += delta_time;
+		if (lod.ticks_until_update > 1)
+		{
+			lod.ticks_until_update--;
+			continue;
+		}
+
+		lod.ticks_until_update = lod.divisor;
+		lod.interval = lod.divisor;
+		update_list.push_back((uint32_t)i);
+	}
+
+	// Every controller is independent, so they can all be updated at once.
+	float time_quantum = (pose_cache_settings.phase_bucket > 0.0f) ? pose_cache_settings.phase_bucket : pose_cache_settings.time_quantum;
+	pose_keys.resize(update_list.size());
+	jobs::ParallelFor(update_list.size(), ANIMATOR_BATCH_SIZE, [&](size_t begin, size_t end)
+	{
+		for (size_t j = begin; j < end; ++j)
+		{
+			uint32_t i = update_list[j];
+			AnimationLod& lod = soa.get<ACE_LOD>(i);
+			soa.get<ACE_GRAPH>(i).Update(soa.get<ACE_ANIMCONTROLLER>(i), (float)lod.pending_time);
+			soa.get<ACE_ANIMCONTROLLER>(i).AdvanceTime(lod.pending_time);
+			lod.pending_time = 0.0;
+
+			// A null model in the key means this pose can't be shared.
+			if (pose_cache_settings.enabled == false || soa.get<ACE_ANIMCONTROLLER>(i).getPoseKey(pose_keys[j], time_quantum) == false)
+				{ pose_keys[j].model = nullptr; }
+		}
+	});
+
+	// Events are gathered up afterwards, in the same order every time no matter how the work was split up.
+	for (uint32_t i : update_list)
+		{ QueueEvents(i); }
+
+	// The first entity with each key calculates the pose, and everyone else with the same key copies it.
+	pose_cache.clear();
+	unique_poses.clear();
+	shared_poses.clear();
+	for (size_t j = 0; j < update_list.size(); ++j)
+	{
+		uint32_t i = update_list[j];
+		if (pose_keys[j].model == nullptr)
+		{
+			unique_poses.push_back(i);
+			continue;
+		}
+
+		auto inserted = pose_cache.emplace(pose_keys[j], i);
+		if (inserted.second)
+			{ unique_poses.push_back(i); }
+		else
+			{ shared_poses.push_back({ i, inserted.first->second }); }
+	}
+
+	jobs::ParallelFor(unique_poses.size(), ANIMATOR_BATCH_SIZE, [&](size_t begin, size_t end)
+	{
+		for (size_t j = begin; j < end; ++j)
+			{ soa.get<ACE_ANIMCONTROLLER>(unique_poses[j]).CalcPose(); }
+	});
 
-		vmath::mat4 transform = vmath::mat4::translation(entity::transform::getPos(id)) *
-								vmath::mat4::rotation(entity::transform::getRot(id)) *
-								vmath::mat4::scale(entity::transform::getScale(id));
+	jobs::ParallelFor(shared_poses.size(), ANIMATOR_BATCH_SIZE, [&](size_t begin, size_t end)
+	{
+		for (size_t j = begin; j < end; ++j)
+			{ soa.get<ACE_ANIMCONTROLLER>(shared_poses[j].first).CopyPose(soa.get<ACE_ANIMCONTROLLER>(shared_poses[j].second)); }
+	});
 
-		std::vector<const char*> events = soa.get<ACE_ANIMCONTROLLER>(i).CalcNextFrame(transform, delta_time);
+	// IK goes on top of the finished pose, shared or not.  Every chain only touches its own controller, so they're solved in one batch.
+	ik_list.clear();
+	for (uint32_t i : update_list)
+	{
+		if (soa.get<ACE_ANIMCONTROLLER>(i).hasIK())
+			{ ik_list.push_back(i); }
 	}
-	// TODO: Actually handle animation events!
+	jobs::ParallelFor(ik_list.size(), ANIMATOR_BATCH_SIZE, [&](size_t begin, size_t end)
+	{
+		for (size_t j = begin; j < end; ++j)
+			{ soa.get<ACE_ANIMCONTROLLER>(ik_list[j]).SolveIK(root_transforms[ik_list[j]]); }
+	});
+
+	// Bullet isn't thread safe, so hitboxes are moved afterwards, one at a time.
+	// Even entities which weren't updated have to move their hitboxes along with them, or they'd be left behind.
+	for (size_t i = 1; i < soa.size(); ++i)
+		{ soa.get<ACE_ANIMCONTROLLER>(i).ApplyMotionStates(root_transforms[i]); }
+
+	// Scripts only hear about events once everything is in place, in case they want to look at the pose.
+	DispatchEvents();
 }
 
-void AnimatorComponent::getAnimatedTransform(entity::ID id, const char* bone_name, vmath::vec3& out_position, vmath::quat& out_rotation)
+void AnimatorComponent::QueueEvents(size_t i)
+{
+	const AnimationEventList& events = soa.get<ACE_ANIMCONTROLLER>(i).getEvents();
+	dropped_events += events.dropped;
+	for (uint32_t j = 0; j < events.count; ++j)
+	{
+		if (event_queue.push_back({ soa.get<ACE_ENTITYID>(i), events.events[j] }) == false)
+			{ dropped_events++; }
+	}
+}
+
+void AnimatorComponent::UpdateNow(entity::ID id)
+{
+	if (hasEntry(id) == false)
+		return;
+
+	AnimationLod& lod = soa.get<ACE_LOD>(index(id));
+	if (lod.pending_time <= 0.0)
+		return;
+
+	// This doesn't change the schedule; the next regular update just has less time to catch up on.
+	vmath::mat4 root_transform = getRootTransform(id);
+	soa.get<ACE_GRAPH>(index(id)).Update(soa.get<ACE_ANIMCONTROLLER>(index(id)), (float)lod.pending_time);
+	soa.get<ACE_ANIMCONTROLLER>(index(id)).CalcNextFrame(root_transform, lod.pending_time);
+	QueueEvents(index(id));
+	soa.get<ACE_ANIMCONTROLLER>(index(id)).ApplyMotionStates(root_transform);
+	lod.pending_time = 0.0;
+}
+
+void AnimatorComponent::getSkinnedVertices(entity::ID id, std::vector<vmath::vec3>& out_positions, std::vector<vmath::vec3>* out_normals, bool multithreaded)
+{
+	out_positions.clear();
+	if (out_normals != nullptr)
+		{ out_normals->clear(); }
+	if (hasEntry(id) == false)
+		return;
+
+	AnimationController& controller = soa.get<ACE_ANIMCONTROLLER>(index(id));
+	Model* model = controller.getModel();
+	if (model == nullptr || model->getVertexPositions() == nullptr || model->getVertexSkin() == nullptr)
+		return;
+
+	// Use the latest logical frame rather than whatever the display last interpolated (if it ran at all).
+	UpdateNow(id);
+	controller.CalcMatrices(1.0f);
+
+	std::vector<vmath::vec3> normals;
+	if (out_normals != nullptr)
+		{ model->getVertexNormals(normals); }
+
+	size_t num_vertices = (size_t)model->numVertices();
+	out_positions.resize(num_vertices);
+	if (out_normals != nullptr && normals.empty() == false)
+		{ out_normals->resize(num_vertices); }
+
+	SkinVertices(model->getVertexPositions(), normals.empty() ? nullptr : normals.data(), model->getVertexSkin(), num_vertices,
+		controller.getFinalMatrices(), out_positions.data(), (out_normals != nullptr && normals.empty() == false) ? out_normals->data() : nullptr, multithreaded);
+}
+
+void AnimatorComponent::SelectLod(size_t i, Model* model, const UniformBufferCamera& camera, const vmath::vec4 frustum[6])
+{
+	AnimationLod& lod = soa.get<ACE_LOD>(i);
+
+	// Bring the model's bounding sphere into world space, the same way the renderable component does.
+	vmath::mat4 matrix = entity::transform::getMatrix(soa.get<ACE_ENTITYID>(i));
+	vmath::vec3 center = (matrix * vmath::vec4(model->getBoundsCenter(), 1.0f)).xyz;
+	vmath::vec3 scale = matrix.extract_scale();
+	float radius = model->getBoundsRadius() * fmaxf(scale.x, fmaxf(scale.y, scale.z)) * lod_settings.bounds_margin;
+	float distance = vmath::vec3::distance(center, camera.eye_pos.xyz);
+
+	lod.visible = (lod_settings.cull_offscreen == false || SphereInFrustum(frustum, center, radius));
+
+	if (lod_settings.by_distance)
+	{
+		// Distance works just like screen size, if everything is the same size and the projection is the same for everyone.
+		float thresholds[ANIM_LOD_LEVELS];
+		for (int level = 0; level < ANIM_LOD_LEVELS; ++level)
+			{ thresholds[level] = (lod_settings.distance[level] > 0.0f) ? (1.0f / lod_settings.distance[level]) : 1.0f; }
+		lod.level = lod::Select((distance > 0.0f) ? (1.0f / distance) : 1.0f, thresholds, ANIM_LOD_LEVELS, lod.level);
+	}
+	else
+	{
+		float screen_size = lod::ProjectedSize(radius, distance, camera.proj.at(1, 1));
+		lod.level = lod::Select(screen_size, lod_settings.screen_size, ANIM_LOD_LEVELS, lod.level);
+	}
+
+	uint32_t divisor = lod.visible ? lod_settings.divisor[lod.level] : lod_settings.offscreen_divisor;
+	if (divisor < 1)
+		{ divisor = 1; }
+	if (divisor != lod.divisor)
+	{
+		// Spread entities out across the frames in between updates, so they don't all land on the same one.
+		lod.divisor = divisor;
+		uint32_t staggered = 1 + (soa.get<ACE_ENTITYID>(i) % divisor);
+		if (lod.ticks_until_update > staggered)
+			{ lod.ticks_until_update = staggered; }
+	}
+}
+
+float AnimatorComponent::getLodInterpolation(size_t index, float interpolation)
+{
+	// Entities which update less often interpolate across every frame in between updates, instead of just the last one.
+	const AnimationLod& lod = soa.get<ACE_LOD>(index);
+	uint32_t elapsed = (lod.interval > lod.ticks_until_update) ? (lod.interval - lod.ticks_until_update) : 0;
+	return fminf(((float)elapsed + interpolation) / (float)lod.interval, 1.0f);
+}
+
+void AnimatorComponent::DisplayUpdate(float interpolation, const UniformBufferCamera* camera)
+{
+	// Picking levels is cheap, so it's done here where the camera is known, and takes effect from the next logical frame.
+	vmath::vec4 frustum[6];
+	if (camera != nullptr)
+		{ ExtractFrustumPlanes(camera->projview, frustum); }
+
+	for (size_t i = 1; i < soa.size(); ++i)
+	{
+		AnimationLod& lod = soa.get<ACE_LOD>(i);
+		Model* model = soa.get<ACE_ANIMCONTROLLER>(i).getModel();
+		if (camera == nullptr || model == nullptr || lod_settings.enabled == false || lod.enabled == false)
+		{
+			lod.level = 0;
+			lod.divisor = 1;
+			lod.visible = true;
+			if (lod.ticks_until_update > 1)
+				{ lod.ticks_until_update = 1; }
+		}
+		else
+			{ SelectLod(i, model, *camera, frustum); }
+	}
+
+	jobs::ParallelFor(soa.size() - 1, ANIMATOR_BATCH_SIZE, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin + 1; i < end + 1; ++i)
+		{
+			const AnimationLod& lod = soa.get<ACE_LOD>(i);
+			if (lod.visible == false)
+				continue;
+
+			soa.get<ACE_ANIMCONTROLLER>(i).CalcMatrices(getLodInterpolation(i, interpolation));
+		}
+	});
+}
+
+bool AnimatorComponent::setAnimGraph(entity::ID id, const char* name)
+{
+	if (hasEntry(id) == false)
+		return false;
+
+	AnimationGraphInstance& instance = soa.get<ACE_GRAPH>(index(id));
+	AnimationController& controller = soa.get<ACE_ANIMCONTROLLER>(index(id));
+	if (instance.graph)
+	{
+		AnimationGraph::Unload(instance.graph_name.c_str);
+		instance = AnimationGraphInstance();
+		controller.setHoldFinishedLayers(false);
+	}
+
+	if (name == nullptr || name[0] == '\0')
+		return true;
+
+	instance.graph = AnimationGraph::Load(name);
+	if (instance.graph == nullptr)
+		return false;
+
+	instance.graph_name = name;
+	instance.Start(controller);
+	return true;
+}
+
+int32_t AnimatorComponent::getAnimParamHandle(entity::ID id, const char* param_name)
+{
+	if (hasEntry(id) == false || param_name == nullptr)
+		return -1;
+
+	AnimationGraph* graph = soa.get<ACE_GRAPH>(index(id)).graph;
+	return (graph != nullptr) ? graph->findParameter(param_name) : -1;
+}
+
+void AnimatorComponent::setAnimParam(entity::ID id, int32_t param, float val)
+{
+	if (hasEntry(id) == false)
+		return;
+
+	AnimationGraphInstance& instance = soa.get<ACE_GRAPH>(index(id));
+	if (param >= 0 && (size_t)param < instance.params.size())
+		{ instance.params[param] = val; }
+}
+
+float AnimatorComponent::getAnimParam(entity::ID id, int32_t param)
+{
+	if (hasEntry(id) == false)
+		return 0.0f;
+
+	AnimationGraphInstance& instance = soa.get<ACE_GRAPH>(index(id));
+	if (param >= 0 && (size_t)param < instance.params.size())
+		return instance.params[param];
+	else
+		return 0.0f;
+}
+
+const char* AnimatorComponent::getAnimState(entity::ID id)
+{
+	if (hasEntry(id) == false)
+		return "";
+
+	AnimationGraphInstance& instance = soa.get<ACE_GRAPH>(index(id));
+	if (instance.graph == nullptr || instance.state < 0)
+		return "";
+	else
+		return instance.graph->getState(instance.state).name.c_str;
+}
+
+bool AnimatorComponent::setAnimState(entity::ID id, const char* state_name, float transition)
+{
+	if (hasEntry(id) == false)
+		return false;
+
+	return soa.get<ACE_GRAPH>(index(id)).setState(soa.get<ACE_ANIMCONTROLLER>(index(id)), state_name, transition);
+}
+
+int32_t AnimatorComponent::getBoneHandle(entity::ID id, const char* bone_name)
+{
+	if (hasEntry(id) == false || rc.hasEntry(id) == false || bone_name == nullptr)
+		return -1;
+
+	Model* model = rc.getModelPtr(id);
+	if (model == nullptr)
+		return -1;
+
+	auto it = model->getSkeleton().bone_map.find(bone_name);
+	if (it == model->getSkeleton().bone_map.end())
+		return -1;
+
+	return it->second;
+}
+
+void AnimatorComponent::getAnimatedTransform(entity::ID id, int32_t bone, vmath::vec3& out_position, vmath::quat& out_rotation)
 {
 	if (hasEntry(id) == false || rc.hasEntry(id) == false)
 		return;
 
-	vmath::mat4 transform = vmath::mat4::translation(entity::transform::getPos(id)) *
-							vmath::mat4::rotation(entity::transform::getRot(id)) *
-							vmath::mat4::scale(entity::transform::getScale(id));
+	// Gameplay wants to know where the bone is now, not where it was the last time this entity was updated.
+	UpdateNow(id);
+	vmath::mat4 transform = getRootTransform(id);
+
+	soa.get<ACE_ANIMCONTROLLER>(index(id)).getAnimatedBoneTransform(bone, out_position, out_rotation, transform);
+}
+
+vmath::mat4 AnimatorComponent::getBoneMatrix(entity::ID id, int32_t bone, float interpolation)
+{
+	if (hasEntry(id) == false)
+		return vmath::MAT4_IDENTITY;
 
-	int bone_index = rc.getModelPtr(id)->getSkeleton().bone_map.at(bone_name);
-	soa.get<ACE_ANIMCONTROLLER>(index(id)).getAnimatedBoneTransform(bone_index, out_position, out_rotation, transform);
+	return soa.get<ACE_ANIMCONTROLLER>(index(id)).getBoneMatrix(bone, getLodInterpolation(index(id), interpolation));
 }
 
-void AnimatorComponent::setBoneAdditivePosition(entity::ID id, const char* bone_name, vmath::vec3 position)
+void AnimatorComponent::setBoneAdditivePosition(entity::ID id, int32_t bone, vmath::vec3 position)
 {
 	if (hasEntry(id) == false || rc.hasEntry(id) == false)
 		return;
 
-	int bone_index = rc.getModelPtr(id)->getSkeleton().bone_map.at(bone_name);
-	soa.get<ACE_ANIMCONTROLLER>(index(id)).setBoneAdditivePosition(bone_index, position);
+	soa.get<ACE_ANIMCONTROLLER>(index(id)).setBoneAdditivePosition(bone, position);
 }
 
-void AnimatorComponent::setBoneAdditivePositionLocal(entity::ID id, const char* bone_name, vmath::vec3 position)
+void AnimatorComponent::setBoneAdditivePositionLocal(entity::ID id, int32_t bone, vmath::vec3 position)
 {
 	if (hasEntry(id) == false || rc.hasEntry(id) == false)
 		return;
 
-	int bone_index = rc.getModelPtr(id)->getSkeleton().bone_map.at(bone_name);
-	soa.get<ACE_ANIMCONTROLLER>(index(id)).setBoneAdditivePositionLocal(bone_index, position);
+	soa.get<ACE_ANIMCONTROLLER>(index(id)).setBoneAdditivePositionLocal(bone, position);
 }
 
-vmath::vec3 AnimatorComponent::getBoneAdditivePosition(entity::ID id, const char* bone_name)
+vmath::vec3 AnimatorComponent::getBoneAdditivePosition(entity::ID id, int32_t bone)
 {
 	if (hasEntry(id) == false || rc.hasEntry(id) == false)
 		return vmath::VEC3_ZERO;
 
-	int bone_index = rc.getModelPtr(id)->getSkeleton().bone_map.at(bone_name);
-	return soa.get<ACE_ANIMCONTROLLER>(index(id)).getBoneAdditivePosition(bone_index);
+	return soa.get<ACE_ANIMCONTROLLER>(index(id)).getBoneAdditivePosition(bone);
 }
 
 void AnimatorComponent::ClearAdditivePositions(entity::ID id)
@@ -73,31 +453,28 @@ void AnimatorComponent::ClearAdditivePositions(entity::ID id)
 }
 
 
-void AnimatorComponent::setBoneAdditiveRotation(entity::ID id, const char* bone_name, vmath::quat rotation)
+void AnimatorComponent::setBoneAdditiveRotation(entity::ID id, int32_t bone, vmath::quat rotation)
 {
 	if (hasEntry(id) == false || rc.hasEntry(id) == false)
 		return;
 
-	int bone_index = rc.getModelPtr(id)->getSkeleton().bone_map.at(bone_name);
-	soa.get<ACE_ANIMCONTROLLER>(index(id)).setBoneAdditiveRotation(bone_index, rotation);
+	soa.get<ACE_ANIMCONTROLLER>(index(id)).setBoneAdditiveRotation(bone, rotation);
 }
 
-void AnimatorComponent::setBoneAdditiveRotationLocal(entity::ID id, const char* bone_name, vmath::quat rotation)
+void AnimatorComponent::setBoneAdditiveRotationLocal(entity::ID id, int32_t bone, vmath::quat rotation)
 {
 	if (hasEntry(id) == false || rc.hasEntry(id) == false)
 		return;
 
-	int bone_index = rc.getModelPtr(id)->getSkeleton().bone_map.at(bone_name);
-	soa.get<ACE_ANIMCONTROLLER>(index(id)).setBoneAdditiveRotationLocal(bone_index, rotation);
+	soa.get<ACE_ANIMCONTROLLER>(index(id)).setBoneAdditiveRotationLocal(bone, rotation);
 }
 
-vmath::quat AnimatorComponent::getBoneAdditiveRotation(entity::ID id, const char* bone_name)
+vmath::quat AnimatorComponent::getBoneAdditiveRotation(entity::ID id, int32_t bone)
 {
 	if (hasEntry(id) == false || rc.hasEntry(id) == false)
 		return vmath::QUAT_IDENTITY;
 
-	int bone_index = rc.getModelPtr(id)->getSkeleton().bone_map.at(bone_name);
-	return soa.get<ACE_ANIMCONTROLLER>(index(id)).getBoneAdditiveRotation(bone_index);
+	return soa.get<ACE_ANIMCONTROLLER>(index(id)).getBoneAdditiveRotation(bone);
 }
 
 void AnimatorComponent::ClearAdditiveRotations(entity::ID id)
@@ -113,9 +490,7 @@ void AnimatorComponent::DrawDebug(entity::ID id)
 	if (hasEntry(id) == false || rc.hasEntry(id) == false)
 		return;
 
-	vmath::mat4 transform = vmath::mat4::translation(entity::transform::getPos(id)) *
-							vmath::mat4::rotation(entity::transform::getRot(id)) *
-							vmath::mat4::scale(entity::transform::getScale(id));
+	vmath::mat4 transform = getRootTransform(id);
 
 	Model* model = rc.getModelPtr(id);
 
@@ -4,25 +4,92 @@
 #include "component.h"
 #include "renderable.h"
 #include "graphics/animation_controller.h"
+#include "graphics/animation_graph.h"
+#include "tools/ringbuffer.h"
+
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 class PhysicsSystem;
+struct UniformBufferCamera;
+
+constexpr const int ANIM_LOD_LEVELS = 4;
+
+// Controls how often animations are updated according to how much of the screen they cover.
+// Level 0 is updated every logical frame, and each level after it every 'divisor' logical frames.
+struct AnimationLodSettings
+{
+	bool enabled = true;
+
+	// Levels are chosen either by screen size (as in graphics/lod.h) or by distance from the camera.
+	bool by_distance = false;
+	float screen_size[ANIM_LOD_LEVELS] = { 1.0f, 0.25f, 0.1f, 0.04f };
+	float distance[ANIM_LOD_LEVELS] = { 0.0f, 20.0f, 40.0f, 80.0f };
+	uint32_t divisor[ANIM_LOD_LEVELS] = { 1, 2, 3, 6 };
+
+	// Entities outside of the view frustum skip their matrix interpolation, and update at 'offscreen_divisor'.
+	// This is off by default, since characters outside of the view can still cast shadows into it.
+	bool cull_offscreen = false;
+	uint32_t offscreen_divisor = 6;
+
+	// Animated models can reach well outside of their bind pose's bounds, so the bounds are grown by this much when culling.
+	float bounds_margin = 1.5f;
+};
+
+// Controls when entities can share a pose instead of each calculating their own.
+// Entities playing the same animations on the same model at (nearly) the same time only calculate the pose once per frame.
+struct AnimationPoseCacheSettings
+{
+	bool enabled = true;
+
+	// Animation times closer than this are treated as equal.
+	float time_quantum = 1.0f / 240.0f;
+
+	// If this is more than zero, it's used instead of 'time_quantum', so that crowds of entities which started their
+	// animations at slightly different times still share poses.  This trades accuracy for speed, so it's off by default.
+	float phase_bucket = 0.0f;
+};
+
+// The most animation events which can be waiting to be sent to scripts at once.
+constexpr const size_t ANIM_EVENT_QUEUE_SIZE = 1024;
+
+struct AnimationEventRecord
+{
+	entity::ID entity;
+	AnimationEvent event;
+};
+
+// Each entity's place in the update schedule.
+struct AnimationLod
+{
+	int32_t level = 0;
+	uint32_t divisor = 1;
+	uint32_t interval = 1; // The divisor in effect at the last update, which the display interpolates across.
+	uint32_t ticks_until_update = 1;
+	double pending_time = 0.0; // Time which has passed since the last update.
+	bool visible = true;
+	bool enabled = true;
+};
 
 enum AnimatorComponentEnum
 {
 	ACE_ENTITYID = 0,
-	ACE_ANIMCONTROLLER
+	ACE_ANIMCONTROLLER,
+	ACE_LOD,
+	ACE_GRAPH
 };
 
-class AnimatorComponent : protected ComponentTable<AnimationController>
+class AnimatorComponent : protected ComponentTable<AnimationController, AnimationLod, AnimationGraphInstance>
 {
 public:
 	AnimatorComponent(RenderableComponent& rc)
-	:	ComponentTable<AnimationController>({ nullptr, {} }),
+	:	ComponentTable<AnimationController, AnimationLod, AnimationGraphInstance>({ nullptr, {} }, AnimationLod(), AnimationGraphInstance()),
 		rc(rc), ps(ps)
 		{}
-	~AnimatorComponent() {}
+	~AnimatorComponent();
 
-	using ComponentTable<AnimationController>::hasEntry;
+	using ComponentTable<AnimationController, AnimationLod, AnimationGraphInstance>::hasEntry;
 
 	void AddTo(entity::ID id)
 	{
@@ -39,10 +106,10 @@ public:
 			return;
 		}
 
-		AddEntry(id, {modelptr, id});
+		AddEntry(id, {modelptr, id}, AnimationLod(), AnimationGraphInstance());
 	}
 
-	using ComponentTable<AnimationController>::RemoveEntry;
+	void Remove(entity::ID id);
 
 	void ImportAnimations(entity::ID id, const char* filename);
 
@@ -72,36 +139,124 @@ public:
 	float getAnimLayerWeight(entity::ID id, int layer)
 		{ return soa.get<ACE_ANIMCONTROLLER>(index(id)).getAnimLayerWeight(layer); }
 
-	void getAnimatedTransform(entity::ID id, const char* bone_name, vmath::vec3& out_position, vmath::quat& out_rotation);
+	/* Hands the entity's animation over to a graph (see graphics/animation_graph.h), which takes over every layer of its controller. */
+	/* Scripts only need to set the graph's parameters from then on.  An empty name takes the graph away again. */
+	bool setAnimGraph(entity::ID id, const char* name);
+	const char* getAnimGraph(entity::ID id)
+		{ if (hasEntry(id) && soa.get<ACE_GRAPH>(index(id)).graph) return soa.get<ACE_GRAPH>(index(id)).graph_name.c_str; else return ""; }
+
+	/* Returns a handle to the named graph parameter, or -1 if the entity's graph doesn't have one.  Like bone handles, these can be kept. */
+	int32_t getAnimParamHandle(entity::ID id, const char* param_name);
+	void setAnimParam(entity::ID id, int32_t param, float val);
+	void setAnimParam(entity::ID id, const char* param_name, float val)
+		{ setAnimParam(id, getAnimParamHandle(id, param_name), val); }
+	float getAnimParam(entity::ID id, int32_t param);
+	float getAnimParam(entity::ID id, const char* param_name)
+		{ return getAnimParam(id, getAnimParamHandle(id, param_name)); }
+
+	/* Returns the name of the graph state the entity is in, or an empty string if it doesn't have a graph. */
+	const char* getAnimState(entity::ID id);
+	/* Moves the entity's graph straight to a state, without waiting for a transition. */
+	bool setAnimState(entity::ID id, const char* state_name, float transition = 0.0f);
 
-	void setBoneAdditivePosition(entity::ID id, const char* bone_name, vmath::vec3 position);
-	void setBoneAdditivePositionLocal(entity::ID id, const char* bone_name, vmath::vec3 position);
-	vmath::vec3 getBoneAdditivePosition(entity::ID id, const char* bone_name);
+	/* Returns a handle to the named bone in the entity's skeleton, or -1 if it has no such bone. */
+	/* Handles are bone indices, so they stay valid for every entity using the same model, and can be used without looking up the name again. */
+	int32_t getBoneHandle(entity::ID id, const char* bone_name);
+
+	void getAnimatedTransform(entity::ID id, int32_t bone, vmath::vec3& out_position, vmath::quat& out_rotation);
+
+	/* Returns where the bone is in the space of the entity's transform, as of this display frame.  Transforms attached to bones follow this. */
+	vmath::mat4 getBoneMatrix(entity::ID id, int32_t bone, float interpolation);
+	void getAnimatedTransform(entity::ID id, const char* bone_name, vmath::vec3& out_position, vmath::quat& out_rotation)
+		{ getAnimatedTransform(id, getBoneHandle(id, bone_name), out_position, out_rotation); }
+
+	void setBoneAdditivePosition(entity::ID id, int32_t bone, vmath::vec3 position);
+	void setBoneAdditivePosition(entity::ID id, const char* bone_name, vmath::vec3 position)
+		{ setBoneAdditivePosition(id, getBoneHandle(id, bone_name), position); }
+	void setBoneAdditivePositionLocal(entity::ID id, int32_t bone, vmath::vec3 position);
+	void setBoneAdditivePositionLocal(entity::ID id, const char* bone_name, vmath::vec3 position)
+		{ setBoneAdditivePositionLocal(id, getBoneHandle(id, bone_name), position); }
+	vmath::vec3 getBoneAdditivePosition(entity::ID id, int32_t bone);
+	vmath::vec3 getBoneAdditivePosition(entity::ID id, const char* bone_name)
+		{ return getBoneAdditivePosition(id, getBoneHandle(id, bone_name)); }
 	void ClearAdditivePositions(entity::ID id);
 
-	void setBoneAdditiveRotation(entity::ID id, const char* bone_name, vmath::quat rotation);
-	void setBoneAdditiveRotationLocal(entity::ID id, const char* bone_name, vmath::quat rotation);
-	vmath::quat getBoneAdditiveRotation(entity::ID id, const char* bone_name);
+	void setBoneAdditiveRotation(entity::ID id, int32_t bone, vmath::quat rotation);
+	void setBoneAdditiveRotation(entity::ID id, const char* bone_name, vmath::quat rotation)
+		{ setBoneAdditiveRotation(id, getBoneHandle(id, bone_name), rotation); }
+	void setBoneAdditiveRotationLocal(entity::ID id, int32_t bone, vmath::quat rotation);
+	void setBoneAdditiveRotationLocal(entity::ID id, const char* bone_name, vmath::quat rotation)
+		{ setBoneAdditiveRotationLocal(id, getBoneHandle(id, bone_name), rotation); }
+	vmath::quat getBoneAdditiveRotation(entity::ID id, int32_t bone);
+	vmath::quat getBoneAdditiveRotation(entity::ID id, const char* bone_name)
+		{ return getBoneAdditiveRotation(id, getBoneHandle(id, bone_name)); }
 	void ClearAdditiveRotations(entity::ID id);
 
+	/* Adds an IK chain to the entity, made of bone handles listed from the root of the chain to its tip (see graphics/animation_ik.h). */
+	/* Returns a handle to the chain, or -1 if the bones don't fit the solver.  Chains are solved after the entity's pose, every time it's updated. */
+	int32_t AddIKChain(entity::ID id, IKSolverEnum solver, const int32_t* bones, int32_t num_bones)
+		{ if (hasEntry(id)) return soa.get<ACE_ANIMCONTROLLER>(index(id)).AddIKChain(solver, bones, num_bones); else return -1; }
+	/* Targets and poles are in world space. */
+	void setIKTarget(entity::ID id, int32_t chain, vmath::vec3 target, float weight = 1.0f)
+		{ if (hasEntry(id)) soa.get<ACE_ANIMCONTROLLER>(index(id)).setIKTarget(chain, target, weight); }
+	void setIKPole(entity::ID id, int32_t chain, vmath::vec3 pole)
+		{ if (hasEntry(id)) soa.get<ACE_ANIMCONTROLLER>(index(id)).setIKPole(chain, pole); }
+	void ClearIKPole(entity::ID id, int32_t chain)
+		{ if (hasEntry(id)) soa.get<ACE_ANIMCONTROLLER>(index(id)).ClearIKPole(chain); }
+	void setIKWeight(entity::ID id, int32_t chain, float weight)
+		{ if (hasEntry(id)) soa.get<ACE_ANIMCONTROLLER>(index(id)).setIKWeight(chain, weight); }
+	float getIKWeight(entity::ID id, int32_t chain)
+		{ if (hasEntry(id)) return soa.get<ACE_ANIMCONTROLLER>(index(id)).getIKWeight(chain); else return 0.0f; }
+	void setIKLookAtAxis(entity::ID id, int32_t chain, vmath::vec3 axis, float max_angle = PI)
+		{ if (hasEntry(id)) soa.get<ACE_ANIMCONTROLLER>(index(id)).setIKLookAtAxis(chain, axis, max_angle); }
+	void ClearIKChains(entity::ID id)
+		{ if (hasEntry(id)) soa.get<ACE_ANIMCONTROLLER>(index(id)).ClearIKChains(); }
+
 	void DrawDebug(entity::ID id);
 
+	const AnimationLodSettings& getLodSettings()
+		{ return lod_settings; }
+	void setLodSettings(const AnimationLodSettings& settings)
+		{ lod_settings = settings; }
+
+	/* Turns level of detail on or off for one entity.  Entities without it are updated every frame, on screen or not. */
+	void setLodEnabled(entity::ID id, bool val)
+		{ if (hasEntry(id)) soa.get<ACE_LOD>(index(id)).enabled = val; }
+	bool isLodEnabled(entity::ID id)
+		{ return soa.get<ACE_LOD>(index(id)).enabled; }
+
+	const AnimationPoseCacheSettings& getPoseCacheSettings()
+		{ return pose_cache_settings; }
+	void setPoseCacheSettings(const AnimationPoseCacheSettings& settings)
+		{ pose_cache_settings = settings; }
+
+	/* Returns how many entities borrowed another's pose during the last logical frame. */
+	size_t getNumSharedPoses()
+		{ return shared_poses.size(); }
+
+	/* Skins the entity's model on the CPU using its latest pose, in the model's space.  'out_normals' can be null. */
+	/* This recalculates the entity's final matrices, so call it outside of the display update. */
+	void getSkinnedVertices(entity::ID id, std::vector<vmath::vec3>& out_positions, std::vector<vmath::vec3>* out_normals = nullptr, bool multithreaded = false);
+
+	/* Brings an entity's pose (and its hitboxes) up to date right now, if it skipped any updates because of its level of detail. */
+	void UpdateNow(entity::ID id);
 
 	void Flip()
 	{
+		// Entities which aren't due for an update keep the last two poses they calculated, so the display can keep interpolating between them.
 		for (size_t i = 1; i < soa.size(); ++i)
-			{ soa.get<ACE_ANIMCONTROLLER>(i).Flip(); }
+		{
+			if (soa.get<ACE_LOD>(i).ticks_until_update <= 1)
+				{ soa.get<ACE_ANIMCONTROLLER>(i).Flip(); }
+		}
 	}
 
 	void LogicalUpdate(double delta_time = (1.0 / 30.0));
 
 	void ApplyRagdolls();
 
-	void DisplayUpdate(float interpolation)
-	{
-		for (size_t i = 1; i < soa.size(); ++i)
-			{ soa.get<ACE_ANIMCONTROLLER>(i).CalcMatrices(interpolation); }
-	}
+	/* Interpolates every visible entity's bone matrices.  Without a camera, every entity counts as visible. */
+	void DisplayUpdate(float interpolation, const UniformBufferCamera* camera = nullptr);
 
 	void UploadSkeleton(entity::ID id)
 		{ soa.get<ACE_ANIMCONTROLLER>(index(id)).UploadMatrices(); }
@@ -111,6 +266,38 @@ public:
 private:
 	RenderableComponent& rc;
 	PhysicsSystem& ps;
+
+	AnimationLodSettings lod_settings;
+
+	// Events raised this frame, grouped by entity, waiting to be sent to scripts.
+	RingBuffer<AnimationEventRecord, ANIM_EVENT_QUEUE_SIZE> event_queue;
+	size_t dropped_events = 0;
+	void QueueEvents(size_t index);
+	// Sends each entity's events to EVENTS.animation_event in one call.  Defined in animator_lua.cpp.
+	void DispatchEvents();
+
+	// Each entity's root transform, gathered up before the controllers are updated in parallel.
+	// Transforms are resolved in one batch, so gathering them is just array reads.
+	std::vector<entity::transform::Index> transform_indices;
+	std::vector<vmath::mat4> root_transforms;
+
+	// The entities which are being updated this frame.
+	std::vector<uint32_t> update_list;
+
+	// Poses calculated this frame, by the first entity to calculate each one.
+	AnimationPoseCacheSettings pose_cache_settings;
+	std::vector<AnimationPoseKey> pose_keys;
+	std::unordered_map<AnimationPoseKey, uint32_t, AnimationPoseKeyHash> pose_cache;
+	std::vector<uint32_t> unique_poses;
+	std::vector<std::pair<uint32_t, uint32_t>> shared_poses; // Which entity is borrowing which entity's pose.
+
+	// The entities being updated this frame which have IK chains to solve.
+	std::vector<uint32_t> ik_list;
+
+	void SelectLod(size_t index, Model* model, const UniformBufferCamera& camera, const vmath::vec4 frustum[6]);
+	float getLodInterpolation(size_t index, float interpolation);
+	vmath::mat4 getRootTransform(entity::ID id);
+	vmath::mat4 getRootTransform(entity::transform::Index transform);
 };
 
 #endif // HVH_WC_SCENE_ANIMATOR_H
\ No newline at end of file
@@ -5,6 +5,36 @@ namespace {
 
 AnimatorComponent* ac = nullptr;
 
+// Bones can be given either by name or by a handle from get_bone_handle, which skips looking up the name.
+int32_t lua_checkbone(lua_State* L, entity::ID id, int arg)
+{
+	if (lua_type(L, arg) == LUA_TNUMBER)
+		return (int32_t)lua_tointeger(L, arg);
+	else
+		return ac->getBoneHandle(id, luaL_checkstring(L, arg));
+}
+
+// Graph parameters work the same way, with handles from get_anim_param_handle.
+int32_t lua_checkparam(lua_State* L, entity::ID id, int arg)
+{
+	if (lua_type(L, arg) == LUA_TNUMBER)
+		return (int32_t)lua_tointeger(L, arg);
+	else
+		return ac->getAnimParamHandle(id, luaL_checkstring(L, arg));
+}
+
+int lua_entity_getbonehandle(lua_State* L)
+{
+	entity::ID* id = (entity::ID*)luaL_checkudata(L, 1, "entity");
+	const char* bone_name = luaL_checkstring(L, 2);
+	int32_t handle = ac->getBoneHandle(*id, bone_name);
+	if (handle < 0)
+		{ lua_pushnil(L); }
+	else
+		{ lua_pushinteger(L, (lua_Integer)handle); }
+	return 1;
+}
+
 int lua_entity_addanimator(lua_State* L)
 {
 	entity::ID* id = (entity::ID*)luaL_checkudata(L, 1, "entity");
@@ -15,7 +45,7 @@ int lua_entity_addanimator(lua_State* L)
 int lua_entity_removeanimator(lua_State* L)
 {
 	entity::ID* id = (entity::ID*)luaL_checkudata(L, 1, "entity");
-	ac->RemoveEntry(*id);
+	ac->Remove(*id);
 	return 0;
 }
 
@@ -133,7 +163,7 @@ int lua_entity_getanimtimeremaining(lua_State* L)
 int lua_entity_getanimatedtransform(lua_State* L)
 {
 	entity::ID* id = (entity::ID*)luaL_checkudata(L, 1, "entity");
-	const char* bone_name = luaL_checkstring(L, 2);
+	int32_t bone = lua_checkbone(L, *id, 2);
 
 	vmath::vec3* pos = (vmath::vec3*)lua_newuserdata(L, sizeof(vmath::vec3));
 	luaL_getmetatable(L, "vec3"); lua_setmetatable(L, -2);
@@ -143,37 +173,37 @@ int lua_entity_getanimatedtransform(lua_State* L)
 	luaL_getmetatable(L, "quat"); lua_setmetatable(L, -2);
 	*rot = vmath::QUAT_IDENTITY;
 
-	ac->getAnimatedTransform(*id, bone_name, *pos, *rot);
+	ac->getAnimatedTransform(*id, bone, *pos, *rot);
 	return 2;
 }
 
 int lua_entity_setadditiveposition(lua_State* L)
 {
 	entity::ID* id = (entity::ID*)luaL_checkudata(L, 1, "entity");
-	const char* bone_name = luaL_checkstring(L, 2);
+	int32_t bone = lua_checkbone(L, *id, 2);
 	vmath::vec3* pos = (vmath::vec3*)luaL_checkudata(L, 3, "vec3");
-	ac->setBoneAdditivePosition(*id, bone_name, *pos);
+	ac->setBoneAdditivePosition(*id, bone, *pos);
 	return 0;
 }
 
 int lua_entity_setadditivepositionlocal(lua_State* L)
 {
 	entity::ID* id = (entity::ID*)luaL_checkudata(L, 1, "entity");
-	const char* bone_name = luaL_checkstring(L, 2);
+	int32_t bone = lua_checkbone(L, *id, 2);
 	vmath::vec3* pos = (vmath::vec3*)luaL_checkudata(L, 3, "vec3");
-	ac->setBoneAdditivePositionLocal(*id, bone_name, *pos);
+	ac->setBoneAdditivePositionLocal(*id, bone, *pos);
 	return 0;
 }
 
 int lua_entity_getadditiveposition(lua_State* L)
 {
 	entity::ID* id = (entity::ID*)luaL_checkudata(L, 1, "entity");
-	const char* bone_name = luaL_checkstring(L, 2);
+	int32_t bone = lua_checkbone(L, *id, 2);
 
 	vmath::vec3* pos = (vmath::vec3*)lua_newuserdata(L, sizeof(vmath::vec3));
 	luaL_getmetatable(L, "vec3"); lua_setmetatable(L, -2);
 
-	*pos = ac->getBoneAdditivePosition(*id, bone_name);
+	*pos = ac->getBoneAdditivePosition(*id, bone);
 	return 1;
 }
 
@@ -187,30 +217,30 @@ int lua_entity_clearadditivepositions(lua_State* L)
 int lua_entity_setadditiverotation(lua_State* L)
 {
 	entity::ID* id = (entity::ID*)luaL_checkudata(L, 1, "entity");
-	const char* bone_name = luaL_checkstring(L, 2);
+	int32_t bone = lua_checkbone(L, *id, 2);
 	vmath::quat* rot = (vmath::quat*)luaL_checkudata(L, 3, "quat");
-	ac->setBoneAdditiveRotation(*id, bone_name, *rot);
+	ac->setBoneAdditiveRotation(*id, bone, *rot);
 	return 0;
 }
 
 int lua_entity_setadditiverotationlocal(lua_State* L)
 {
 	entity::ID* id = (entity::ID*)luaL_checkudata(L, 1, "entity");
-	const char* bone_name = luaL_checkstring(L, 2);
+	int32_t bone = lua_checkbone(L, *id, 2);
 	vmath::quat* rot = (vmath::quat*)luaL_checkudata(L, 3, "quat");
-	ac->setBoneAdditiveRotationLocal(*id, bone_name, *rot);
+	ac->setBoneAdditiveRotationLocal(*id, bone, *rot);
 	return 0;
 }
 
 int lua_entity_getadditiverotation(lua_State* L)
 {
 	entity::ID* id = (entity::ID*)luaL_checkudata(L, 1, "entity");
-	const char* bone_name = luaL_checkstring(L, 2);
+	int32_t bone = lua_checkbone(L, *id, 2);
 
 	vmath::quat* rot = (vmath::quat*)lua_newuserdata(L, sizeof(vmath::quat));
 	luaL_getmetatable(L, "quat"); lua_setmetatable(L, -2);
 
-	*rot = ac->getBoneAdditiveRotation(*id, bone_name);
+	*rot = ac->getBoneAdditiveRotation(*id, bone);
 	return 1;
 }
 
@@ -246,8 +276,244 @@ int lua_entity_drawdebug(lua_State* L)
 	return 0;
 }
 
+int lua_entity_setanimgraph(lua_State* L)
+{
+	entity::ID* id = (entity::ID*)luaL_checkudata(L, 1, "entity");
+	const char* name = luaL_optstring(L, 2, "");
+	bool result = ac->setAnimGraph(*id, name);
+	lua_pushboolean(L, result);
+	return 1;
+}
+
+int lua_entity_getanimgraph(lua_State* L)
+{
+	entity::ID* id = (entity::ID*)luaL_checkudata(L, 1, "entity");
+	lua_pushstring(L, ac->getAnimGraph(*id));
+	return 1;
+}
+
+int lua_entity_getanimparamhandle(lua_State* L)
+{
+	entity::ID* id = (entity::ID*)luaL_checkudata(L, 1, "entity");
+	const char* param_name = luaL_checkstring(L, 2);
+	int32_t handle = ac->getAnimParamHandle(*id, param_name);
+	if (handle < 0)
+		{ lua_pushnil(L); }
+	else
+		{ lua_pushinteger(L, (lua_Integer)handle); }
+	return 1;
+}
+
+int lua_entity_setanimparam(lua_State* L)
+{
+	entity::ID* id = (entity::ID*)luaL_checkudata(L, 1, "entity");
+	int32_t param = lua_checkparam(L, *id, 2);
+
+	// Booleans (and triggers) are stored as 1 or 0.
+	float val;
+	if (lua_isboolean(L, 3))
+		{ val = lua_toboolean(L, 3) ? 1.0f : 0.0f; }
+	else
+		{ val = (float)luaL_checknumber(L, 3); }
+
+	ac->setAnimParam(*id, param, val);
+	return 0;
+}
+
+int lua_entity_getanimparam(lua_State* L)
+{
+	entity::ID* id = (entity::ID*)luaL_checkudata(L, 1, "entity");
+	int32_t param = lua_checkparam(L, *id, 2);
+	lua_pushnumber(L, (lua_Number)ac->getAnimParam(*id, param));
+	return 1;
+}
+
+int lua_entity_getanimstate(lua_State* L)
+{
+	entity::ID* id = (entity::ID*)luaL_checkudata(L, 1, "entity");
+	lua_pushstring(L, ac->getAnimState(*id));
+	return 1;
+}
+
+int lua_entity_setanimstate(lua_State* L)
+{
+	entity::ID* id = (entity::ID*)luaL_checkudata(L, 1, "entity");
+	const char* state_name = luaL_checkstring(L, 2);
+	float transition = (float)luaL_optnumber(L, 3, 0.0);
+	bool result = ac->setAnimState(*id, state_name, transition);
+	lua_pushboolean(L, result);
+	return 1;
+}
+
+// entity:add_ik_chain("two_bone" | "look_at" | "fabrik", bone, bone, ...), with bones from the root of the chain to its tip.
+int lua_entity_addikchain(lua_State* L)
+{
+	entity::ID* id = (entity::ID*)luaL_checkudata(L, 1, "entity");
+	const char* solver_name = luaL_checkstring(L, 2);
+
+	IKSolverEnum solver;
+	if (strcmp(solver_name, "two_bone") == 0) solver = IK_SOLVER_TWO_BONE;
+	else if (strcmp(solver_name, "look_at") == 0) solver = IK_SOLVER_LOOK_AT;
+	else if (strcmp(solver_name, "fabrik") == 0) solver = IK_SOLVER_FABRIK;
+	else
+		{ return luaL_error(L, "'%s' is not an IK solver; try 'two_bone', 'look_at', or 'fabrik'.", solver_name); }
+
+	int32_t bones[MAX_IK_CHAIN_BONES];
+	int32_t num_bones = lua_gettop(L) - 2;
+	if (num_bones > MAX_IK_CHAIN_BONES)
+		{ return luaL_error(L, "IK chains can't have more than %d bones.", MAX_IK_CHAIN_BONES); }
+	for (int32_t i = 0; i < num_bones; ++i)
+		{ bones[i] = lua_checkbone(L, *id, 3 + i); }
+
+	int32_t handle = ac->AddIKChain(*id, solver, bones, num_bones);
+	if (handle < 0)
+		{ lua_pushnil(L); }
+	else
+		{ lua_pushinteger(L, (lua_Integer)handle); }
+	return 1;
+}
+
+int lua_entity_setiktarget(lua_State* L)
+{
+	entity::ID* id = (entity::ID*)luaL_checkudata(L, 1, "entity");
+	int32_t chain = (int32_t)luaL_checkinteger(L, 2);
+	vmath::vec3* target = (vmath::vec3*)luaL_checkudata(L, 3, "vec3");
+	float weight = (float)luaL_optnumber(L, 4, 1.0);
+	ac->setIKTarget(*id, chain, *target, weight);
+	return 0;
+}
+
+// Passing nil instead of a position takes the pole away again.
+int lua_entity_setikpole(lua_State* L)
+{
+	entity::ID* id = (entity::ID*)luaL_checkudata(L, 1, "entity");
+	int32_t chain = (int32_t)luaL_checkinteger(L, 2);
+	if (lua_isnoneornil(L, 3))
+		{ ac->ClearIKPole(*id, chain); }
+	else
+		{ ac->setIKPole(*id, chain, *(vmath::vec3*)luaL_checkudata(L, 3, "vec3")); }
+	return 0;
+}
+
+int lua_entity_setikweight(lua_State* L)
+{
+	entity::ID* id = (entity::ID*)luaL_checkudata(L, 1, "entity");
+	int32_t chain = (int32_t)luaL_checkinteger(L, 2);
+	float weight = (float)luaL_checknumber(L, 3);
+	ac->setIKWeight(*id, chain, weight);
+	return 0;
+}
+
+int lua_entity_getikweight(lua_State* L)
+{
+	entity::ID* id = (entity::ID*)luaL_checkudata(L, 1, "entity");
+	int32_t chain = (int32_t)luaL_checkinteger(L, 2);
+	lua_pushnumber(L, (lua_Number)ac->getIKWeight(*id, chain));
+	return 1;
+}
+
+int lua_entity_setiklookataxis(lua_State* L)
+{
+	entity::ID* id = (entity::ID*)luaL_checkudata(L, 1, "entity");
+	int32_t chain = (int32_t)luaL_checkinteger(L, 2);
+	vmath::vec3* axis = (vmath::vec3*)luaL_checkudata(L, 3, "vec3");
+	float max_angle = (float)luaL_optnumber(L, 4, PI);
+	ac->setIKLookAtAxis(*id, chain, *axis, max_angle);
+	return 0;
+}
+
+int lua_entity_clearikchains(lua_State* L)
+{
+	entity::ID* id = (entity::ID*)luaL_checkudata(L, 1, "entity");
+	ac->ClearIKChains(*id);
+	return 0;
+}
+
+// Makes the entity follow one of another entity's bones, like a weapon in a hand.
+int lua_entity_attachtobone(lua_State* L)
+{
+	entity::ID* id = (entity::ID*)luaL_checkudata(L, 1, "entity");
+	entity::ID* parent = (entity::ID*)luaL_checkudata(L, 2, "entity");
+	int32_t bone = lua_checkbone(L, *parent, 3);
+	if (bone < 0)
+		return luaL_error(L, "attach_to_bone() couldn't find the bone.\n");
+
+	entity::transform::setParent(*id, *parent, bone);
+	return 0;
+}
+
+int lua_entity_setanimlodenabled(lua_State* L)
+{
+	entity::ID* id = (entity::ID*)luaL_checkudata(L, 1, "entity");
+	bool val = (lua_toboolean(L, 2) != 0);
+	ac->setLodEnabled(*id, val);
+	return 0;
+}
+
+int lua_entity_updateanimationnow(lua_State* L)
+{
+	entity::ID* id = (entity::ID*)luaL_checkudata(L, 1, "entity");
+	ac->UpdateNow(*id);
+	return 0;
+}
+
 } // namespace <anon>
 
+void AnimatorComponent::DispatchEvents()
+{
+	if (dropped_events > 0)
+	{
+		plog::warning("%i animation events were dropped this frame; too many were raised at once.\n", (int)dropped_events);
+		dropped_events = 0;
+	}
+
+	if (event_queue.empty())
+		return;
+
+	lua_State* L = lua::getLuaState();
+	lua_getglobal(L, "EVENTS");
+	lua_getfield(L, -1, "animation_event");
+	lua_getfield(L, -1, "execute_entity");
+	if (lua_isfunction(L, -1) == false)
+	{
+		lua_pop(L, 3);
+		event_queue.clear();
+		return;
+	}
+
+	// Each entity's events sit next to each other in the queue, so they can be handed over together:
+	// EVENTS.animation_event:execute_entity(index, { event names }, { layers })
+	while (event_queue.empty() == false)
+	{
+		entity::ID id = event_queue.front().entity;
+		size_t count = 0;
+		while (count < event_queue.size() && event_queue[count].entity == id)
+			{ count++; }
+
+		lua_pushvalue(L, -1);
+		lua_pushvalue(L, -3);
+		lua_pushnumber(L, id);
+		lua_createtable(L, (int)count, 0);
+		lua_createtable(L, (int)count, 0);
+		for (size_t j = 0; j < count; ++j)
+		{
+			AnimationEventRecord record;
+			event_queue.pop_front(record);
+			lua_pushstring(L, getAnimationEventName(record.event.id)); lua_rawseti(L, -3, (int)j + 1);
+			lua_pushnumber(L, record.event.layer); lua_rawseti(L, -2, (int)j + 1);
+		}
+
+		if (lua_pcall(L, 4, 0, 0))
+		{
+			plog::error("Error running events.animation_event:execute_entity():\n");
+			plog::errmore("%s\n", lua_tostring(L, -1));
+			lua_pop(L, 1); // pop error
+		}
+	}
+
+	lua_pop(L, 3); // pop EVENTS.animation_event.execute_entity
+}
+
 void AnimatorComponent::InitLua()
 {
 	ac = this;
@@ -267,6 +533,7 @@ void AnimatorComponent::InitLua()
 	 lua_pushcfunction(L, lua_entity_getanimduration); lua_setfield(L, -2, "get_animation_duration");
 	 lua_pushcfunction(L, lua_entity_getanimtime); lua_setfield(L, -2, "get_animation_time");
 	 lua_pushcfunction(L, lua_entity_getanimtimeremaining); lua_setfield(L, -2, "get_animation_time_remaining");
+	 lua_pushcfunction(L, lua_entity_getbonehandle); lua_setfield(L, -2, "get_bone_handle");
 	 lua_pushcfunction(L, lua_entity_getanimatedtransform); lua_setfield(L, -2, "get_animated_transform");
 	 lua_pushcfunction(L, lua_entity_setadditiveposition); lua_setfield(L, -2, "set_bone_additive_position");
 	 lua_pushcfunction(L, lua_entity_setadditivepositionlocal); lua_setfield(L, -2, "set_bone_additive_position_local");
@@ -279,6 +546,23 @@ void AnimatorComponent::InitLua()
 	 lua_pushcfunction(L, lua_entity_setlayerweight); lua_setfield(L, -2, "set_anim_layer_weight");
 	 lua_pushcfunction(L, lua_entity_getlayerweight); lua_setfield(L, -2, "get_anim_layer_weight");
 	 lua_pushcfunction(L, lua_entity_drawdebug); lua_setfield(L, -2, "draw_skeleton_debug");
+	 lua_pushcfunction(L, lua_entity_setanimgraph); lua_setfield(L, -2, "set_anim_graph");
+	 lua_pushcfunction(L, lua_entity_getanimgraph); lua_setfield(L, -2, "get_anim_graph");
+	 lua_pushcfunction(L, lua_entity_getanimparamhandle); lua_setfield(L, -2, "get_anim_param_handle");
+	 lua_pushcfunction(L, lua_entity_setanimparam); lua_setfield(L, -2, "set_anim_param");
+	 lua_pushcfunction(L, lua_entity_getanimparam); lua_setfield(L, -2, "get_anim_param");
+	 lua_pushcfunction(L, lua_entity_getanimstate); lua_setfield(L, -2, "get_anim_state");
+	 lua_pushcfunction(L, lua_entity_setanimstate); lua_setfield(L, -2, "set_anim_state");
+	 lua_pushcfunction(L, lua_entity_addikchain); lua_setfield(L, -2, "add_ik_chain");
+	 lua_pushcfunction(L, lua_entity_setiktarget); lua_setfield(L, -2, "set_ik_target");
+	 lua_pushcfunction(L, lua_entity_setikpole); lua_setfield(L, -2, "set_ik_pole");
+	 lua_pushcfunction(L, lua_entity_setikweight); lua_setfield(L, -2, "set_ik_weight");
+	 lua_pushcfunction(L, lua_entity_getikweight); lua_setfield(L, -2, "get_ik_weight");
+	 lua_pushcfunction(L, lua_entity_setiklookataxis); lua_setfield(L, -2, "set_ik_look_at_axis");
+	 lua_pushcfunction(L, lua_entity_clearikchains); lua_setfield(L, -2, "clear_ik_chains");
+	 lua_pushcfunction(L, lua_entity_attachtobone); lua_setfield(L, -2, "attach_to_bone");
+	 lua_pushcfunction(L, lua_entity_setanimlodenabled); lua_setfield(L, -2, "set_animation_lod_enabled");
+	 lua_pushcfunction(L, lua_entity_updateanimationnow); lua_setfield(L, -2, "update_animation_now");
 
 	lua_pop(L, 1);
 }
\ No newline at end of file
@@ -3,9 +3,13 @@
 
 #include "entity.h"
 #include "tools/structofarrays.h"
+#include "tools/sparsearray.h"
 #include "sys/printlog.h"
-#include <unordered_map>
 
+// Each component's data is kept densely packed in 'soa', one row per entity, with row 0 holding the default state.
+// Entities find their rows through a sparse array indexed by entity index, and the first column of each row gives the entity back.
+// Looking up a row is two array reads, and iterating over 'soa' never touches the sparse array at all.
+// The whole ID is checked against the first column, so an ID left over from a destroyed entity doesn't find its index's new owner.
 template <typename... Ts>
 class ComponentTable
 {
@@ -13,11 +17,11 @@ public:
 
 	void AddEntry(entity::ID id, const Ts&... args)
 	{
-		// Don't add a component to an entity which already has that component.
-		if (hasEntry(id))
+		// Don't add a component to an entity which doesn't exist, or which already has that component.
+		if (entity::isAlive(id) == false || hasEntry(id))
 			return;
 
-		redirect[id] = (uint32_t)soa.size();
+		redirect.set(entity::index(id), (uint32_t)soa.size());
 		soa.push_back(id, args...);
 	}
 
@@ -26,21 +30,20 @@ public:
 		if (!hasEntry(id))
 			return;
 
-		uint32_t index = redirect[id];
+		uint32_t index = redirect.get(entity::index(id));
 
+		// The last row is moved into the removed one's place, so the rows stay packed.
 		entity::ID old_back = soa.get<0>().back();
-		redirect[old_back] = index;
-		redirect.erase(id);
+		redirect.set(entity::index(old_back), index);
+		redirect.reset(entity::index(id));
 
 		soa.erase_swap(index);
 	}
 
 	bool hasEntry(entity::ID id)
 	{
-		if (redirect.count(id) <= 0 || redirect[id] == 0 || redirect[id] >= soa.size())
-			return false;
-		else
-			return true;
+		uint32_t index = redirect.get(entity::index(id));
+		return (index != 0 && index < soa.size() && soa.get<0>(index) == id);
 	}
 
 //protected:
@@ -52,18 +55,19 @@ public:
 
 	uint32_t index(entity::ID id)
 	{
-		if (hasEntry(id) == false)
+		uint32_t result = redirect.get(entity::index(id));
+		if (result == 0 || result >= soa.size() || soa.get<0>(result) != id)
 		{
 			plog::error("Attempting to obtain component index for invalid entity.\n");
 			return 0;
 		}
 		else
-			return redirect[id];
+			return result;
 	}
 
 private:
-	std::unordered_map<entity::ID, uint32_t> redirect;
-//	std::vector<uint32_t> redirect;
+	// Row 0 is never a real entry, so 0 doubles as 'no entry'.
+	SparseArray<uint32_t> redirect;
 };
 
 #endif // HVH_WC_SCENE_COMPONENT_H
\ No newline at end of file
@@ -9,37 +9,53 @@ namespace entity {
 
 namespace {
 
-uint32_t next_index;
-std::vector<ID> free_list;
+// The current generation of every index which has ever been given out.
+// A destroyed entity's generation is moved along right away, so its old ID stops being alive even before the index is reused.
+// Index 0 is never given out, so the null ID is never alive.
+std::vector<uint8_t> generations(1, 0);
+std::vector<uint32_t> free_list;
+
+static_assert(GENERATION_BITS == 8, "Entity generations are stored as bytes.");
 
 } // namespace entity::<anon>
 
 
 ID Create(uint16_t module_id)
 {
-	ID result = 0;
+	uint32_t index;
 	if (free_list.size() > 0)
 	{
-		result = free_list.back();
+		index = free_list.back();
 		free_list.pop_back();
 	}
 	else
 	{
-		if (next_index == 0xfffffff)
+		if (generations.size() > INDEX_MASK)
 		{
 			plog::error("Failed to create entity; index too large!\n");
-			return result;
+			return 0;
 		}
 
-		result = next_index;
-		next_index++;
+		index = (uint32_t)generations.size();
+		generations.push_back(0);
 	}
-	return result;
+	return makeID(index, generations[index]);
 }
 
 void Destroy(ID id)
 {
-	free_list.push_back(id);
+	// Destroying an entity twice would put its index on the free list twice, and hand it out to two different entities.
+	if (isAlive(id) == false)
+		return;
+
+	generations[index(id)]++;
+	free_list.push_back(index(id));
+}
+
+bool isAlive(ID id)
+{
+	uint32_t i = index(id);
+	return (i != 0 && i < generations.size() && generations[i] == generation(id));
 }
 
 std::string toString(ID id)
@@ -48,7 +64,7 @@ std::string toString(ID id)
 		return "<NULL>";
 
 	char str[32];
-	snprintf(str, 32, "<%i>", id);
+	snprintf(str, 32, "<%u.%u>", index(id), generation(id));
 
 	return str;
 }
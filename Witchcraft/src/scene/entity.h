@@ -4,13 +4,38 @@
 #include <stdint.h>
 #include <string>
 
+/*
+An entity is just an ID.  The low bits are an index, which is recycled once the entity is destroyed,
+and the high bits are a generation, which changes every time the index is recycled.
+This way, an ID which was held onto after its entity was destroyed won't be mistaken for whichever entity gets the index next.
+The ID 0 is never given out, so it can be used to mean 'no entity'.
+*/
+
 namespace entity {
 
 	typedef uint32_t ID;
 
+	constexpr const uint32_t INDEX_BITS = 24;
+	constexpr const uint32_t GENERATION_BITS = 32 - INDEX_BITS;
+	constexpr const uint32_t INDEX_MASK = (1u << INDEX_BITS) - 1;
+	constexpr const uint32_t GENERATION_MASK = (1u << GENERATION_BITS) - 1;
+
+	/* Returns the part of the ID which is recycled, for indexing into arrays. */
+	inline constexpr uint32_t index(ID id)
+		{ return id & INDEX_MASK; }
+	/* Returns the part of the ID which tells apart entities which had the same index. */
+	inline constexpr uint32_t generation(ID id)
+		{ return id >> INDEX_BITS; }
+	inline constexpr ID makeID(uint32_t index, uint32_t generation)
+		{ return (index & INDEX_MASK) | ((generation & GENERATION_MASK) << INDEX_BITS); }
+
 	ID Create(uint16_t module_id);
 	void Destroy(ID id);
 
+	/* Returns whether the entity exists, which means it's been created and hasn't been destroyed since. */
+	/* This is an array read and a compare, so it's cheap enough to check before every use of an ID. */
+	bool isAlive(ID id);
+
 	std::string toString(ID id);
 
 } // namespace entity
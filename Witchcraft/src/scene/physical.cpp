@@ -300,8 +300,11 @@ void RigidBodyComponent::ApplySimulatedTransforms()
 		// Do we have to take the collider's offset into account here?
 		// Probably, but testing is needed!
 
-		entity::transform::setPos(id, vec3(pos.x(), pos.y(), pos.z()) - cc.soa.get<PCE_OFFSETPOS>(cc.index(id)) );
-		entity::transform::setRot(id, quat(rot.x(), rot.y(), rot.z(), rot.w()) );
+		entity::transform::Index transform_index = entity::transform::resolve(id);
+		if (transform_index.valid() == false) continue;
+
+		entity::transform::setPos(transform_index, vec3(pos.x(), pos.y(), pos.z()) - cc.soa.get<PCE_OFFSETPOS>(cc.index(id)) );
+		entity::transform::setRot(transform_index, quat(rot.x(), rot.y(), rot.z(), rot.w()) );
 	}
 }
 
@@ -312,8 +315,13 @@ void RigidBodyComponent::ApplyKinematicTransforms()
 		btMotionState* motionstate = soa.get<PCE_MOTIONSTATEPTR>(index(id));
 		if (motionstate == nullptr) continue;
 
-		vec3 pos = entity::transform::getPos(id) + cc.soa.get<PCE_OFFSETPOS>(cc.index(id) );
-		quat rot = entity::transform::getRot(id);
+		// Bodies whose transforms haven't changed this tick are already where they should be.
+		entity::transform::Index transform_index = entity::transform::resolve(id);
+		if (transform_index.valid() == false) continue;
+		if (entity::transform::isChanged(transform_index) == false) continue;
+
+		vec3 pos = entity::transform::getPos(transform_index) + cc.soa.get<PCE_OFFSETPOS>(cc.index(id) );
+		quat rot = entity::transform::getRot(transform_index);
 
 		btTransform transform({rot.x, rot.y, rot.z, rot.w}, {pos.x, pos.y, pos.z});
 		motionstate->setWorldTransform(transform);
@@ -2,6 +2,9 @@
 
 #include "graphics/renderer.h"
 #include "graphics/model.h"
+#include "graphics/lod.h"
+#include "graphics/camera.h"
+using namespace vmath;
 
 RenderableComponent::~RenderableComponent()
 {
@@ -32,6 +35,12 @@ void RenderableComponent::LoadModel(entity::ID id, const char* filename)
 
 	soa.get<RCE_MODELPTR>(index(id)) = Model::Load(filename);
 	soa.get<RCE_MODELFILENAME>(index(id)) = filename;
+	soa.get<RCE_LOD>(index(id)) = 0;
+
+	// The matrix needs building again to pick up the new model's import transform.
+	entity::transform::Index transform = entity::transform::resolve(id);
+	if (transform.valid())
+		{ entity::transform::touch(transform); }
 }
 
 int RenderableComponent::numMeshes(entity::ID id)
@@ -47,17 +56,44 @@ void RenderableComponent::ApplyImportTransforms()
 	for (size_t i = 1; i < soa.size(); ++i)
 	{
 		entity::ID id = soa.get<RCE_ENTITYID>(i);
+
+		// Matrices which weren't built again this frame already have their import transform.
+		entity::transform::Index transform = entity::transform::resolve(id);
+		if (transform.valid() == false || entity::transform::isRebuilt(transform) == false)
+			continue;
+
 		entity::transform::applyPreTransform(id, soa.get<RCE_MODELPTR>(i)->getImportTransform());
 	}
 }
 
-void RenderableComponent::DrawEverything()
+void RenderableComponent::DrawEverything(const UniformBufferCamera& camera)
 {
 	entity::ID* transforms = soa.rawdata<RCE_ENTITYID>();
 	Model** models = soa.rawdata<RCE_MODELPTR>();
+	int32_t* lods = soa.rawdata<RCE_LOD>();
+
+	vec3 eye_pos = camera.eye_pos.xyz;
+	float projection_scale = camera.proj.at(1, 1);
+
 	for (size_t i = 1; i < soa.size(); ++i)
 	{
-		if (models[i] != nullptr)
-			models[i]->Draw(transforms[i]);
+		if (models[i] == nullptr)
+			continue;
+
+		if (models[i]->numLods() > 1)
+		{
+			// Bring the model's bounding sphere into world space to see how large it is on the screen.
+			mat4 matrix = entity::transform::getMatrix(transforms[i]);
+			vec3 center = (matrix * vec4(models[i]->getBoundsCenter(), 1.0f)).xyz;
+			vec3 scale = matrix.extract_scale();
+			float radius = models[i]->getBoundsRadius() * fmaxf(scale.x, fmaxf(scale.y, scale.z));
+
+			float screen_size = lod::ProjectedSize(radius, vec3::distance(center, eye_pos), projection_scale);
+			lods[i] = lod::Select(screen_size, models[i]->getLodScreenSizes(), models[i]->numLods(), lods[i]);
+		}
+		else
+			{ lods[i] = 0; }
+
+		models[i]->Draw(transforms[i], lods[i], &camera);
 	}
 }
\ No newline at end of file
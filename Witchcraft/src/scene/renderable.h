@@ -6,23 +6,25 @@
 
 class Renderer;
 class Model;
+struct UniformBufferCamera;
 
 enum RenderableComponentEnum
 {
 	RCE_ENTITYID = 0,
 	RCE_MODELPTR,
-	RCE_MODELFILENAME
+	RCE_MODELFILENAME,
+	RCE_LOD
 };
 
-class RenderableComponent : protected ComponentTable<Model*, std::string>
+class RenderableComponent : protected ComponentTable<Model*, std::string, int32_t>
 {
 public:
 	RenderableComponent()
-	: ComponentTable<Model*, std::string>(nullptr, "")
+	: ComponentTable<Model*, std::string, int32_t>(nullptr, "", 0)
 	{}
 	~RenderableComponent();
 
-	using ComponentTable<Model*, std::string>::hasEntry;
+	using ComponentTable<Model*, std::string, int32_t>::hasEntry;
 
 	void AddEmpty(entity::ID id)
 	{
@@ -32,7 +34,7 @@ public:
 			return;
 		}
 
-		AddEntry(id, nullptr, "");
+		AddEntry(id, nullptr, "", 0);
 	}
 
 	void Remove(entity::ID id);
@@ -43,7 +45,8 @@ public:
 		{ return soa.get<RCE_MODELPTR>(index(id)); }
 
 	void ApplyImportTransforms();
-	void DrawEverything();
+	/* Submits every model to the renderer, choosing each one's level of detail by its size on the screen. */
+	void DrawEverything(const UniformBufferCamera& camera);
 
 	void InitLua();
 };
@@ -99,6 +99,8 @@ void Load(const char* sceneid, const char* entryid)
 		void* memptr = memory;
 		memptr = entity::name::Allocate(memptr, num_names);
 		memptr = entity::transform::Allocate(memptr, num_transforms);
+		entity::transform::setBoneSource([](entity::ID id, int32_t bone, float interpolation)
+			{ return component_animator.getBoneMatrix(id, bone, interpolation); });
 	//	memptr = entity::renderable::Allocate(memptr, num_renderables);
 	//	memptr = entity::animator::Allocate(memptr, num_animators);
 	//	memptr = entity::collider::Allocate(memptr, num_colliders);
@@ -161,6 +163,11 @@ void Load(const char* sceneid, const char* entryid)
 						for (auto it = import.Begin(); it != import.End(); ++it)
 							{ if (it->IsString()) component_animator.ImportAnimations(id, it->GetString()); }
 					}
+
+					// The graph starts playing as soon as it's set, so it has to come after the imports.
+					const auto& graph = animator["graph"];
+					if (graph.IsString())
+						{ component_animator.setAnimGraph(id, graph.GetString()); }
 			}	}
 
 			if (entity->value.HasMember("collider")) {
@@ -282,11 +289,15 @@ entity::ID SpawnEntity()
 
 void DestroyEntity(entity::ID id)
 {
+	// An ID from an entity which was already destroyed might share its index with a new entity, which should be left alone.
+	if (entity::isAlive(id) == false)
+		return;
+
 	entity::script::detachAll(id);
 
 	component_rigidbody.Delete(id);
 	component_collider.Delete(id);
-	component_animator.RemoveEntry(id);
+	component_animator.Remove(id);
 	component_renderable.Remove(id);
 	entity::transform::remove(id);
 	entity::name::remove(id);
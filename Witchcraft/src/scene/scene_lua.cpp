@@ -61,9 +61,9 @@ int lua_entity_tostring(lua_State* L)
 
 	char str[40];
 	if (entity::name::has(*id))
-		{ snprintf(str, 40, "<%i>, '%s'", *id, entity::name::get(*id).c_str() ); }
+		{ snprintf(str, 40, "%s, '%s'", entity::toString(*id).c_str(), entity::name::get(*id).c_str() ); }
 	else
-		{ snprintf(str, 40, "<%i>", *id); }
+		{ snprintf(str, 40, "%s", entity::toString(*id).c_str()); }
 
 	lua_pushstring(L, str);
 	return 1;
@@ -76,6 +76,14 @@ int lua_entity_getindex(lua_State* L)
 	return 1;
 }
 
+// Entities which have been destroyed (or were never created) aren't alive, even if another entity has since taken their index.
+int lua_entity_isalive(lua_State* L)
+{
+	entity::ID* id = (entity::ID*)luaL_checkudata(L, 1, "entity");
+	lua_pushboolean(L, entity::isAlive(*id));
+	return 1;
+}
+
 } // namespace <anon>
 
 void scene::InitLua()
@@ -88,6 +96,7 @@ void scene::InitLua()
 	 lua_pushcfunction(L, lua_entity_tostring); lua_setfield(L, -2, "__tostring");
 	 lua_pushcfunction(L, lua_entity_destroy); lua_setfield(L, -2, "destroy");
 	 lua_pushcfunction(L, lua_entity_getindex); lua_setfield(L, -2, "index");
+	 lua_pushcfunction(L, lua_entity_isalive); lua_setfield(L, -2, "is_alive");
 	 lua_pushstring(L, "entity"), lua_setfield(L, -2, "typename");
 	lua_pop(L, 1); // pop entity:meta
 
@@ -1,9 +1,14 @@
 #include "transform.h"
+#include "transform_kernel.h"
 #include "component.h"
+#include "tools/sparsearray.h"
 
-using namespace vmath;
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <functional>
 
-#include <unordered_map>
+using namespace vmath;
 using namespace std;
 
 namespace entity {
@@ -11,21 +16,83 @@ namespace transform {
 
 namespace {
 
-	unordered_map<ID, size_t> map;
+	// Each entity's index into the arrays below, plus one so that 0 can mean 'no transform'.
+	SparseArray<uint32_t> map;
+	// Which entity owns each transform, so IDs left over from destroyed entities can be caught.
+	ID* owners = nullptr;
 
-	vec3* positions = nullptr;
-	quat* rotations = nullptr;
-	vec3* scales = nullptr;
+	// Transforms are stored four to a block (see math/simd/4vec3.h), so the matrices can be built four at a time without shuffling anything.
+	simd_4vec3* positions = nullptr;
+	simd_4quat* rotations = nullptr;
+	simd_4vec3* scales = nullptr;
 
-	vec3* prev_pos = nullptr;
-	quat* prev_rot = nullptr;
-	vec3* prev_scl = nullptr;
+	simd_4vec3* prev_pos = nullptr;
+	simd_4quat* prev_rot = nullptr;
+	simd_4vec3* prev_scl = nullptr;
 
 	mat4* matrices = nullptr;
 
 	size_t capacity = 0;
 	size_t entries = 0;
 
+	// One bit per transform, set the first time it changes after a Flip.
+	vector<uint64_t> changed_bits;
+	// The transforms which have changed since the last Flip, in the order they first changed.
+	vector<Index> changed;
+	// Transforms which changed in a tick that's already been flipped.
+	// Their previous state has caught up, but their matrices were built part way there, so they need building once more.
+	vector<Index> settling;
+	// One bit per block of four, set when CalcMatrices last built that block's matrices.
+	vector<uint64_t> rebuilt_bits;
+
+	vector<function<void(const Index*, size_t)>> subscribers;
+
+	// A transform which follows another (or one of its bones), and the parent's matrix as of the last time the child was built.
+	// The parent's matrix only changes when the parent is marked dirty, and then so is the child, so this never goes stale.
+	struct Link
+	{
+		Index child;
+		Index parent;
+		int32_t bone;
+		uint32_t depth;
+		mat4 parent_matrix;
+	};
+	// Sorted breadth first (by depth), so every parent's matrix is finished before any of its children use it.
+	vector<Link> links;
+	// Each transform's place in 'links' plus one, or 0 if it doesn't have a parent.
+	vector<uint32_t> link_slots;
+	// One bit per transform, set when its world matrix has to be worked out again this display frame.
+	vector<uint64_t> dirty_bits;
+
+	function<mat4(ID, int32_t, float)> bone_source;
+
+	inline size_t numBlocks(size_t count)
+		{ return (count + 3) / 4; }
+
+	inline bool testBit(const vector<uint64_t>& bits, size_t i)
+		{ return (bits[i / 64] & (1ull << (i % 64))) != 0; }
+	inline void setBit(vector<uint64_t>& bits, size_t i)
+		{ bits[i / 64] |= (1ull << (i % 64)); }
+
+	inline void markChanged(size_t i)
+	{
+		if (testBit(changed_bits, i))
+			return;
+
+		setBit(changed_bits, i);
+		changed.push_back({ (uint32_t)i });
+	}
+
+	inline vec3 get(const simd_4vec3* blocks, size_t i)
+		{ return get_vec3(blocks[i / 4], (uint32_t)(i % 4)); }
+	inline quat get(const simd_4quat* blocks, size_t i)
+		{ return get_quat(blocks[i / 4], (uint32_t)(i % 4)); }
+	// Every change to a transform, current or previous, goes through these, so none of them can be missed.
+	inline void set(simd_4vec3* blocks, size_t i, vec3 val)
+		{ set_vec3(blocks[i / 4], (uint32_t)(i % 4), val); markChanged(i); }
+	inline void set(simd_4quat* blocks, size_t i, quat val)
+		{ set_quat(blocks[i / 4], (uint32_t)(i % 4), val); markChanged(i); }
+
 } // namespace <anon>
 
 void* Allocate(void* mem, size_t cap)
@@ -37,16 +104,37 @@ void* Allocate(void* mem, size_t cap)
 	}
 
 	capacity = cap;
-	map.reserve(cap);
+	size_t num_blocks = numBlocks(capacity);
+
+	// The blocks have to be aligned for SSE; size_of leaves room for this.
+	uintptr_t address = (uintptr_t)mem;
+	address = (address + (TRANSFORM_ALIGNMENT - 1)) & ~(uintptr_t)(TRANSFORM_ALIGNMENT - 1);
+
+	positions = (simd_4vec3*)address;
+	rotations = (simd_4quat*)(positions + num_blocks);
+	scales = (simd_4vec3*)(rotations + num_blocks);
+	prev_pos = (simd_4vec3*)(scales + num_blocks);
+	prev_rot = (simd_4quat*)(prev_pos + num_blocks);
+	prev_scl = (simd_4vec3*)(prev_rot + num_blocks);
+	matrices = (mat4*)(prev_scl + num_blocks);
+	owners = (ID*)(matrices + capacity);
+
+	// Unused lanes in the last block still go through the kernel, so they need to hold something sensible.
+	for (size_t i = 0; i < num_blocks; ++i)
+	{
+		positions[i] = prev_pos[i] = simd_4vec3_zero();
+		rotations[i] = prev_rot[i] = simd_4quat_identity();
+		scales[i] = prev_scl[i] = simd_4vec3_zero();
+	}
 
-	positions = (vec3*)mem;
-	rotations = (quat*)(positions + capacity);
-	scales = (vec3*)(rotations + capacity);
-	prev_pos = (vec3*)(scales + capacity);
-	prev_rot = (quat*)(prev_pos + capacity);
-	prev_scl = (vec3*)(prev_rot + capacity);
-	matrices = (mat4*)(prev_scl + capacity);
-	return (void*)(matrices + capacity);
+	changed_bits.assign((capacity + 63) / 64, 0);
+	dirty_bits.assign((capacity + 63) / 64, 0);
+	link_slots.assign(capacity, 0);
+	rebuilt_bits.assign((num_blocks + 63) / 64, 0);
+	changed.reserve(capacity);
+	settling.reserve(capacity);
+
+	return (void*)(owners + capacity);
 }
 
 void Clear()
@@ -58,10 +146,19 @@ void Clear()
 	prev_rot = nullptr;
 	prev_scl = nullptr;
 	matrices = nullptr;
+	owners = nullptr;
 
 	capacity = 0;
 	entries = 0;
 	map.clear();
+
+	changed_bits.clear();
+	dirty_bits.clear();
+	rebuilt_bits.clear();
+	links.clear();
+	link_slots.clear();
+	changed.clear();
+	settling.clear();
 }
 
 void add(ID id, vmath::vec3 pos, vmath::quat rot, vmath::vec3 scale)
@@ -72,153 +169,462 @@ void add(ID id, vmath::vec3 pos, vmath::quat rot, vmath::vec3 scale)
 	if (index >= capacity) { plog::error("Cannot add another Transform; out of memory!"); return; }
 	entries++;
 
-	map[id] = index;
-	positions[index] = pos;
-	rotations[index] = rot;
-	scales[index] = scale;
+	map.set(entity::index(id), (uint32_t)index + 1);
+	owners[index] = id;
+	set(positions, index, pos);
+	set(rotations, index, rot);
+	set(scales, index, scale);
 }
 
 void remove(ID id)
 	{ plog::error("entity::<component>::remove() is deprecated.  Components should only be added during initialization, and removed during de-initialization."); }
 
 bool has(ID id)
-	{ return (map.count(id) > 0); }
+	{ return resolve(id).valid(); }
+
+Index resolve(ID id)
+{
+	uint32_t slot = map.get(entity::index(id));
+	if (slot == 0 || owners[slot - 1] != id)
+		return INVALID_INDEX;
+
+	return { slot - 1 };
+}
+
+void resolve(const ID* ids, size_t count, Index* out_indices)
+{
+	for (size_t i = 0; i < count; ++i)
+		{ out_indices[i] = resolve(ids[i]); }
+}
 
 //// Position stuff ////
 
 void setPos(ID id, vec3 new_pos)
 {
-	if (!has(id)) { plog::error("Entity %s has no transform component!", toString(id)); return; }
-	positions[map[id]] = new_pos;
+	Index index = resolve(id);
+	if (!index.valid()) { plog::error("Entity %s has no transform component!\n", toString(id).c_str()); return; }
+	set(positions, index.value, new_pos);
 }
 
 void move(ID id, vmath::vec3 delta_pos)
 {
-	if (!has(id)) { plog::error("Entity %s has no transform component!", toString(id)); return; }
-	positions[map[id]] += delta_pos;
+	Index index = resolve(id);
+	if (!index.valid()) { plog::error("Entity %s has no transform component!\n", toString(id).c_str()); return; }
+	set(positions, index.value, get(positions, index.value) + delta_pos);
 }
 
 vmath::vec3 getPos(ID id)
 {
-	if (!has(id)) { plog::error("Entity %s has no transform component!", toString(id)); return VEC3_ZERO; }
-	return positions[map[id]];
+	Index index = resolve(id);
+	if (!index.valid()) { plog::error("Entity %s has no transform component!\n", toString(id).c_str()); return VEC3_ZERO; }
+	return get(positions, index.value);
 }
 
 void snapPos(ID id)
 {
-	if (!has(id)) { plog::error("Entity %s has no transform component!", toString(id)); return; }
-	size_t index = map[id]; prev_pos[index] = positions[index];
+	Index index = resolve(id);
+	if (!index.valid()) { plog::error("Entity %s has no transform component!\n", toString(id).c_str()); return; }
+	set(prev_pos, index.value, get(positions, index.value));
 }
 
 vec3 interpolatePos(ID id, float interpolation)
 {
-	if (!has(id)) { plog::error("Entity %s has no transform component!", toString(id)); return VEC3_ZERO; }
-	size_t index = map[id]; return vec3::lerp(prev_pos[index], positions[index], interpolation);
+	Index index = resolve(id);
+	if (!index.valid()) { plog::error("Entity %s has no transform component!\n", toString(id).c_str()); return VEC3_ZERO; }
+	return interpolatePos(index, interpolation);
 }
 
 //// Rotation stuff ////
 
 void setRot(ID id, quat new_rot)
 {
-	if (!has(id)) { plog::error("Entity %s has no transform component!", toString(id)); return; }
-	rotations[map[id]] = new_rot;
+	Index index = resolve(id);
+	if (!index.valid()) { plog::error("Entity %s has no transform component!\n", toString(id).c_str()); return; }
+	set(rotations, index.value, new_rot);
 }
 
 void rotate(ID id, vmath::quat delta_rot)
 {
-	if (!has(id)) { plog::error("Entity %s has no transform component!", toString(id)); return; }
-	rotations[map[id]] *= delta_rot;
+	Index index = resolve(id);
+	if (!index.valid()) { plog::error("Entity %s has no transform component!\n", toString(id).c_str()); return; }
+	set(rotations, index.value, get(rotations, index.value) * delta_rot);
 }
 
 vmath::quat getRot(ID id)
 {
-	if (!has(id)) { plog::error("Entity %s has no transform component!", toString(id)); return QUAT_IDENTITY; }
-	return rotations[map[id]];
+	Index index = resolve(id);
+	if (!index.valid()) { plog::error("Entity %s has no transform component!\n", toString(id).c_str()); return QUAT_IDENTITY; }
+	return get(rotations, index.value);
 }
 
 void snapRot(ID id)
 {
-	if (!has(id)) { plog::error("Entity %s has no transform component!", toString(id)); return; }
-	size_t index = map[id]; prev_rot[index] = rotations[index];
+	Index index = resolve(id);
+	if (!index.valid()) { plog::error("Entity %s has no transform component!\n", toString(id).c_str()); return; }
+	set(prev_rot, index.value, get(rotations, index.value));
 }
 
 quat interpolateRot(ID id, float interpolation)
 {
-	if (!has(id)) { plog::error("Entity %s has no transform component!", toString(id)); return QUAT_IDENTITY; }
-	size_t index = map[id]; return quat::lerp(prev_rot[index], rotations[index], interpolation);
+	Index index = resolve(id);
+	if (!index.valid()) { plog::error("Entity %s has no transform component!\n", toString(id).c_str()); return QUAT_IDENTITY; }
+	return interpolateRot(index, interpolation);
 }
 
 //// Scale stuff ////
 
 void setScale(ID id, vmath::vec3 new_scale)
 {
-	if (!has(id)) { plog::error("Entity %s has no transform component!", toString(id)); return; }
-	scales[map[id]] = new_scale;
+	Index index = resolve(id);
+	if (!index.valid()) { plog::error("Entity %s has no transform component!\n", toString(id).c_str()); return; }
+	set(scales, index.value, new_scale);
 }
 
 vmath::vec3 getScale(ID id)
 {
-	if (!has(id)) { plog::error("Entity %s has no transform component!", toString(id)); return VEC3_ONE; }
-	return scales[map[id]];
+	Index index = resolve(id);
+	if (!index.valid()) { plog::error("Entity %s has no transform component!\n", toString(id).c_str()); return VEC3_ONE; }
+	return get(scales, index.value);
 }
 
 void snapScale(ID id)
 {
-	if (!has(id)) { plog::error("Entity %s has no transform component!", toString(id)); return; }
-	size_t index = map[id]; prev_scl[index] = scales[index];
+	Index index = resolve(id);
+	if (!index.valid()) { plog::error("Entity %s has no transform component!\n", toString(id).c_str()); return; }
+	set(prev_scl, index.value, get(scales, index.value));
 }
 
 vec3 interpolateScale(ID id, float interpolation)
 {
-	if (!has(id)) { plog::error("Entity %s has no transform component!", toString(id)); return VEC3_ONE; }
-	size_t index = map[id]; return vec3::lerp(prev_scl[index], scales[index], interpolation);
+	Index index = resolve(id);
+	if (!index.valid()) { plog::error("Entity %s has no transform component!\n", toString(id).c_str()); return VEC3_ONE; }
+	return interpolateScale(index, interpolation);
 }
 
 //// Matrix stuff ////
 
 mat4 getMatrix(ID id)
 {
-	if (!has(id)) { plog::error("Entity %s has no transform component!", toString(id)); return MAT4_IDENTITY; }
-	return matrices[map[id]];
+	Index index = resolve(id);
+	if (!index.valid()) { plog::error("Entity %s has no transform component!\n", toString(id).c_str()); return MAT4_IDENTITY; }
+	return matrices[index.value];
 }
 
 void applyPreTransform(ID id, vmath::mat4 matrix)
 {
-	if (!has(id)) { plog::error("Entity %s has no transform component!", toString(id)); return; }
-	matrices[map[id]] *= matrix;
+	Index index = resolve(id);
+	if (!index.valid()) { plog::error("Entity %s has no transform component!\n", toString(id).c_str()); return; }
+	matrices[index.value] *= matrix;
 }
 
 void applyPostTransform(ID id, vmath::mat4 matrix)
 {
-	if (!has(id)) { plog::error("Entity %s has no transform component!", toString(id)); return; }
-	size_t index = map[id];  matrices[index] = matrix * matrices[index];
+	Index index = resolve(id);
+	if (!index.valid()) { plog::error("Entity %s has no transform component!\n", toString(id).c_str()); return; }
+	matrices[index.value] = matrix * matrices[index.value];
+}
+
+//// Resolved indices ////
+
+void setPos(Index index, vec3 new_pos)
+	{ set(positions, index.value, new_pos); }
+
+void move(Index index, vec3 delta_pos)
+	{ set(positions, index.value, get(positions, index.value) + delta_pos); }
+
+vec3 getPos(Index index)
+	{ return get(positions, index.value); }
+
+vec3 interpolatePos(Index index, float interpolation)
+	{ return vec3::lerp(get(prev_pos, index.value), get(positions, index.value), interpolation); }
+
+void setRot(Index index, quat new_rot)
+	{ set(rotations, index.value, new_rot); }
+
+void rotate(Index index, quat delta_rot)
+	{ set(rotations, index.value, get(rotations, index.value) * delta_rot); }
+
+quat getRot(Index index)
+	{ return get(rotations, index.value); }
+
+quat interpolateRot(Index index, float interpolation)
+	{ return quat::lerp(get(prev_rot, index.value), get(rotations, index.value), interpolation); }
+
+void setScale(Index index, vec3 new_scale)
+	{ set(scales, index.value, new_scale); }
+
+vec3 getScale(Index index)
+	{ return get(scales, index.value); }
+
+vec3 interpolateScale(Index index, float interpolation)
+	{ return vec3::lerp(get(prev_scl, index.value), get(scales, index.value), interpolation); }
+
+mat4 getMatrix(Index index)
+	{ return matrices[index.value]; }
+
+//// Batches ////
+
+void getPositions(const ID* ids, size_t count, vec3* out_positions)
+{
+	for (size_t i = 0; i < count; ++i)
+	{
+		Index index = resolve(ids[i]);
+		out_positions[i] = index.valid() ? get(positions, index.value) : VEC3_ZERO;
+	}
+}
+
+void setPositions(const ID* ids, size_t count, const vec3* in_positions)
+{
+	for (size_t i = 0; i < count; ++i)
+	{
+		Index index = resolve(ids[i]);
+		if (index.valid())
+			{ set(positions, index.value, in_positions[i]); }
+	}
+}
+
+void getRotations(const ID* ids, size_t count, quat* out_rotations)
+{
+	for (size_t i = 0; i < count; ++i)
+	{
+		Index index = resolve(ids[i]);
+		out_rotations[i] = index.valid() ? get(rotations, index.value) : QUAT_IDENTITY;
+	}
+}
+
+void setRotations(const ID* ids, size_t count, const quat* in_rotations)
+{
+	for (size_t i = 0; i < count; ++i)
+	{
+		Index index = resolve(ids[i]);
+		if (index.valid())
+			{ set(rotations, index.value, in_rotations[i]); }
+	}
+}
+
+void getScales(const ID* ids, size_t count, vec3* out_scales)
+{
+	for (size_t i = 0; i < count; ++i)
+	{
+		Index index = resolve(ids[i]);
+		out_scales[i] = index.valid() ? get(scales, index.value) : VEC3_ONE;
+	}
+}
+
+void setScales(const ID* ids, size_t count, const vec3* in_scales)
+{
+	for (size_t i = 0; i < count; ++i)
+	{
+		Index index = resolve(ids[i]);
+		if (index.valid())
+			{ set(scales, index.value, in_scales[i]); }
+	}
+}
+
+void getMatrices(const ID* ids, size_t count, mat4* out_matrices)
+{
+	for (size_t i = 0; i < count; ++i)
+	{
+		Index index = resolve(ids[i]);
+		out_matrices[i] = index.valid() ? matrices[index.value] : MAT4_IDENTITY;
+	}
+}
+
+//// Hierarchy ////
+
+namespace {
+
+	// Works out every link's depth again and puts them back in breadth first order.
+	// This only happens when the hierarchy changes, which is rare enough that it doesn't need to be clever.
+	void SortLinks()
+	{
+		for (size_t i = 0; i < links.size(); ++i)
+			{ link_slots[links[i].child.value] = (uint32_t)i + 1; }
+
+		for (Link& link : links)
+		{
+			link.depth = 1;
+			for (uint32_t slot = link_slots[link.parent.value]; slot != 0; slot = link_slots[links[slot - 1].parent.value])
+				{ link.depth++; }
+		}
+
+		stable_sort(links.begin(), links.end(), [](const Link& lhs, const Link& rhs) { return lhs.depth < rhs.depth; });
+
+		for (size_t i = 0; i < links.size(); ++i)
+			{ link_slots[links[i].child.value] = (uint32_t)i + 1; }
+	}
+
+} // namespace <anon>
+
+void setParent(ID id, ID parent, int32_t bone)
+{
+	Index index = resolve(id);
+	if (!index.valid()) { plog::error("Entity %s has no transform component!\n", toString(id).c_str()); return; }
+	Index parent_index = resolve(parent);
+	if (!parent_index.valid()) { plog::error("Entity %s has no transform component!\n", toString(parent).c_str()); return; }
+
+	// Following the chain up from the new parent must never lead back to this transform.
+	for (Index above = parent_index; ; above = links[link_slots[above.value] - 1].parent)
+	{
+		if (above.value == index.value)
+		{
+			plog::error("Cannot make %s the parent of %s; it would be its own ancestor.\n", toString(parent).c_str(), toString(id).c_str());
+			return;
+		}
+		if (link_slots[above.value] == 0)
+			break;
+	}
+
+	Link link = { index, parent_index, bone, 0, MAT4_IDENTITY };
+	if (link_slots[index.value] != 0)
+		{ links[link_slots[index.value] - 1] = link; }
+	else
+		{ links.push_back(link); }
+	SortLinks();
+
+	// The parent is built again too, so this link has a matrix to start from.
+	markChanged(index.value);
+	markChanged(parent_index.value);
 }
 
+void clearParent(ID id)
+{
+	Index index = resolve(id);
+	if (!index.valid()) { plog::error("Entity %s has no transform component!\n", toString(id).c_str()); return; }
+	if (link_slots[index.value] == 0)
+		return;
+
+	// Removing a link leaves everything else in order, but the slots after it need to be found again.
+	links.erase(links.begin() + (link_slots[index.value] - 1));
+	link_slots[index.value] = 0;
+	SortLinks();
+	markChanged(index.value);
+}
+
+ID getParent(ID id)
+{
+	Index index = resolve(id);
+	if (!index.valid() || link_slots[index.value] == 0)
+		return 0;
+
+	return owners[links[link_slots[index.value] - 1].parent.value];
+}
+
+int32_t getParentBone(ID id)
+{
+	Index index = resolve(id);
+	if (!index.valid() || link_slots[index.value] == 0)
+		return -1;
+
+	return links[link_slots[index.value] - 1].bone;
+}
+
+void setBoneSource(const function<mat4(ID entity, int32_t bone, float interpolation)>& source)
+	{ bone_source = source; }
+
 //// Other stuff ////
 
-void Flip()
+bool isChanged(Index index)
+	{ return testBit(changed_bits, index.value); }
+
+void touch(Index index)
+	{ markChanged(index.value); }
+
+const Index* getChanged(size_t& out_count)
 {
-	// Should this be one big loop instead of 3 loops?
-	// 3 loops might be more cache-friendly...   maybe.
-	// Testing would be needed, but I really doubt this is a bottleneck.
+	out_count = changed.size();
+	return changed.data();
+}
 
-	for (size_t i = 0; i < entries; ++i)
-		{ prev_pos[i] = positions[i]; }
+bool isRebuilt(Index index)
+	{ return testBit(rebuilt_bits, index.value / 4); }
 
-	for (size_t i = 0; i < entries; ++i)
-		{ prev_rot[i] = rotations[i]; }
+void Subscribe(const function<void(const Index* indices, size_t count)>& callback)
+	{ subscribers.push_back(callback); }
 
-	for (size_t i = 0; i < entries; ++i)
-		{ prev_scl[i] = scales[i]; }
+void Flip()
+{
+	for (auto& callback : subscribers)
+		{ callback(changed.data(), changed.size()); }
+
+	// Anything which hasn't changed already has the same previous and current state, so only changed blocks need copying.
+	for (Index index : changed)
+	{
+		size_t block = index.value / 4;
+		prev_pos[block] = positions[block];
+		prev_rot[block] = rotations[block];
+		prev_scl[block] = scales[block];
+		// Every bit set in this word belongs to something in the list, so the whole word can go at once.
+		changed_bits[index.value / 64] = 0;
+	}
+
+	// If several ticks go by between display frames, everything changed in any of them still needs building.
+	settling.insert(settling.end(), changed.begin(), changed.end());
+	changed.clear();
 }
 
 void CalcMatrices(float interpolation)
 {
-	for (size_t i = 0; i < entries; ++i)
+	fill(dirty_bits.begin(), dirty_bits.end(), 0);
+	fill(rebuilt_bits.begin(), rebuilt_bits.end(), 0);
+	auto markDirty = [](uint32_t i)
+	{
+		setBit(dirty_bits, i);
+		setBit(rebuilt_bits, i / 4);
+	};
+
+	for (Index index : settling)
+		{ markDirty(index.value); }
+	for (Index index : changed)
+		{ markDirty(index.value); }
+	settling.clear();
+
+	// Anything following a dirty parent is dirty too.  Bones move whenever they like, so anything following one is always dirty.
+	for (const Link& link : links)
+	{
+		if (link.bone >= 0 || testBit(dirty_bits, link.parent.value))
+			{ markDirty(link.child.value); }
+	}
+
+	// Neighbouring blocks are built together, so long runs of moving transforms still go through the kernel in one call.
+	size_t num_blocks = numBlocks(entries);
+	size_t block = 0;
+	while (block < num_blocks)
 	{
-		matrices[i] = mat4::translation(vec3::lerp(prev_pos[i], positions[i], interpolation)) *
-					  mat4::rotation(quat::lerp(prev_rot[i], rotations[i], interpolation)) *
-					  mat4::scale(vec3::lerp(prev_scl[i], scales[i], interpolation));
+		if (rebuilt_bits[block / 64] == 0)
+		{
+			block = ((block / 64) + 1) * 64;
+			continue;
+		}
+		if (testBit(rebuilt_bits, block) == false)
+		{
+			++block;
+			continue;
+		}
+
+		size_t first = block;
+		while (block < num_blocks && testBit(rebuilt_bits, block))
+			{ ++block; }
+
+		size_t count = min(block * 4, entries) - (first * 4);
+		BuildTransformMatrices(prev_pos + first, positions + first, prev_rot + first, rotations + first,
+			prev_scl + first, scales + first, count, interpolation, matrices + (first * 4));
+	}
+
+	// Children are kept relative to their parents, so now each one that was built is brought into the world, parents first.
+	// A parent which was built this frame doesn't have anything else (like an import transform) applied to its matrix yet.
+	for (Link& link : links)
+	{
+		if (testBit(rebuilt_bits, link.child.value / 4) == false)
+			continue;
+
+		if (testBit(rebuilt_bits, link.parent.value / 4))
+			{ link.parent_matrix = matrices[link.parent.value]; }
+
+		if (link.bone >= 0 && bone_source)
+			{ matrices[link.child.value] = link.parent_matrix * bone_source(owners[link.parent.value], link.bone, interpolation) * matrices[link.child.value]; }
+		else
+			{ matrices[link.child.value] = link.parent_matrix * matrices[link.child.value]; }
 	}
 }
 
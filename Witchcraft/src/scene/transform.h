@@ -4,10 +4,14 @@
 #include "entity.h"
 #include "math/vmath.h"
 
+#include <functional>
+
 /*
 The 'transform' component stores an entity's position, orientation, and scale in the world.
 It also keeps track of these states for the previous frame, allowing interpolation between frames,
 and handles creating the World matrix to be sent to the GPU.
+A transform can follow another entity's transform (or one of its bones), in which case its position,
+orientation, and scale are relative to its parent, and only its matrix is in the world.
 */
 
 namespace entity {
@@ -21,6 +25,45 @@ namespace transform {
 	/* Returns whether or not the entity has a transform component. */
 	bool has(ID id);
 
+	/* Where an entity's transform is kept.  Transforms never move once they've been added, so an index stays good for as long as the scene does. */
+	struct Index
+	{
+		uint32_t value;
+		bool valid() const
+			{ return value != 0xffffffff; }
+	};
+	constexpr const Index INVALID_INDEX = { 0xffffffff };
+
+	/* Returns where the entity's transform is kept, or INVALID_INDEX if it doesn't have one. */
+	Index resolve(ID id);
+	/* Resolves a whole list of entities at once. */
+	void resolve(const ID* ids, size_t count, Index* out_indices);
+
+	/* These work just like the functions which take an ID, but skip looking the entity up. */
+	/* They don't check the index either, so only use indices which came from resolve() and were valid. */
+	void setPos(Index index, vmath::vec3 new_pos);
+	void move(Index index, vmath::vec3 delta_pos);
+	vmath::vec3 getPos(Index index);
+	vmath::vec3 interpolatePos(Index index, float interpolation);
+	void setRot(Index index, vmath::quat new_rot);
+	void rotate(Index index, vmath::quat delta_rot);
+	vmath::quat getRot(Index index);
+	vmath::quat interpolateRot(Index index, float interpolation);
+	void setScale(Index index, vmath::vec3 new_scale);
+	vmath::vec3 getScale(Index index);
+	vmath::vec3 interpolateScale(Index index, float interpolation);
+	vmath::mat4 getMatrix(Index index);
+
+	/* Gets or sets the transforms of a whole list of entities at once. */
+	/* Entities without a transform are skipped by the setters, and get the default (zero, identity, one) from the getters. */
+	void getPositions(const ID* ids, size_t count, vmath::vec3* out_positions);
+	void setPositions(const ID* ids, size_t count, const vmath::vec3* positions);
+	void getRotations(const ID* ids, size_t count, vmath::quat* out_rotations);
+	void setRotations(const ID* ids, size_t count, const vmath::quat* rotations);
+	void getScales(const ID* ids, size_t count, vmath::vec3* out_scales);
+	void setScales(const ID* ids, size_t count, const vmath::vec3* scales);
+	void getMatrices(const ID* ids, size_t count, vmath::mat4* out_matrices);
+
 	/* Sets an entity's position. */
 	void setPos(ID id, vmath::vec3 new_pos);
 	/* Moves an entity (adds delta_pos to its existing position). */
@@ -59,16 +102,45 @@ namespace transform {
 	/* Matrices are calculated in the display update, and this function is only useful after that happens. */
 	vmath::mat4 getMatrix(ID id);
 	/* Applies a matrix transformation to the entity's calculated matrix. */
+	/* Matrices are only built again when something changes, so only apply this to matrices which isRebuilt() says were just built. */
 	/* (this matrix * transform) */
 	void applyPreTransform(ID id, vmath::mat4 transform);
 	/* Applies a matrix transformation to the entity's calculated matrix. */
 	/* (transform * this matrix) */
 	void applyPostTransform(ID id, vmath::mat4 transform);
 
-	/* Sets the previous transform for every entry to be the current transform. */
+	/* Makes the entity follow another one.  From then on, its position, rotation, and scale are relative to the parent. */
+	/* If 'bone' is a bone handle (see AnimatorComponent::getBoneHandle), it follows that bone of the parent's animation instead. */
+	/* Parents are worked out in the display update, along with the matrices, so they don't affect getPos and the like. */
+	void setParent(ID id, ID parent, int32_t bone = -1);
+	/* Stops the entity from following its parent.  Its position, rotation, and scale stay as they are, so it'll jump back to them. */
+	void clearParent(ID id);
+	/* Returns the entity this one follows, or 0 if it doesn't have a parent. */
+	ID getParent(ID id);
+	/* Returns the bone this one follows, or -1 if it follows the parent's transform (or doesn't have a parent). */
+	int32_t getParentBone(ID id);
+	/* Tells the transform component where to get bone matrices from, in the space of their entity's transform. */
+	/* This is set by the scene, so the transform component doesn't need to know about animation. */
+	void setBoneSource(const std::function<vmath::mat4(ID entity, int32_t bone, float interpolation)>& source);
+
+	/* Returns whether the transform has changed (moved, rotated, scaled, or snapped) since the last Flip. */
+	bool isChanged(Index index);
+	/* Counts the transform as changed without changing it, so its matrix is built again. */
+	void touch(Index index);
+	/* Returns the transforms which have changed since the last Flip, in the order they first changed. */
+	/* The list is only good until the next Flip. */
+	const Index* getChanged(size_t& out_count);
+	/* Returns whether the last CalcMatrices built this transform's matrix. */
+	/* Transforms which haven't changed keep the matrix they had before. */
+	bool isRebuilt(Index index);
+	/* Asks for a list of the transforms which changed each tick. */
+	/* The callback is called by Flip, just before the list is cleared, and should stay valid for as long as the program runs. */
+	void Subscribe(const std::function<void(const Index* indices, size_t count)>& callback);
+
+	/* Sets the previous transform to be the current transform, for every entry which has changed. */
 	/* This should be called only at the beginning of the logical update. */
 	void Flip();
-	/* Uses the current and previous transform state to calculate the Model matrix for each entry. */
+	/* Uses the current and previous transform state to calculate the Model matrix for each entry which has changed, or is still catching up. */
 	/* This should be called only at the beginning of the display update. */
 	void CalcMatrices(float interpolation);
 
@@ -76,12 +148,14 @@ namespace transform {
 	/* This should be called exactly once during program initialization. */
 	void InitLua();
 
+	// Positions, rotations, and scales are stored in aligned blocks of four, so size_of rounds up and leaves room for the alignment.
+	constexpr size_t TRANSFORM_ALIGNMENT = 16;
+
 	/* Returns the number of bytes used by a given number of entity's transforms; Used for memory allocations. */
 	constexpr size_t size_of(size_t count)
 	{
-		return count * (sizeof(vmath::vec3) + sizeof(vmath::quat) + sizeof(vmath::vec3) +
-						sizeof(vmath::vec3) + sizeof(vmath::quat) + sizeof(vmath::vec3) +
-						sizeof(vmath::mat4));
+		return (((count + 3) / 4) * 4 * (sizeof(vmath::vec3) + sizeof(vmath::quat) + sizeof(vmath::vec3)) * 2) +
+				(count * (sizeof(vmath::mat4) + sizeof(ID))) + TRANSFORM_ALIGNMENT;
 	}
 
 	/* Takes a pointer to memory allocated by the scene and allocates sections of it for our purposes. */
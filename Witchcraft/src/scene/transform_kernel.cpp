@@ -0,0 +1,48 @@
+#include "transform_kernel.h"
+
+#include "math/simd/mat4.h"
+
+using namespace vmath;
+
+void BuildTransformMatrices(const simd_4vec3* prev_positions, const simd_4vec3* positions,
+	const simd_4quat* prev_rotations, const simd_4quat* rotations,
+	const simd_4vec3* prev_scales, const simd_4vec3* scales,
+	size_t count, float interpolation, mat4* out_matrices)
+{
+	__m128 amount = _mm_set1_ps(interpolation);
+	size_t num_full_blocks = count / 4;
+	for (size_t block = 0; block < num_full_blocks; ++block)
+	{
+		to_mat4(lerp(prev_positions[block], positions[block], amount),
+				lerp(prev_rotations[block], rotations[block], amount),
+				lerp(prev_scales[block], scales[block], amount),
+				out_matrices + (block * 4));
+	}
+
+	// The last block may only be partly used, so its matrices go somewhere safe first.
+	size_t remainder = count - (num_full_blocks * 4);
+	if (remainder > 0)
+	{
+		mat4 last[4];
+		size_t block = num_full_blocks;
+		to_mat4(lerp(prev_positions[block], positions[block], amount),
+				lerp(prev_rotations[block], rotations[block], amount),
+				lerp(prev_scales[block], scales[block], amount),
+				last);
+		for (size_t i = 0; i < remainder; ++i)
+			{ out_matrices[(block * 4) + i] = last[i]; }
+	}
+}
+
+void BuildTransformMatricesReference(const vec3* prev_positions, const vec3* positions,
+	const quat* prev_rotations, const quat* rotations,
+	const vec3* prev_scales, const vec3* scales,
+	size_t count, float interpolation, mat4* out_matrices)
+{
+	for (size_t i = 0; i < count; ++i)
+	{
+		out_matrices[i] = mat4::translation(vec3::lerp(prev_positions[i], positions[i], interpolation)) *
+						  mat4::rotation(quat::lerp(prev_rotations[i], rotations[i], interpolation)) *
+						  mat4::scale(vec3::lerp(prev_scales[i], scales[i], interpolation));
+	}
+}
\ No newline at end of file
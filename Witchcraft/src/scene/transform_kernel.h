@@ -0,0 +1,36 @@
+#ifndef HVH_WC_SCENE_TRANSFORMKERNEL_H
+#define HVH_WC_SCENE_TRANSFORMKERNEL_H
+
+#include "math/vmath.h"
+#include "math/simd/4vec3.h"
+#include "math/simd/4quat.h"
+
+#include <cstddef>
+
+/*
+Builds the world matrices for the transform component.
+Transforms are stored four to a block (see math/simd/4vec3.h), so each block's matrices are built
+together with SSE: interpolating positions, rotations, and scales, and then multiplying out
+'translation * rotation * scale' without any shuffling on the way in.
+*/
+
+/* Interpolates 'count' transforms between their previous and current states, and builds a matrix for each. */
+/* The state arrays must hold (count + 3) / 4 blocks; lanes past 'count' in the last block are ignored. */
+void BuildTransformMatrices(const vmath::simd_4vec3* prev_positions, const vmath::simd_4vec3* positions,
+	const vmath::simd_4quat* prev_rotations, const vmath::simd_4quat* rotations,
+	const vmath::simd_4vec3* prev_scales, const vmath::simd_4vec3* scales,
+	size_t count, float interpolation, vmath::mat4* out_matrices);
+
+/* The same as BuildTransformMatrices, one plain transform at a time, for checking its results against. */
+void BuildTransformMatricesReference(const vmath::vec3* prev_positions, const vmath::vec3* positions,
+	const vmath::quat* prev_rotations, const vmath::quat* rotations,
+	const vmath::vec3* prev_scales, const vmath::vec3* scales,
+	size_t count, float interpolation, vmath::mat4* out_matrices);
+
+/* Checks that the SIMD kernel agrees with the reference.  Returns false if any test fails. */
+bool RunTransformUnitTests();
+
+/* Times both versions, and logs how many matrices per second each manages. */
+void RunTransformBenchmark();
+
+#endif // HVH_WC_SCENE_TRANSFORMKERNEL_H
\ No newline at end of file
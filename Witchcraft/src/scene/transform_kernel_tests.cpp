@@ -0,0 +1,143 @@
+#include "transform_kernel.h"
+
+#include "sys/printlog.h"
+#include "sys/timer.h"
+#include "tools/testrandom.h"
+
+#include <cmath>
+#include <cstring>
+#include <vector>
+using namespace vmath;
+
+namespace {
+
+	TestRandom test_random(13579);
+
+	quat RandomRotation()
+		{ return quat::euler({ test_random.Float(-3, 3), test_random.Float(-3, 3), test_random.Float(-3, 3) }); }
+
+	// The same random transforms, both one to an element and four to a block.
+	struct TestTransforms
+	{
+		std::vector<vec3> prev_pos, pos, prev_scl, scl;
+		std::vector<quat> prev_rot, rot;
+		std::vector<simd_4vec3> prev_pos_blocks, pos_blocks, prev_scl_blocks, scl_blocks;
+		std::vector<simd_4quat> prev_rot_blocks, rot_blocks;
+
+		void Make(size_t count)
+		{
+			prev_pos.resize(count); pos.resize(count); prev_scl.resize(count); scl.resize(count);
+			prev_rot.resize(count); rot.resize(count);
+
+			size_t num_blocks = (count + 3) / 4;
+			prev_pos_blocks.assign(num_blocks, simd_4vec3_zero()); pos_blocks.assign(num_blocks, simd_4vec3_zero());
+			prev_scl_blocks.assign(num_blocks, simd_4vec3_zero()); scl_blocks.assign(num_blocks, simd_4vec3_zero());
+			prev_rot_blocks.assign(num_blocks, simd_4quat_identity()); rot_blocks.assign(num_blocks, simd_4quat_identity());
+
+			for (size_t i = 0; i < count; ++i)
+			{
+				prev_pos[i] = vec3(test_random.Float(-100, 100), test_random.Float(-100, 100), test_random.Float(-100, 100));
+				pos[i] = prev_pos[i] + vec3(test_random.Float(-1, 1), test_random.Float(-1, 1), test_random.Float(-1, 1));
+				prev_rot[i] = RandomRotation();
+				rot[i] = (i % 3) ? RandomRotation() : prev_rot[i];
+				prev_scl[i] = vec3(test_random.Float(0.5f, 2), test_random.Float(0.5f, 2), test_random.Float(0.5f, 2));
+				scl[i] = (i % 5) ? prev_scl[i] : vec3(test_random.Float(0.5f, 2), test_random.Float(0.5f, 2), test_random.Float(0.5f, 2));
+
+				size_t block = i / 4;
+				uint32_t lane = (uint32_t)(i % 4);
+				set_vec3(prev_pos_blocks[block], lane, prev_pos[i]); set_vec3(pos_blocks[block], lane, pos[i]);
+				set_quat(prev_rot_blocks[block], lane, prev_rot[i]); set_quat(rot_blocks[block], lane, rot[i]);
+				set_vec3(prev_scl_blocks[block], lane, prev_scl[i]); set_vec3(scl_blocks[block], lane, scl[i]);
+			}
+		}
+
+		void BuildReference(float interpolation, mat4* out)
+		{
+			BuildTransformMatricesReference(prev_pos.data(), pos.data(), prev_rot.data(), rot.data(), prev_scl.data(), scl.data(),
+				pos.size(), interpolation, out);
+		}
+
+		void Build(float interpolation, mat4* out)
+		{
+			BuildTransformMatrices(prev_pos_blocks.data(), pos_blocks.data(), prev_rot_blocks.data(), rot_blocks.data(),
+				prev_scl_blocks.data(), scl_blocks.data(), pos.size(), interpolation, out);
+		}
+	};
+
+} // namespace <anon>
+
+bool RunTransformUnitTests()
+{
+	bool success = true;
+
+	// An odd number, so the last block is only partly used.
+	const size_t NUM_TRANSFORMS = 1027;
+	TestTransforms transforms;
+	transforms.Make(NUM_TRANSFORMS);
+
+	// One more matrix than there are transforms, to make sure the kernel doesn't write past the end.
+	std::vector<mat4> reference(NUM_TRANSFORMS), simd(NUM_TRANSFORMS + 1);
+	const mat4 guard = mat4::translation(1.0f, 2.0f, 3.0f);
+	simd[NUM_TRANSFORMS] = guard;
+
+	const float interpolations[] = { 0.0f, 0.3f, 1.0f };
+	for (float interpolation : interpolations)
+	{
+		transforms.BuildReference(interpolation, reference.data());
+		transforms.Build(interpolation, simd.data());
+
+		float worst = 0.0f;
+		for (size_t i = 0; i < NUM_TRANSFORMS; ++i)
+		{
+			for (int c = 0; c < 4; ++c)
+			{
+				for (int r = 0; r < 4; ++r)
+					{ worst = fmaxf(worst, fabsf(simd[i].at(r, c) - reference[i].at(r, c))); }
+			}
+		}
+		if (worst > 0.001f)
+		{
+			plog::error("transform unit test failed: SIMD matrices were off by up to %f at interpolation %f.\n", worst, interpolation);
+			success = false;
+		}
+	}
+
+	if (memcmp(&simd[NUM_TRANSFORMS], &guard, sizeof(mat4)) != 0)
+	{
+		plog::error("transform unit test failed: the SIMD kernel wrote past the last transform.\n");
+		success = false;
+	}
+
+	return success;
+}
+
+void RunTransformBenchmark()
+{
+	const size_t NUM_TRANSFORMS = 100000;
+	const int NUM_PASSES = 20;
+
+	TestTransforms transforms;
+	transforms.Make(NUM_TRANSFORMS);
+	std::vector<mat4> matrices(NUM_TRANSFORMS);
+
+	sys::Timer timer;
+	double seconds[2];
+	for (int mode = 0; mode < 2; ++mode)
+	{
+		timer.update();
+		for (int pass = 0; pass < NUM_PASSES; ++pass)
+		{
+			float interpolation = (float)pass / (float)NUM_PASSES;
+			if (mode == 0)
+				{ transforms.BuildReference(interpolation, matrices.data()); }
+			else
+				{ transforms.Build(interpolation, matrices.data()); }
+		}
+		timer.update();
+		seconds[mode] = timer.getDeltaTime();
+	}
+
+	double count = (double)(NUM_TRANSFORMS * NUM_PASSES);
+	plog::info("Transform benchmark: %i transforms; reference %.1f M/s, SIMD %.1f M/s. [%f]\n",
+		(int)NUM_TRANSFORMS, count / seconds[0] / 1000000.0, count / seconds[1] / 1000000.0, matrices[NUM_TRANSFORMS / 2].at(0, 3));
+}
\ No newline at end of file
@@ -240,6 +240,46 @@ int lua_transform_snapscale(lua_State* L)
 	return 0;
 }
 
+// Parent
+
+// Passing nil instead of an entity stops following the parent.
+int lua_transform_setparent(lua_State* L)
+{
+	entity::ID* id = (entity::ID*)luaL_checkudata(L, 1, "entity");
+	if (entity::transform::has(*id) == false)
+		return luaL_error(L, "This entity does not have a Transform component.\n");
+
+	if (lua_isnoneornil(L, 2))
+	{
+		entity::transform::clearParent(*id);
+		return 0;
+	}
+
+	entity::ID* parent = (entity::ID*)luaL_checkudata(L, 2, "entity");
+	if (entity::transform::has(*parent) == false)
+		return luaL_error(L, "The parent entity does not have a Transform component.\n");
+
+	entity::transform::setParent(*id, *parent);
+	return 0;
+}
+
+int lua_transform_getparent(lua_State* L)
+{
+	entity::ID* id = (entity::ID*)luaL_checkudata(L, 1, "entity");
+	entity::ID parent = entity::transform::getParent(*id);
+	if (parent == 0)
+	{
+		lua_pushnil(L);
+		return 1;
+	}
+
+	entity::ID* result = (entity::ID*)lua_newuserdata(L, sizeof(entity::ID));
+	luaL_getmetatable(L, "entity"); lua_setmetatable(L, -2);
+
+	*result = parent;
+	return 1;
+}
+
 } // namespace <anon>
 
 void entity::transform::InitLua()
@@ -261,5 +301,7 @@ void entity::transform::InitLua()
 	 lua_pushcfunction(L, lua_transform_getscale); lua_setfield(L, -2, "getscale");
 	 lua_pushcfunction(L, lua_transform_setscale); lua_setfield(L, -2, "setscale");
 	 lua_pushcfunction(L, lua_transform_snapscale); lua_setfield(L, -2, "snapscale");
+	 lua_pushcfunction(L, lua_transform_setparent); lua_setfield(L, -2, "setparent");
+	 lua_pushcfunction(L, lua_transform_getparent); lua_setfield(L, -2, "getparent");
 	lua_pop(L, 1);
 }
\ No newline at end of file
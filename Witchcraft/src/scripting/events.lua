@@ -5,7 +5,23 @@ SANDBOX.events = readonly(EVENTS)
 
 local listeners = {}
 
+-- Every entity userdata is a different object, even for the same entity,
+-- so entities are listed under the first userdata seen for them, which is looked up by index.
+local entity_keys = {}
+
+local function listener_key(eventid, id)
+	local meta = getmetatable(id)
+	if meta == nil or rawget(meta, "typename") ~= "entity" then return id end
+
+	local index = id:index()
+	if entity_keys[eventid][index] == nil then
+		entity_keys[eventid][index] = id
+	end
+	return entity_keys[eventid][index]
+end
+
 function GENERIC_EVENT_LISTEN(self, id, scriptname, func)
+	id = listener_key(self.eventid, id)
 	if listeners[self.eventid][id] == nil then
 		listeners[self.eventid][id] = {}
 	end
@@ -13,6 +29,7 @@ function GENERIC_EVENT_LISTEN(self, id, scriptname, func)
 end
 
 function GENERIC_EVENT_UNLISTEN(self, id, scriptname)
+	id = listener_key(self.eventid, id)
 	if listeners[self.eventid][id] == nil then return end
 	listeners[self.eventid][id][scriptname] = nil
 end
@@ -36,6 +53,7 @@ function GENERIC_EVENT_EXECUTE_GLOBAL(self, ...)
 end
 
 function GENERIC_EVENT_EXECUTE_LOCAL(self, id, ...)
+	id = listener_key(self.eventid, id)
 	if listeners[self.eventid][id] == nil then return end
 	for scriptname, func in pairs(listeners[self.eventid][id]) do
 		local success, error
@@ -52,14 +70,23 @@ function GENERIC_EVENT_EXECUTE_LOCAL(self, id, ...)
 	end
 end
 
+-- The same as execute_local, for when the engine only has the entity's index.
+function GENERIC_EVENT_EXECUTE_ENTITY(self, index, ...)
+	local id = entity_keys[self.eventid][index]
+	if id == nil then return end
+	GENERIC_EVENT_EXECUTE_LOCAL(self, id, ...)
+end
+
 function CREATE_GENERIC_EVENT(eventname)
 	listeners[eventname] = {}
+	entity_keys[eventname] = {}
 	return readonly({
 		eventid = eventname,
 		listen = GENERIC_EVENT_LISTEN,
 		unlisten = GENERIC_EVENT_UNLISTEN,
 		execute_global = GENERIC_EVENT_EXECUTE_GLOBAL,
 		execute_local = GENERIC_EVENT_EXECUTE_LOCAL,
+		execute_entity = GENERIC_EVENT_EXECUTE_ENTITY,
 	})
 end
 
@@ -0,0 +1,134 @@
+#include "jobs.h"
+
+#include "printlog.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+using namespace std;
+
+namespace jobs {
+
+namespace {
+
+	vector<thread> workers;
+	mutex job_mutex;
+	condition_variable wake_workers;
+	condition_variable workers_done;
+
+	// The job currently being worked on.  Only written while no workers are busy.
+	const function<void(size_t, size_t)>* current_job = nullptr;
+	size_t job_count = 0;
+	size_t job_batch_size = 1;
+	atomic<size_t> next_index(0);
+
+	// Each ParallelFor bumps the generation, so every worker knows to join in exactly once.
+	uint64_t generation = 0;
+	size_t busy_workers = 0;
+	bool quitting = false;
+
+	void RunBatches(const function<void(size_t, size_t)>& job, size_t count, size_t batch_size)
+	{
+		while (true)
+		{
+			size_t begin = next_index.fetch_add(batch_size);
+			if (begin >= count)
+				{ break; }
+			job(begin, min(begin + batch_size, count));
+		}
+	}
+
+	void WorkerLoop()
+	{
+		uint64_t seen_generation = 0;
+		unique_lock<mutex> lock(job_mutex);
+		while (true)
+		{
+			wake_workers.wait(lock, [&] { return quitting || generation != seen_generation; });
+			if (quitting)
+				{ return; }
+
+			seen_generation = generation;
+			const function<void(size_t, size_t)>& job = *current_job;
+			size_t count = job_count, batch_size = job_batch_size;
+
+			lock.unlock();
+			RunBatches(job, count, batch_size);
+			lock.lock();
+
+			if (--busy_workers == 0)
+				{ workers_done.notify_one(); }
+		}
+	}
+
+} // namespace <anon>
+
+bool Init()
+{
+	if (!workers.empty())
+		{ return true; }
+
+	// The main thread works too, so it doesn't need a worker of its own.
+	unsigned int num_cores = thread::hardware_concurrency();
+	size_t num_workers = (num_cores > 1) ? (size_t)num_cores - 1 : 0;
+
+	quitting = false;
+	for (size_t i = 0; i < num_workers; ++i)
+		{ workers.emplace_back(WorkerLoop); }
+
+	plog::info("Started %i worker threads.\n", (int)workers.size());
+	return true;
+}
+
+void Shutdown()
+{
+	{
+		lock_guard<mutex> lock(job_mutex);
+		quitting = true;
+	}
+	wake_workers.notify_all();
+
+	for (thread& worker : workers)
+		{ worker.join(); }
+	workers.clear();
+}
+
+size_t getNumWorkers()
+	{ return workers.size(); }
+
+void ParallelFor(size_t count, size_t batch_size, const function<void(size_t begin, size_t end)>& job)
+{
+	if (count == 0)
+		{ return; }
+	if (batch_size == 0)
+		{ batch_size = 1; }
+
+	// Not worth waking anybody up for.
+	if (workers.empty() || count <= batch_size)
+	{
+		job(0, count);
+		return;
+	}
+
+	{
+		lock_guard<mutex> lock(job_mutex);
+		current_job = &job;
+		job_count = count;
+		job_batch_size = batch_size;
+		next_index = 0;
+		busy_workers = workers.size();
+		generation++;
+	}
+	wake_workers.notify_all();
+
+	RunBatches(job, count, batch_size);
+
+	unique_lock<mutex> lock(job_mutex);
+	workers_done.wait(lock, [] { return busy_workers == 0; });
+	current_job = nullptr;
+}
+
+} // namespace jobs
\ No newline at end of file
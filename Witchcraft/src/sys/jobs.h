@@ -0,0 +1,23 @@
+#ifndef HVH_WC_SYS_JOBS_H
+#define HVH_WC_SYS_JOBS_H
+
+#include <cstddef>
+#include <functional>
+
+namespace jobs
+{
+	/* Starts one worker thread for each core beyond the first. */
+	/* Returns false if the workers failed to start. */
+	bool Init();
+	/* Stops and joins every worker thread. */
+	void Shutdown();
+
+	/* Returns the number of worker threads, not counting the main thread. */
+	size_t getNumWorkers();
+
+	/* Calls 'job' over every index in [0, count), in batches of at least 'batch_size', spread across the workers and the calling thread. */
+	/* Returns once every batch has finished.  Jobs must not touch anything another batch might, and must not call ParallelFor themselves. */
+	void ParallelFor(size_t count, size_t batch_size, const std::function<void(size_t begin, size_t end)>& job);
+}
+
+#endif // HVH_WC_SYS_JOBS_H
\ No newline at end of file
@@ -0,0 +1,59 @@
+#ifndef HVH_WC_TOOLS_RINGBUFFER_H
+#define HVH_WC_TOOLS_RINGBUFFER_H
+
+#include <cstddef>
+
+/*
+A first-in, first-out queue with a fixed capacity, stored inline so pushing and popping never allocate.
+Pushing onto a full buffer fails rather than overwriting the oldest entry.
+*/
+template <typename T, size_t N>
+class RingBuffer
+{
+public:
+	static_assert(N > 0, "A RingBuffer must be able to hold at least one entry.");
+
+	RingBuffer() : head(0), count(0) {}
+
+	inline size_t size() const { return count; }
+	inline size_t capacity() const { return N; }
+	inline bool empty() const { return count == 0; }
+	inline bool full() const { return count == N; }
+	inline void clear() { head = 0; count = 0; }
+
+	/* Adds an entry to the back.  Returns false (and leaves the buffer alone) if it's full. */
+	inline bool push_back(const T& val)
+	{
+		if (count == N)
+			return false;
+
+		data[(head + count) % N] = val;
+		count++;
+		return true;
+	}
+
+	/* Removes the entry at the front.  Returns false if the buffer is empty. */
+	inline bool pop_front(T& out)
+	{
+		if (count == 0)
+			return false;
+
+		out = data[head];
+		head = (head + 1) % N;
+		count--;
+		return true;
+	}
+
+	/* The oldest entry still in the buffer.  The buffer must not be empty. */
+	inline T& front() { return data[head]; }
+
+	/* Entries counted from the front. */
+	inline T& operator [] (size_t index) { return data[(head + index) % N]; }
+
+private:
+	T data[N];
+	size_t head;
+	size_t count;
+};
+
+#endif // HVH_WC_TOOLS_RINGBUFFER_H
\ No newline at end of file
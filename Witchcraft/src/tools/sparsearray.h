@@ -0,0 +1,65 @@
+#ifndef HVH_WC_TOOLS_SPARSEARRAY_H
+#define HVH_WC_TOOLS_SPARSEARRAY_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <memory>
+
+/*
+An array indexed by integer keys which can be spread out over a large range, like entity IDs.
+Keys are split into fixed-size pages, and a page is only allocated once something is stored in it.
+Looking up a key is two array reads with no hashing, and keys that were never set give back 'empty_value'.
+*/
+template <typename T, size_t PAGE_BITS = 10>
+class SparseArray
+{
+public:
+	static constexpr const size_t PAGE_SIZE = (size_t)1 << PAGE_BITS;
+	static constexpr const size_t PAGE_MASK = PAGE_SIZE - 1;
+
+	SparseArray(const T& empty_value = T()) : empty_value(empty_value) {}
+
+	inline T get(uint32_t key) const
+	{
+		size_t page = (size_t)key >> PAGE_BITS;
+		if (page >= pages.size() || pages[page] == nullptr)
+			return empty_value;
+
+		return pages[page][key & PAGE_MASK];
+	}
+
+	inline void set(uint32_t key, const T& val)
+	{
+		size_t page = (size_t)key >> PAGE_BITS;
+		if (page >= pages.size())
+			{ pages.resize(page + 1); }
+
+		if (pages[page] == nullptr)
+		{
+			// Storing the empty value doesn't need a page to be allocated for it.
+			if (val == empty_value)
+				return;
+
+			pages[page].reset(new T[PAGE_SIZE]);
+			for (size_t i = 0; i < PAGE_SIZE; ++i)
+				{ pages[page][i] = empty_value; }
+		}
+
+		pages[page][key & PAGE_MASK] = val;
+	}
+
+	/* Sets 'key' back to the empty value.  Pages are kept around, since they're likely to be used again. */
+	inline void reset(uint32_t key)
+		{ set(key, empty_value); }
+
+	/* Frees every page. */
+	inline void clear()
+		{ pages.clear(); }
+
+private:
+	std::vector<std::unique_ptr<T[]>> pages;
+	T empty_value;
+};
+
+#endif // HVH_WC_TOOLS_SPARSEARRAY_H
\ No newline at end of file
@@ -0,0 +1,26 @@
+#ifndef HVH_WC_TOOLS_TESTRANDOM_H
+#define HVH_WC_TOOLS_TESTRANDOM_H
+
+#include <cstdint>
+
+/*
+A small, seeded random number generator for unit tests and benchmarks.
+It always gives the same sequence for the same seed, so any failure can be reproduced.
+*/
+class TestRandom
+{
+public:
+	explicit TestRandom(uint32_t seed) : state(seed) {}
+
+	/* Returns a number between 'lower' and 'upper'. */
+	inline float Float(float lower, float upper)
+	{
+		state = (state * 1664525u) + 1013904223u;
+		return lower + ((float)(state >> 8) / (float)(1 << 24)) * (upper - lower);
+	}
+
+private:
+	uint32_t state;
+};
+
+#endif // HVH_WC_TOOLS_TESTRANDOM_H
\ No newline at end of file